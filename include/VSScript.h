@@ -24,7 +24,7 @@
 #include "VapourSynth.h"
 
 #define VSSCRIPT_API_MAJOR 3
-#define VSSCRIPT_API_MINOR 2
+#define VSSCRIPT_API_MINOR 3
 #define VSSCRIPT_API_VERSION ((VSSCRIPT_API_MAJOR << 16) | (VSSCRIPT_API_MINOR))
 
 /* As of api 3.2 all functions are threadsafe */
@@ -59,6 +59,12 @@ VS_API(int) vsscript_evaluateScript(VSScript **handle, const char *script, const
 VS_API(int) vsscript_evaluateFile(VSScript **handle, const char *scriptFilename, int flags);
 /* Create an empty environment for use in later invocations, mostly useful to set script variables before execution */
 VS_API(int) vsscript_createScript(VSScript **handle);
+/*
+* Keep up to size unused cores created in the background, new environments take their core from the pool when one is available
+* Pass 0 to free the pooled cores, also happens when vsscript_finalize() is called for the last time
+* Returns non-zero if vsscript isn't initialized or size is negative
+*/
+VS_API(int) vsscript_setCorePoolSize(int size); /* api 3.3 */
 
 VS_API(void) vsscript_freeScript(VSScript *handle);
 VS_API(const char *) vsscript_getError(VSScript *handle);
@@ -22,9 +22,10 @@
 #define VAPOURSYNTH_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define VAPOURSYNTH_API_MAJOR 3
-#define VAPOURSYNTH_API_MINOR 6
+#define VAPOURSYNTH_API_MINOR 7
 #define VAPOURSYNTH_API_VERSION ((VAPOURSYNTH_API_MAJOR << 16) | (VAPOURSYNTH_API_MINOR))
 
 /* Convenience for C++ users. */
@@ -167,6 +168,13 @@ typedef enum VSNodeFlags {
     nfMakeLinear = 4 /* api 3.3 */
 } VSNodeFlags;
 
+typedef enum VSFilterHintFlags {
+    fhPure        = 1, /* the output only depends on the input frames and the arguments */
+    fhPointwise   = 2, /* every output pixel only depends on the input pixels at the same position */
+    fhCheap       = 4, /* recomputing a frame is cheaper than caching it */
+    fhPassThrough = 8  /* frames from the first input are returned unmodified */
+} VSFilterHintFlags; /* api 3.7 */
+
 typedef enum VSPropTypes {
     ptUnset = 'u',
     ptInt = 'i',
@@ -198,6 +206,40 @@ typedef struct VSCoreInfo {
     int64_t usedFramebufferSize;
 } VSCoreInfo;
 
+typedef struct VSNodeMemoryInfo {
+    int64_t inFlightBytes; /* frame memory allocated by the node that isn't held by any cache */
+    int64_t cachedBytes; /* frame memory allocated by the node that's held by at least one cache */
+    int64_t peakInFlightBytes;
+    int64_t peakCachedBytes;
+    int64_t peakTotalBytes;
+} VSNodeMemoryInfo; /* api 3.7 */
+
+typedef struct VSMemoryLimitInfo {
+    int64_t usedBytes;
+    int64_t limitBytes;
+    int64_t peakUsedBytes;
+    int64_t peakOvershootBytes; /* the largest amount frame memory use has exceeded the limit by */
+    int64_t deferredRequests; /* number of frame requests that have been held back by the enforced limit */
+    int64_t waitingRequests; /* number of frame requests currently held back */
+} VSMemoryLimitInfo; /* api 3.7 */
+
+typedef struct VSFilterHints {
+    int flags; /* VSFilterHintFlags */
+    int spatialRadius; /* -1 if unknown */
+    int temporalRadius; /* -1 if unknown */
+    int untouchedPlanes; /* bit mask of the planes copied unchanged from the first input */
+} VSFilterHints; /* api 3.7 */
+
+typedef struct VSNodeInfo {
+    const char *name; /* valid as long as the node exists */
+    int64_t id; /* unique within a core, nodes created earlier have lower ids */
+    int filterMode; /* VSFilterMode */
+    int flags; /* VSNodeFlags */
+    int numOutputs;
+    int numInputs; /* clips passed as arguments when the filter was created */
+    VSFilterHints hints;
+} VSNodeInfo; /* api 3.7 */
+
 typedef struct VSVideoInfo {
     const VSFormat *format;
     int64_t fpsNum;
@@ -341,6 +383,40 @@ struct VSAPI {
     int (VS_CC *addMessageHandler)(VSMessageHandler handler, VSMessageHandlerFree free, void *userData) VS_NOEXCEPT;
     int (VS_CC *removeMessageHandler)(int id) VS_NOEXCEPT;
     void (VS_CC *getCoreInfo2)(VSCore *core, VSCoreInfo *info) VS_NOEXCEPT;
+
+    /* api 3.7 */
+    void (VS_CC *prefetch)(VSNodeRef *node, int first, int last, int priority) VS_NOEXCEPT;
+    int (VS_CC *setLargePages)(int enable, VSCore *core) VS_NOEXCEPT;
+    void (VS_CC *getNodeMemoryInfo)(VSNodeRef *node, VSNodeMemoryInfo *info) VS_NOEXCEPT;
+    void *(VS_CC *allocScratch)(size_t bytes, VSFrameContext *frameCtx) VS_NOEXCEPT; /* only use inside a filter's getframe function */
+    VSFrameRef *(VS_CC *getFrameFilterForModify)(int n, VSNodeRef *node, VSFrameContext *frameCtx) VS_NOEXCEPT; /* only use inside a filter's getframe function */
+    VSFrameRef *(VS_CC *cropFrameView)(const VSFrameRef *f, int left, int top, int width, int height, VSCore *core) VS_NOEXCEPT;
+    VSFrameRef *(VS_CC *fieldFrameView)(const VSFrameRef *f, int field, VSCore *core) VS_NOEXCEPT;
+    VSFrameRef *(VS_CC *weaveFrameViews)(const VSFrameRef *top, const VSFrameRef *bottom, VSCore *core) VS_NOEXCEPT;
+    int (VS_CC *setMemoryLimitEnforced)(int enforce, VSCore *core) VS_NOEXCEPT;
+    void (VS_CC *getMemoryLimitInfo)(VSCore *core, VSMemoryLimitInfo *info) VS_NOEXCEPT;
+    int (VS_CC *propGetAtom)(const char *key) VS_NOEXCEPT; /* returns -1 if the key isn't valid */
+    int (VS_CC *propNumElementsAtom)(const VSMap *map, int atom) VS_NOEXCEPT;
+    int64_t(VS_CC *propGetIntAtom)(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT;
+    double(VS_CC *propGetFloatAtom)(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT;
+    const char *(VS_CC *propGetDataAtom)(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT;
+    int (VS_CC *propGetDataSizeAtom)(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT;
+    int (VS_CC *propSetIntAtom)(VSMap *map, int atom, int64_t i, int append) VS_NOEXCEPT;
+    int (VS_CC *propSetFloatAtom)(VSMap *map, int atom, double d, int append) VS_NOEXCEPT;
+    int (VS_CC *propSetDataAtom)(VSMap *map, int atom, const char *data, int size, int append) VS_NOEXCEPT;
+    int (VS_CC *propDeleteKeyAtom)(VSMap *map, int atom) VS_NOEXCEPT;
+    void (VS_CC *getNodeInfo)(VSNodeRef *node, VSNodeInfo *info) VS_NOEXCEPT;
+    VSNodeRef *(VS_CC *getNodeInput)(VSNodeRef *node, int index) VS_NOEXCEPT;
+    VSMap *(VS_CC *getNodeGraph)(VSNodeRef *node) VS_NOEXCEPT;
+    void (VS_CC *setFilterHints)(VSNodeRef *node, const VSFilterHints *hints) VS_NOEXCEPT;
+    VSMap *(VS_CC *saveGraph)(const VSMap *clips, const char *filename) VS_NOEXCEPT; /* the returned map only holds an error if saving failed */
+    VSMap *(VS_CC *loadGraph)(const char *filename, VSCore *core) VS_NOEXCEPT;
+    int (VS_CC *setProfiling)(int enable, VSCore *core) VS_NOEXCEPT;
+    VSMap *(VS_CC *getProfile)(VSCore *core, int reset) VS_NOEXCEPT;
+    void (VS_CC *startTrace)(VSCore *core) VS_NOEXCEPT;
+    int (VS_CC *stopTrace)(VSCore *core, const char *filename) VS_NOEXCEPT; /* returns non-zero if the trace was written */
+    void (VS_CC *getCoreStats)(VSCore *core, VSMap *stats) VS_NOEXCEPT;
+    int (VS_CC *setGraphRecording)(int enable, VSCore *core) VS_NOEXCEPT;
 };
 
 VS_API(const VSAPI *) getVapourSynthAPI(int version) VS_NOEXCEPT;
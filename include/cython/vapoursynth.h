@@ -16,6 +16,7 @@ struct VPYScriptExport {
   void *pyenvdict;
   void *errstr;
   int id;
+  VSCore *core;
 };
 
 #ifndef __PYX_HAVE_API__vapoursynth
@@ -0,0 +1,117 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+// Measures how fast 4K frames can be allocated and freed through the core's frame
+// buffer pool compared to allocating the same planes directly with malloc.
+// Every page of a new plane is touched once so the page fault cost is included.
+
+#include "VapourSynth.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+static const int width = 3840;
+static const int height = 2160;
+static const int pageSize = 4096;
+// frames kept alive at the same time by each thread, roughly what a cache and a few filters hold on to
+static const int window = 8;
+
+static void touchPlane(uint8_t *ptr, size_t size) {
+    for (size_t i = 0; i < size; i += pageSize)
+        ptr[i] = static_cast<uint8_t>(i);
+}
+
+static void vsWorker(const VSAPI *vsapi, VSCore *core, const VSFormat *format, int iterations) {
+    std::vector<VSFrameRef *> frames(window);
+    for (int i = 0; i < iterations; i++) {
+        VSFrameRef *&f = frames[i % window];
+        vsapi->freeFrame(f);
+        f = vsapi->newVideoFrame(format, width, height, nullptr, core);
+        for (int p = 0; p < format->numPlanes; p++)
+            touchPlane(vsapi->getWritePtr(f, p), vsapi->getStride(f, p) * vsapi->getFrameHeight(f, p));
+    }
+    for (auto f : frames)
+        vsapi->freeFrame(f);
+}
+
+static void mallocWorker(const VSFormat *format, int iterations) {
+    size_t planeSize[3] = {};
+    planeSize[0] = static_cast<size_t>(width) * height * format->bytesPerSample;
+    for (int p = 1; p < format->numPlanes; p++)
+        planeSize[p] = static_cast<size_t>(width >> format->subSamplingW) * (height >> format->subSamplingH) * format->bytesPerSample;
+
+    std::vector<uint8_t *> planes(window * 3);
+    for (int i = 0; i < iterations; i++) {
+        for (int p = 0; p < format->numPlanes; p++) {
+            uint8_t *&ptr = planes[(i % window) * 3 + p];
+            free(ptr);
+            ptr = static_cast<uint8_t *>(malloc(planeSize[p]));
+            touchPlane(ptr, planeSize[p]);
+        }
+    }
+    for (auto ptr : planes)
+        free(ptr);
+}
+
+template<typename F>
+static double runThreads(int numThreads, F worker) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++)
+        threads.emplace_back(worker);
+    for (auto &t : threads)
+        t.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 500;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    if (iterations <= 0 || maxThreads <= 0) {
+        fprintf(stderr, "Usage: framealloc [iterations per thread] [max threads]\n");
+        return 1;
+    }
+
+    const VSAPI *vsapi = getVapourSynthAPI(VAPOURSYNTH_API_VERSION);
+    if (!vsapi) {
+        fprintf(stderr, "Failed to get the VapourSynth API\n");
+        return 1;
+    }
+
+    VSCore *core = vsapi->createCore(1);
+    const int presets[] = { pfYUV420P8, pfYUV420P16, pfYUV444P16 };
+    const char *names[] = { "YUV420P8", "YUV420P16", "YUV444P16" };
+
+    printf("%-10s %7s %14s %14s\n", "format", "threads", "pool fps", "malloc fps");
+    for (int i = 0; i < 3; i++) {
+        const VSFormat *format = vsapi->getFormatPreset(presets[i], core);
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            double poolTime = runThreads(threads, [=] { vsWorker(vsapi, core, format, iterations); });
+            double mallocTime = runThreads(threads, [=] { mallocWorker(format, iterations); });
+            printf("%-10s %7d %14.1f %14.1f\n", names[i], threads, threads * iterations / poolTime, threads * iterations / mallocTime);
+        }
+    }
+
+    vsapi->freeCore(core);
+    return 0;
+}
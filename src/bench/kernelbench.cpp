@@ -0,0 +1,477 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+// Runs every kernel in src/core/kernel at every cpu level the machine supports and compares the output of the
+// optimized versions to the C version. Widths that aren't a multiple of the vector size and strides with extra
+// padding are included, strides are always a multiple of 32 bytes like the core's frames. Prints one CSV line per
+// kernel, pixel type, instruction set, width and stride:
+//   kernel,pixel,isa,width,height,stride,result,max_diff,gbps,cycles_per_pixel
+// The result is "reference" for C, "exact" for identical output, "close" for float output within rounding
+// differences and "MISMATCH" otherwise. The exit code is 1 if there was a mismatch.
+//
+// Usage: kernelbench [kernel name filter] [milliseconds per measurement]
+
+#include "../core/cpufeatures.h"
+#include "../core/kernel/generic.h"
+#include "../core/kernel/merge.h"
+#include "../core/kernel/planestats.h"
+#include "../core/kernel/transpose.h"
+#include "VSHelper.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef VS_TARGET_CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+struct PixelType {
+    const char *name;
+    int bytesPerSample;
+    int bits;
+    bool isFloat;
+};
+
+static const PixelType pixelTypes[] = {
+    { "byte", 1, 8, false },
+    { "word10", 2, 10, false },
+    { "word16", 2, 16, false },
+    { "float", 4, 32, true }
+};
+
+static const unsigned widths[] = { 4, 15, 17, 33, 63, 65, 127, 640, 1023, 1920, 3840 };
+// extra 32 byte blocks added to the smallest stride, an odd number so rows alternate between 64 byte alignments
+static const int stridePadding[] = { 0, 3 };
+
+static const char *isaNames[] = { "c", "sse2", "avx2" };
+static const int numLevels = 3;
+
+class Plane {
+    uint8_t *data;
+public:
+    unsigned width;
+    unsigned height;
+    ptrdiff_t stride;
+    int bytesPerSample;
+
+    Plane(unsigned width, unsigned height, int bytesPerSample, int padding) : width(width), height(height), bytesPerSample(bytesPerSample) {
+        stride = ((width * bytesPerSample + 31) & ~31) + padding * 32;
+        data = vs_aligned_malloc<uint8_t>(stride * height, 64);
+        memset(data, 0, stride * height);
+    }
+
+    ~Plane() {
+        vs_aligned_free(data);
+    }
+
+    Plane(const Plane &) = delete;
+    Plane &operator=(const Plane &) = delete;
+
+    uint8_t *row(unsigned y) {
+        return data + y * stride;
+    }
+
+    const uint8_t *row(unsigned y) const {
+        return data + y * stride;
+    }
+
+    double get(unsigned x, unsigned y) const {
+        const uint8_t *p = row(y);
+        if (bytesPerSample == 1)
+            return p[x];
+        else if (bytesPerSample == 2)
+            return reinterpret_cast<const uint16_t *>(p)[x];
+        else
+            return reinterpret_cast<const float *>(p)[x];
+    }
+
+    // valid sample values, floats are kept between 0 and 1
+    void fill(const PixelType &pt, uint32_t seed) {
+        for (unsigned y = 0; y < height; y++) {
+            uint8_t *p = row(y);
+            for (unsigned x = 0; x < width; x++) {
+                seed = seed * 1664525 + 1013904223;
+                uint32_t v = seed >> 8;
+                if (pt.isFloat)
+                    reinterpret_cast<float *>(p)[x] = (v & 0xFFFF) / 65535.f;
+                else if (pt.bytesPerSample == 2)
+                    reinterpret_cast<uint16_t *>(p)[x] = static_cast<uint16_t>(v & ((1 << pt.bits) - 1));
+                else
+                    p[x] = static_cast<uint8_t>(v);
+            }
+        }
+    }
+
+    // scales the distance from offset by the mask like a premultiplied clip, rounded towards offset
+    void premultiply(const Plane &mask, const PixelType &pt, unsigned offset) {
+        double maxval = pt.isFloat ? 1. : ((1U << pt.bits) - 1);
+        for (unsigned y = 0; y < height; y++) {
+            uint8_t *p = row(y);
+            for (unsigned x = 0; x < width; x++) {
+                double v = offset + (get(x, y) - offset) * mask.get(x, y) / maxval;
+                if (pt.isFloat)
+                    reinterpret_cast<float *>(p)[x] = static_cast<float>(v);
+                else if (pt.bytesPerSample == 2)
+                    reinterpret_cast<uint16_t *>(p)[x] = static_cast<uint16_t>(offset + std::trunc(v - offset));
+                else
+                    p[x] = static_cast<uint8_t>(offset + std::trunc(v - offset));
+            }
+        }
+    }
+};
+
+struct Frame {
+    std::vector<std::unique_ptr<Plane>> src;
+    std::unique_ptr<Plane> dst;
+    vs_plane_stats stats;
+};
+
+struct KernelCase {
+    std::string name;
+    int numSrc;
+    bool transposed; // the output is height x width
+    bool stats;      // the output is the plane stats instead of a plane
+    bool premultiplied; // the second source is premultiplied by the third, other values can overflow
+    std::function<void(Frame &)> run[numLevels]; // empty if there's no version for the level
+};
+
+typedef decltype(&vs_generic_3x3_conv_byte_c) GenericFunc;
+typedef decltype(&vs_merge_byte_c) MergeFunc;
+typedef decltype(&vs_mask_merge_byte_c) MaskMergeFunc;
+typedef decltype(&vs_makediff_byte_c) DiffFunc;
+typedef decltype(&vs_plane_stats_1_byte_c) PlaneStats1Func;
+typedef decltype(&vs_plane_stats_2_byte_c) PlaneStats2Func;
+typedef decltype(&vs_transpose_plane_byte_c) TransposeFunc;
+
+// indexed by cpu level and then byte, word or float
+#define PIXEL_KERNELS(name, isa) { name##_byte_##isa, name##_word_##isa, name##_float_##isa }
+#ifdef VS_TARGET_CPU_X86
+#define SIMD_KERNELS(name) { PIXEL_KERNELS(name, c), PIXEL_KERNELS(name, sse2), PIXEL_KERNELS(name, avx2) }
+#define TRANSPOSE_KERNELS { { vs_transpose_plane_byte_c, vs_transpose_plane_word_c, vs_transpose_plane_dword_c }, \
+                            { vs_transpose_plane_byte_sse2, vs_transpose_plane_word_sse2, vs_transpose_plane_dword_sse2 } }
+#else
+#define SIMD_KERNELS(name) { PIXEL_KERNELS(name, c) }
+#define TRANSPOSE_KERNELS { { vs_transpose_plane_byte_c, vs_transpose_plane_word_c, vs_transpose_plane_dword_c } }
+#endif
+#define C_KERNELS(name) { PIXEL_KERNELS(name, c) }
+
+template<typename F>
+struct KernelTable {
+    const char *name;
+    F funcs[numLevels][3];
+};
+
+static const KernelTable<GenericFunc> genericKernels[] = {
+    { "3x3_prewitt", SIMD_KERNELS(vs_generic_3x3_prewitt) },
+    { "3x3_sobel", SIMD_KERNELS(vs_generic_3x3_sobel) },
+    { "3x3_min", SIMD_KERNELS(vs_generic_3x3_min) },
+    { "3x3_max", SIMD_KERNELS(vs_generic_3x3_max) },
+    { "3x3_median", SIMD_KERNELS(vs_generic_3x3_median) },
+    { "3x3_deflate", SIMD_KERNELS(vs_generic_3x3_deflate) },
+    { "3x3_inflate", SIMD_KERNELS(vs_generic_3x3_inflate) },
+    { "3x3_conv", SIMD_KERNELS(vs_generic_3x3_conv) },
+    { "5x5_conv", C_KERNELS(vs_generic_5x5_conv) },
+    { "1d_conv_h", C_KERNELS(vs_generic_1d_conv_h) },
+    { "1d_conv_v", C_KERNELS(vs_generic_1d_conv_v) }
+};
+
+static const KernelTable<MergeFunc> mergeKernels[] = { { "merge", SIMD_KERNELS(vs_merge) } };
+static const KernelTable<MaskMergeFunc> maskMergeKernels[] = {
+    { "mask_merge", SIMD_KERNELS(vs_mask_merge) },
+    { "mask_merge_premul", SIMD_KERNELS(vs_mask_merge_premul) }
+};
+static const KernelTable<DiffFunc> diffKernels[] = {
+    { "makediff", SIMD_KERNELS(vs_makediff) },
+    { "mergediff", SIMD_KERNELS(vs_mergediff) }
+};
+static const KernelTable<PlaneStats1Func> planeStats1Kernels[] = { { "plane_stats_1", SIMD_KERNELS(vs_plane_stats_1) } };
+static const KernelTable<PlaneStats2Func> planeStats2Kernels[] = { { "plane_stats_2", SIMD_KERNELS(vs_plane_stats_2) } };
+static const KernelTable<TransposeFunc> transposeKernels[] = { { "transpose", TRANSPOSE_KERNELS } };
+
+#undef C_KERNELS
+#undef TRANSPOSE_KERNELS
+#undef SIMD_KERNELS
+#undef PIXEL_KERNELS
+
+static bool levelSupported(int level) {
+#ifdef VS_TARGET_CPU_X86
+    // sse2 is required to run the core at all
+    return level < 2 || getCPUFeatures()->avx2;
+#else
+    return level == 0;
+#endif
+}
+
+static int pixelIndex(const PixelType &pt) {
+    return pt.isFloat ? 2 : pt.bytesPerSample - 1;
+}
+
+// the filter settings are chosen so every branch in the kernels is taken at least for some pixels
+static vs_generic_params genericParams(const std::string &name, const PixelType &pt) {
+    vs_generic_params params = {};
+    params.maxval = pt.isFloat ? 0 : static_cast<uint16_t>((1 << pt.bits) - 1);
+    params.scale = 1.5f;
+    params.threshold = static_cast<uint16_t>(params.maxval / 8);
+    params.thresholdf = 0.125f;
+    params.stencil = 0xB7;
+
+    int sum = 0;
+    if (name == "3x3_conv") {
+        const int matrix[] = { -1, 2, -3, 4, 5, 4, -3, 2, -1 };
+        params.matrixsize = 9;
+        std::copy(matrix, matrix + 9, params.matrix);
+        params.saturate = 0;
+    } else if (name == "5x5_conv") {
+        params.matrixsize = 25;
+        for (int i = 0; i < 25; i++)
+            params.matrix[i] = static_cast<int16_t>((i % 5) - (i / 5) + 1);
+        params.saturate = 1;
+    } else {
+        const int matrix[] = { 1, -2, 3, 4, 3, -2, 1 };
+        params.matrixsize = 7;
+        std::copy(matrix, matrix + 7, params.matrix);
+        params.saturate = 1;
+    }
+    for (unsigned i = 0; i < params.matrixsize; i++) {
+        params.matrixf[i] = params.matrix[i];
+        sum += params.matrix[i];
+    }
+    params.div = sum ? 1.f / sum : 1.f;
+    params.bias = pt.isFloat ? 0.01f : 3.f;
+    return params;
+}
+
+static std::vector<KernelCase> makeCases(const PixelType &pt) {
+    std::vector<KernelCase> cases;
+    int p = pixelIndex(pt);
+    unsigned depth = pt.bits;
+
+    for (const auto &k : genericKernels) {
+        KernelCase c = { k.name, 1, false, false, false, {} };
+        vs_generic_params params = genericParams(k.name, pt);
+        for (int level = 0; level < numLevels; level++) {
+            GenericFunc func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func, params](Frame &f) {
+                    func(f.src[0]->row(0), f.src[0]->stride, f.dst->row(0), f.dst->stride, &params, f.dst->width, f.dst->height);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    for (const auto &k : mergeKernels) {
+        KernelCase c = { k.name, 2, false, false, false, {} };
+        vs_merge_weight weight;
+        if (pt.isFloat)
+            weight.f = 0.3f;
+        else
+            weight.u = 12345;
+        for (int level = 0; level < numLevels; level++) {
+            MergeFunc func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func, weight](Frame &f) {
+                    for (unsigned y = 0; y < f.dst->height; y++)
+                        func(f.src[0]->row(y), f.src[1]->row(y), f.dst->row(y), weight, f.dst->width);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    for (const auto &k : maskMergeKernels) {
+        KernelCase c = { k.name, 3, false, false, !strcmp(k.name, "mask_merge_premul"), {} };
+        // premultiplied clips are merged as chroma so the offset is used
+        unsigned offset = (pt.isFloat || !c.premultiplied) ? 0 : (1U << (depth - 1));
+        for (int level = 0; level < numLevels; level++) {
+            MaskMergeFunc func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func, depth, offset](Frame &f) {
+                    for (unsigned y = 0; y < f.dst->height; y++)
+                        func(f.src[0]->row(y), f.src[1]->row(y), f.src[2]->row(y), f.dst->row(y), depth, offset, f.dst->width);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    for (const auto &k : diffKernels) {
+        KernelCase c = { k.name, 2, false, false, false, {} };
+        for (int level = 0; level < numLevels; level++) {
+            DiffFunc func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func, depth](Frame &f) {
+                    for (unsigned y = 0; y < f.dst->height; y++)
+                        func(f.src[0]->row(y), f.src[1]->row(y), f.dst->row(y), depth, f.dst->width);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    for (const auto &k : planeStats1Kernels) {
+        KernelCase c = { k.name, 1, false, true, false, {} };
+        for (int level = 0; level < numLevels; level++) {
+            PlaneStats1Func func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func](Frame &f) {
+                    func(&f.stats, f.src[0]->row(0), f.src[0]->stride, f.src[0]->width, f.src[0]->height);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    for (const auto &k : planeStats2Kernels) {
+        KernelCase c = { k.name, 2, false, true, false, {} };
+        for (int level = 0; level < numLevels; level++) {
+            PlaneStats2Func func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func](Frame &f) {
+                    func(&f.stats, f.src[0]->row(0), f.src[0]->stride, f.src[1]->row(0), f.src[1]->stride, f.src[0]->width, f.src[0]->height);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    for (const auto &k : transposeKernels) {
+        KernelCase c = { k.name, 1, true, false, false, {} };
+        for (int level = 0; level < numLevels; level++) {
+            TransposeFunc func = k.funcs[level][p];
+            if (func)
+                c.run[level] = [func](Frame &f) {
+                    func(f.src[0]->row(0), f.src[0]->stride, f.dst->row(0), f.dst->stride, f.src[0]->width, f.src[0]->height);
+                };
+        }
+        cases.push_back(c);
+    }
+
+    return cases;
+}
+
+static std::vector<double> getOutput(const KernelCase &c, const PixelType &pt, const Frame &f) {
+    std::vector<double> out;
+    if (c.stats) {
+        if (pt.isFloat)
+            out = { f.stats.f.min, f.stats.f.max, f.stats.f.acc, f.stats.f.diffacc };
+        else
+            out = { static_cast<double>(f.stats.i.min), static_cast<double>(f.stats.i.max), static_cast<double>(f.stats.i.acc), static_cast<double>(f.stats.i.diffacc) };
+    } else {
+        for (unsigned y = 0; y < f.dst->height; y++)
+            for (unsigned x = 0; x < f.dst->width; x++)
+                out.push_back(f.dst->get(x, y));
+    }
+    return out;
+}
+
+static int64_t readCycles() {
+#ifdef VS_TARGET_CPU_X86
+    return static_cast<int64_t>(__rdtsc());
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char **argv) {
+    const char *filter = (argc > 1) ? argv[1] : "";
+    double budget = (argc > 2) ? atof(argv[2]) / 1000 : 0.002;
+    bool mismatch = false;
+
+    printf("kernel,pixel,isa,width,height,stride,result,max_diff,gbps,cycles_per_pixel\n");
+
+    for (const PixelType &pt : pixelTypes) {
+        for (const KernelCase &c : makeCases(pt)) {
+            if (c.name.find(filter) == std::string::npos)
+                continue;
+
+            for (unsigned width : widths) {
+                // about a million pixels so the wide planes are bigger than most caches
+                unsigned height = std::max(8U, std::min(1080U, (1U << 20) / width));
+
+                for (int padding : stridePadding) {
+                    Frame frame;
+                    for (int i = 0; i < c.numSrc; i++) {
+                        frame.src.emplace_back(new Plane(width, height, pt.bytesPerSample, padding));
+                        frame.src.back()->fill(pt, 0x9E3779B9 * (i + 1));
+                    }
+                    if (c.premultiplied)
+                        frame.src[1]->premultiply(*frame.src[2], pt, pt.isFloat ? 0 : (1U << (pt.bits - 1)));
+                    std::vector<double> reference;
+
+                    for (int level = 0; level < numLevels; level++) {
+                        if (!c.run[level] || !levelSupported(level))
+                            continue;
+
+                        if (!c.stats)
+                            frame.dst.reset(c.transposed ? new Plane(height, width, pt.bytesPerSample, padding) : new Plane(width, height, pt.bytesPerSample, padding));
+                        frame.stats = {};
+                        c.run[level](frame);
+                        std::vector<double> out = getOutput(c, pt, frame);
+
+                        const char *result = "reference";
+                        double maxDiff = 0;
+                        if (level == 0) {
+                            reference = out;
+                        } else {
+                            bool close = true;
+                            for (size_t i = 0; i < out.size(); i++) {
+                                double diff = std::abs(out[i] - reference[i]);
+                                maxDiff = std::max(maxDiff, diff);
+                                close = close && diff <= 1e-5 * std::max(1.0, std::abs(reference[i]));
+                            }
+                            result = (maxDiff == 0) ? "exact" : ((pt.isFloat && close) ? "close" : "MISMATCH");
+                            mismatch = mismatch || !strcmp(result, "MISMATCH");
+                        }
+
+                        // the fastest of as many runs as fit in the time budget, at least three
+                        double fastest = 1e30;
+                        int64_t fastestCycles = INT64_MAX;
+                        double total = 0;
+                        for (int run = 0; run < 3 || total < budget; run++) {
+                            auto start = std::chrono::steady_clock::now();
+                            int64_t startCycles = readCycles();
+                            c.run[level](frame);
+                            int64_t cycles = readCycles() - startCycles;
+                            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                            fastest = std::min(fastest, elapsed);
+                            fastestCycles = std::min(fastestCycles, cycles);
+                            total += elapsed;
+                        }
+
+                        double pixels = static_cast<double>(width) * height;
+                        double bytes = pixels * pt.bytesPerSample * (c.numSrc + (c.stats ? 0 : 1));
+                        printf("%s,%s,%s,%u,%u,%td,%s,%g,%.3f,%.3f\n", c.name.c_str(), pt.name, isaNames[level], width, height,
+                            frame.src[0]->stride, result, maxDiff, bytes / fastest / 1e9, fastestCycles / pixels);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    return mismatch ? 1 : 0;
+}
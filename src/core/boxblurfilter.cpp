@@ -245,7 +245,7 @@ static const VSFrameRef *VS_CC boxBlurGetframe(int n, int activationReason, void
         VSFrameRef *dst = vsapi->newVideoFrame(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), src, core);
         int bytesPerSample = fi->bytesPerSample;
         int radius = d->radius;
-        uint8_t *tmp = (radius > 1 && d->passes > 1) ? new uint8_t[bytesPerSample * vsapi->getFrameWidth(src, 0)] : nullptr;
+        uint8_t *tmp = (radius > 1 && d->passes > 1) ? static_cast<uint8_t *>(vsapi->allocScratch(bytesPerSample * vsapi->getFrameWidth(src, 0), frameCtx)) : nullptr;
 
         const uint8_t *srcp = vsapi->getReadPtr(src, 0);
         int stride = vsapi->getStride(src, 0);
@@ -269,8 +269,6 @@ static const VSFrameRef *VS_CC boxBlurGetframe(int n, int activationReason, void
                 processPlaneF<float>(srcp, dstp, stride, w, h, d->passes, radius, tmp);
         }
 
-        delete[] tmp;
-
         vsapi->freeFrame(src);
         return dst;
     }
@@ -53,8 +53,8 @@ VSCache::CacheAction VSCache::recommendSize() {
     }
 }
 
-inline VSCache::VSCache(int maxSize, int maxHistorySize, bool fixedSize)
-    : maxSize(maxSize), maxHistorySize(maxHistorySize), fixedSize(fixedSize) {
+inline VSCache::VSCache(int maxSize, int maxHistorySize, bool fixedSize, const char *name)
+    : maxSize(maxSize), maxHistorySize(maxHistorySize), fixedSize(fixedSize), hits(0), nearMiss(0), farMiss(0), totalHits(0), totalNearMiss(0), totalFarMiss(0), name(name) {
     clear();
 }
 
@@ -85,6 +85,8 @@ bool VSCache::insert(const int akey, const PVideoFrame &aobject) {
     remove(akey);
     trim(maxSize - 1, maxHistorySize);
     auto i = hash.insert(std::make_pair(akey, Node(akey, aobject)));
+    aobject->cacheHold();
+    aobject->addCacheEntry();
     currentSize++;
     Node *n = &i.first->second;
 
@@ -103,6 +105,48 @@ bool VSCache::insert(const int akey, const PVideoFrame &aobject) {
 }
 
 
+bool VSCache::donate(const int key, const PVideoFrame &frame) {
+    auto i = hash.find(key);
+    Node *n = (i != hash.end()) ? &i->second : nullptr;
+    bool held = n && n->frame == frame;
+    // the weak reference may also belong to an older frame with the same number
+    bool tracked = n && !n->weakFrame.owner_before(frame) && !frame.owner_before(n->weakFrame);
+
+    // other caches may also be able to bring it back
+    if (frame.use_count() != (held ? 2 : 1) || frame->getCacheEntries() != (tracked ? 1 : 0))
+        return false;
+
+    if (!tracked)
+        return true;
+
+    if (!held) {
+        // a history entry could otherwise bring back the modified frame
+        forgetFrame(*n);
+        return true;
+    }
+
+    // frames that have been requested more than once recently are probably needed again
+    if (fixedSize || hits > 0 || nearMiss > 0)
+        return false;
+
+    // keep the key as history so a later request counts as a near miss and grows the cache instead
+    unlink(*n);
+    Node *h = &hash.insert(std::make_pair(key, Node(key, PVideoFrame()))).first->second;
+    h->prevNode = last;
+    if (last)
+        last->nextNode = h;
+    last = h;
+    if (!first)
+        first = h;
+    if (!weakpoint)
+        weakpoint = h;
+    historySize++;
+
+    trim(maxSize, maxHistorySize);
+
+    return true;
+}
+
 void VSCache::trim(int max, int maxHistory) {
     // first adjust the number of cached frames and extra history length
     while (currentSize > max) {
@@ -112,7 +156,7 @@ void VSCache::trim(int max, int maxHistory) {
             weakpoint = weakpoint->prevNode;
 
         if (weakpoint)
-            weakpoint->frame.reset();
+            releaseFrame(*weakpoint);
 
         currentSize--;
         historySize++;
@@ -126,6 +170,7 @@ void VSCache::trim(int max, int maxHistory) {
 
 void VSCache::adjustSize(bool needMemory) {
     if (!fixedSize) {
+        int oldSize = maxSize;
         if (!needMemory) {
             switch (recommendSize()) {
             case VSCache::caClear:
@@ -159,6 +204,8 @@ void VSCache::adjustSize(bool needMemory) {
             default:;
             }
         }
+        if (maxSize != oldSize)
+            VS_PROBE3(cache__resize, name, oldSize, maxSize);
     }
 }
 
@@ -221,6 +268,19 @@ static std::atomic<unsigned> cacheId(1);
 
 static void VS_CC createCacheFilter(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     VSNodeRef *video = vsapi->propGetNode(in, "clip", 0, nullptr);
+
+    // a cache directly on top of another cache only adds an extra hop, so pass the existing one through unless the new one is configured explicitly,
+    // the same goes for filters that are cheaper to run again or only pass frames through
+    VSNodeInfo info;
+    vsapi->getNodeInfo(video, &info);
+    bool configured = vsapi->propNumElements(in, "size") >= 0 || vsapi->propNumElements(in, "fixed") >= 0 || vsapi->propNumElements(in, "make_linear") >= 0;
+    bool uncacheable = (info.flags & nfIsCache) || ((info.hints.flags & (fhCheap | fhPassThrough)) && !(info.flags & nfMakeLinear));
+    if (uncacheable && !configured) {
+        vsapi->propSetNode(out, "clip", video, paReplace);
+        vsapi->freeNode(video);
+        return;
+    }
+
     int err;
     bool fixed = !!vsapi->propGetInt(in, "fixed", 0, &err);
     CacheInstance *c = new CacheInstance(video, core, fixed);
@@ -243,6 +303,12 @@ static void VS_CC createCacheFilter(const VSMap *in, VSMap *out, void *userData,
 
     vsapi->createFilter(in, out, ("Cache" + std::to_string(cacheId++)).c_str(), cacheInit, cacheGetframe, cacheFree, c->makeLinear ? fmUnorderedLinear : fmUnordered, nfNoCache | nfIsCache, c, core);
 
+    // the frames of the input are returned unmodified
+    VSFilterHints hints = { fhPure | fhPassThrough, 0, 0, (1 << 3) - 1 };
+    VSNodeRef *node = vsapi->propGetNode(out, "clip", 0, nullptr);
+    vsapi->setFilterHints(node, &hints);
+    vsapi->freeNode(node);
+
     c->addCache();
 }
 
@@ -22,6 +22,7 @@
 #define CACHEFILTER_H
 
 #include "vscore.h"
+#include "vsprobes.h"
 #include <unordered_map>
 #include <cassert>
 
@@ -53,6 +54,10 @@ private:
     int hits;
     int nearMiss;
     int farMiss;
+    // the counts from before the last time the stats were cleared
+    int64_t totalHits;
+    int64_t totalNearMiss;
+    int64_t totalFarMiss;
 
     inline void unlink(Node &n) {
         if (&n == weakpoint)
@@ -70,37 +75,61 @@ private:
         if (first == &n)
             first = n.nextNode;
 
-        if (n.frame)
+        if (n.frame) {
+            n.frame->cacheRelease();
             currentSize--;
-        else
+        } else {
             historySize--;
+        }
 
+        forgetFrame(n);
         hash.erase(n.key);
     }
 
+    // after this the node can't bring the frame back
+    static inline void forgetFrame(Node &n) {
+        PVideoFrame f = n.weakFrame.lock();
+        if (f)
+            f->removeCacheEntry();
+        n.weakFrame.reset();
+    }
+
+    // drops the strong reference but keeps the node as history
+    static inline void releaseFrame(Node &n) {
+        if (n.frame) {
+            n.frame->cacheRelease();
+            n.frame.reset();
+        }
+    }
+
     inline PVideoFrame relink(const int key) {
         auto i = hash.find(key);
 
         if (i == hash.end()) {
             farMiss++;
+            VS_PROBE2(cache__miss, name, key);
             return PVideoFrame();
         }
 
         Node &n = i->second;
+        bool fromHistory = !n.frame;
 
-        if (!n.frame) {
+        if (fromHistory) {
             nearMiss++;
             try {
                 n.frame = PVideoFrame(n.weakFrame);
             } catch (std::bad_weak_ptr &) {
+                VS_PROBE2(cache__miss, name, key);
                 return PVideoFrame();
             }
 
+            n.frame->cacheHold();
             currentSize++;
             historySize--;
         }
 
         hits++;
+        VS_PROBE3(cache__hit, name, key, fromHistory ? 1 : 0);
         Node *origWeakPoint = weakpoint;
 
         if (&n == origWeakPoint)
@@ -125,11 +154,11 @@ private:
         if (!weakpoint) {
             if (currentSize > maxSize) {
                 weakpoint = last;
-                weakpoint->frame.reset();
+                releaseFrame(*weakpoint);
             }
         } else if (&n == origWeakPoint || historySize > maxHistorySize) {
             weakpoint = weakpoint->prevNode;
-            weakpoint->frame.reset();
+            releaseFrame(*weakpoint);
         }
 
         assert(historySize <= maxHistorySize);
@@ -145,7 +174,19 @@ public:
         caClear
     };
 
-    VSCache(int maxSize, int maxHistorySize, bool fixedSize);
+    struct Stats {
+        int size;
+        int maxSize;
+        int historySize;
+        int64_t hits; // includes the near misses that could bring back the frame
+        int64_t nearMiss;
+        int64_t farMiss;
+    };
+
+    // the name of the cached filter, only used by the probes
+    const char *name;
+
+    VSCache(int maxSize, int maxHistorySize, bool fixedSize, const char *name);
     ~VSCache() {
         clear();
     }
@@ -170,6 +211,10 @@ public:
     }
 
     inline void clear() {
+        for (auto &iter : hash) {
+            releaseFrame(iter.second);
+            forgetFrame(iter.second);
+        }
         hash.clear();
         first = nullptr;
         last = nullptr;
@@ -180,6 +225,9 @@ public:
     }
 
     inline void clearStats() {
+        totalHits += hits;
+        totalNearMiss += nearMiss;
+        totalFarMiss += farMiss;
         hits = 0;
         nearMiss = 0;
         farMiss = 0;
@@ -194,11 +242,23 @@ public:
 
     bool remove(const int key);
 
+    // gives up the reference to a frame so the caller can modify it in place, only done when nothing else refers to it
+    bool donate(const int key, const PVideoFrame &frame);
 
 
     CacheAction recommendSize();
 
+    inline Stats getStats() const {
+        return { currentSize, maxSize, historySize, totalHits + hits, totalNearMiss + nearMiss, totalFarMiss + farMiss };
+    }
+
     void adjustSize(bool needMemory);
+
+    // grows a non-fixed cache so it can hold at least the given number of frames
+    inline void reserve(int frames) {
+        if (!fixedSize && frames > maxSize)
+            setMaxFrames(frames);
+    }
 private:
     void trim(int max, int maxHistory);
 
@@ -214,7 +274,7 @@ public:
     int numThreads;
     bool makeLinear;
 
-    CacheInstance(VSNodeRef *clip, VSCore *core, bool fixedSize) : cache(20, 20, fixedSize), clip(clip), core(core), node(nullptr), lastN(-1), numThreads(0), makeLinear(false) {}
+    CacheInstance(VSNodeRef *clip, VSCore *core, bool fixedSize) : cache(20, 20, fixedSize, clip->clip->getName().c_str()), clip(clip), core(core), node(nullptr), lastN(-1), numThreads(0), makeLinear(false) {}
 
     void addCache() {
         std::lock_guard<std::mutex> lock(core->cacheLock);
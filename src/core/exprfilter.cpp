@@ -20,11 +20,13 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <locale>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <stdexcept>
@@ -66,6 +68,10 @@ enum class ExprOpType {
     // Transcendental functions.
     EXP, LOG, POW,
 
+    // Only created when merging pointwise filters, ROUND is only applied to
+    // values already clamped to the integer range and LUT reads a table.
+    ROUND, LUT,
+
     // Ternary operator
     TERNARY,
 
@@ -141,6 +147,7 @@ struct ExprData {
     VSNodeRef *node[MAX_EXPR_INPUTS];
     VSVideoInfo vi;
     std::vector<ExprInstruction> bytecode[3];
+    std::vector<std::vector<float>> tables;
     int plane[3];
     int numInputs;
     typedef void (*ProcessLineProc)(void *rwptrs, intptr_t ptroff[MAX_EXPR_INPUTS + 1], intptr_t niter);
@@ -193,6 +200,8 @@ class ExprCompiler {
     virtual void exp(const ExprInstruction &insn) = 0;
     virtual void log(const ExprInstruction &insn) = 0;
     virtual void pow(const ExprInstruction &insn) = 0;
+    virtual void round(const ExprInstruction &insn) = 0;
+    virtual void lut(const ExprInstruction &insn) = 0;
 public:
     void addInstruction(const ExprInstruction &insn)
     {
@@ -225,6 +234,8 @@ public:
         case ExprOpType::EXP: exp(insn); break;
         case ExprOpType::LOG: log(insn); break;
         case ExprOpType::POW: pow(insn); break;
+        case ExprOpType::ROUND: round(insn); break;
+        case ExprOpType::LUT: lut(insn); break;
         default: vsFatal("illegal opcode"); break;
         }
     }
@@ -329,6 +340,7 @@ class ExprCompiler128 : public ExprCompiler, private jitasm::function<void, Expr
     std::vector<std::function<void(Reg, XmmReg, Reg, std::unordered_map<int, std::pair<XmmReg, XmmReg>> &)>> deferred;
 
     CPUFeatures cpuFeatures;
+    const std::vector<std::vector<float>> &tables;
     int numInputs;
     int curLabel;
 
@@ -975,6 +987,55 @@ do { \
         });
     }
 
+    void round(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            VEX1(cvtps2dq, t2.first, t1.first);
+            VEX1(cvtps2dq, t2.second, t1.second);
+            VEX1(cvtdq2ps, t2.first, t2.first);
+            VEX1(cvtdq2ps, t2.second, t2.second);
+        });
+    }
+
+    void lut(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            const std::vector<float> &table = tables[insn.op.imm.u];
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            XmmReg limit, index, v[4];
+            Reg32 a;
+            Reg tbl, idx;
+            float maxidx = static_cast<float>(table.size() - 1);
+            uint32_t maxidxBits;
+            memcpy(&maxidxBits, &maxidx, sizeof(maxidxBits));
+            mov(a, maxidxBits);
+            VEX1(movd, limit, a);
+            VEX2IMM(shufps, limit, limit, limit, 0);
+            mov(tbl, reinterpret_cast<uintptr_t>(table.data()));
+
+            // no gather before avx2 so the lanes are looked up one at a time
+            for (int half = 0; half < 2; half++) {
+                XmmReg src = half ? t1.second : t1.first;
+                XmmReg dst = half ? t2.second : t2.first;
+                VEX2(maxps, index, src, zero);
+                VEX2(minps, index, index, limit);
+                VEX1(cvttps2dq, index, index);
+                for (int i = 0; i < 4; i++) {
+                    pextrw(idx, index, i * 2);
+                    VEX1(movss, v[i], dword_ptr[tbl + idx * 4]);
+                }
+                VEX2(unpcklps, v[0], v[0], v[1]);
+                VEX2(unpcklps, v[2], v[2], v[3]);
+                VEX2(movlhps, dst, v[0], v[2]);
+            }
+        });
+    }
+
     void main(Reg regptrs, Reg regoffs, Reg niter)
     {
         std::unordered_map<int, std::pair<XmmReg, XmmReg>> bytecodeRegs;
@@ -1012,7 +1073,7 @@ do { \
     }
 
 public:
-    explicit ExprCompiler128(int numInputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs), curLabel() {}
+    ExprCompiler128(int numInputs, const std::vector<std::vector<float>> &tables) : cpuFeatures(*getCPUFeatures()), tables(tables), numInputs(numInputs), curLabel() {}
 
     ExprData::ProcessLineProc getCode() override
     {
@@ -1133,6 +1194,7 @@ class ExprCompiler256 : public ExprCompiler, private jitasm::function<void, Expr
     std::vector<std::function<void(Reg, YmmReg, Reg, std::unordered_map<int, YmmReg> &)>> deferred;
 
     CPUFeatures cpuFeatures;
+    const std::vector<std::vector<float>> &tables;
     int numInputs;
     int curLabel;
 
@@ -1567,6 +1629,43 @@ do { \
         });
     }
 
+    void round(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            vroundps(t2, t1, 0);
+        });
+    }
+
+    void lut(const ExprInstruction &insn) override
+    {
+        deferred.push_back(EMIT()
+        {
+            const std::vector<float> &table = tables[insn.op.imm.u];
+            auto t1 = bytecodeRegs[insn.src1];
+            auto t2 = bytecodeRegs[insn.dst];
+            XmmReg r1;
+            YmmReg limit, index, mask;
+            Reg32 a;
+            Reg tbl;
+            float maxidx = static_cast<float>(table.size() - 1);
+            uint32_t maxidxBits;
+            memcpy(&maxidxBits, &maxidx, sizeof(maxidxBits));
+            mov(a, maxidxBits);
+            vmovd(r1, a);
+            vbroadcastss(limit, r1);
+            mov(tbl, reinterpret_cast<uintptr_t>(table.data()));
+            vmaxps(index, t1, zero);
+            vminps(index, index, limit);
+            vcvttps2dq(index, index);
+            vpcmpeqd(mask, mask, mask);
+            vmovaps(t2, zero);
+            vgatherdps(t2, dword_ptr[tbl + index * 4], mask);
+        });
+    }
+
     void main(Reg regptrs, Reg regoffs, Reg niter)
     {
         std::unordered_map<int, YmmReg> bytecodeRegs;
@@ -1604,7 +1703,7 @@ do { \
     }
 
 public:
-    explicit ExprCompiler256(int numInputs) : cpuFeatures(*getCPUFeatures()), numInputs(numInputs) {}
+    ExprCompiler256(int numInputs, const std::vector<std::vector<float>> &tables) : cpuFeatures(*getCPUFeatures()), tables(tables), numInputs(numInputs) {}
 
     ExprData::ProcessLineProc getCode() override
     {
@@ -1624,18 +1723,19 @@ public:
 
 constexpr ExprUnion ExprCompiler256::constData alignas(32)[39][8];
 
-std::unique_ptr<ExprCompiler> make_compiler(int numInputs, int cpulevel)
+std::unique_ptr<ExprCompiler> make_compiler(int numInputs, int cpulevel, const std::vector<std::vector<float>> &tables)
 {
     if (getCPUFeatures()->avx2 && cpulevel >= VS_CPU_LEVEL_AVX2)
-        return std::unique_ptr<ExprCompiler>(new ExprCompiler256(numInputs));
+        return std::unique_ptr<ExprCompiler>(new ExprCompiler256(numInputs, tables));
     else
-        return std::unique_ptr<ExprCompiler>(new ExprCompiler128(numInputs));
+        return std::unique_ptr<ExprCompiler>(new ExprCompiler128(numInputs, tables));
 }
 #endif
 
 class ExprInterpreter {
     const ExprInstruction *bytecode;
     size_t numInsns;
+    const std::vector<std::vector<float>> &tables;
     std::vector<float> registers;
 
     template <class T>
@@ -1648,7 +1748,7 @@ class ExprInterpreter {
     static float bool2float(bool x) { return x ? 1.0f : 0.0f; }
     static bool float2bool(float x) { return x > 0.0f; }
 public:
-    ExprInterpreter(const ExprInstruction *bytecode, size_t numInsns) : bytecode(bytecode), numInsns(numInsns)
+    ExprInterpreter(const ExprInstruction *bytecode, size_t numInsns, const std::vector<std::vector<float>> &tables) : bytecode(bytecode), numInsns(numInsns), tables(tables)
     {
         int maxreg = 0;
         for (size_t i = 0; i < numInsns; ++i) {
@@ -1689,6 +1789,12 @@ public:
             case ExprOpType::EXP: DST = std::exp(SRC1); break;
             case ExprOpType::LOG: DST = std::log(SRC1); break;
             case ExprOpType::POW: DST = std::pow(SRC1, SRC2); break;
+            case ExprOpType::ROUND: DST = std::nearbyint(SRC1); break;
+            case ExprOpType::LUT: {
+                const std::vector<float> &table = tables[insn.op.imm.u];
+                DST = table[static_cast<size_t>(std::min(std::max(SRC1, 0.0f), static_cast<float>(table.size() - 1)))];
+                break;
+            }
             case ExprOpType::SQRT: DST = std::sqrt(SRC1); break;
             case ExprOpType::ABS: DST = std::fabs(SRC1); break;
             case ExprOpType::NEG: DST = -SRC1; break;
@@ -1784,6 +1890,8 @@ public:
     ExpressionTreeNode *getRoot() { return root; }
     const ExpressionTreeNode *getRoot() const { return root; }
 
+    size_t size() const { return nodes.size(); }
+
     void setRoot(ExpressionTreeNode *node) { root = node; }
 
     ExpressionTreeNode *makeNode(ExprOp data)
@@ -1936,6 +2044,8 @@ ExpressionTree parseExpr(const std::string &expr, const VSVideoInfo * const *vi,
         1, // EXP
         1, // LOG
         2, // POW
+        1, // ROUND
+        1, // LUT
         3, // TERNARY
         0, // MUX
         0, // DUP
@@ -2033,6 +2143,7 @@ bool isConstantExpr(const ExpressionTreeNode &node)
     case ExprOpType::MEM_LOAD_U16:
     case ExprOpType::MEM_LOAD_F16:
     case ExprOpType::MEM_LOAD_F32:
+    case ExprOpType::LUT:
         return false;
     case ExprOpType::CONSTANT:
         return true;
@@ -2095,6 +2206,7 @@ float evalConstantExpr(const ExpressionTreeNode &node)
     case ExprOpType::EXP: return std::exp(LEFT);
     case ExprOpType::LOG: return std::log(LEFT);
     case ExprOpType::POW: return std::pow(LEFT, RIGHT);
+    case ExprOpType::ROUND: return std::nearbyint(LEFT);
     case ExprOpType::TERNARY: return float2bool(LEFT) ? RIGHTLEFT : RIGHTRIGHT;
     default: return NAN;
     }
@@ -3146,15 +3258,25 @@ static const VSFrameRef *VS_CC exprGetFrame(int n, int activationReason, void **
             vsapi->requestFrameFilter(n, d->node[i], frameCtx);
     } else if (activationReason == arAllFramesReady) {
         const VSFrameRef *src[MAX_EXPR_INPUTS] = {};
-        for (int i = 0; i < numInputs; i++)
+        for (int i = 1; i < numInputs; i++)
             src[i] = vsapi->getFrameFilter(n, d->node[i], frameCtx);
 
         const VSFormat *fi = d->vi.format;
-        int height = vsapi->getFrameHeight(src[0], 0);
-        int width = vsapi->getFrameWidth(src[0], 0);
-        int planes[3] = { 0, 1, 2 };
-        const VSFrameRef *srcf[3] = { d->plane[0] != poCopy ? nullptr : src[0], d->plane[1] != poCopy ? nullptr : src[0], d->plane[2] != poCopy ? nullptr : src[0] };
-        VSFrameRef *dst = vsapi->newVideoFrame2(fi, width, height, srcf, planes, src[0], core);
+        VSFrameRef *dst;
+
+        // every pixel is loaded before it's stored so the first clip can be overwritten when the format stays the same,
+        // the other inputs have to be fetched first since they may be the same frame
+        if (fi == vsapi->getVideoInfo(d->node[0])->format) {
+            dst = vsapi->getFrameFilterForModify(n, d->node[0], frameCtx);
+            src[0] = dst;
+        } else {
+            src[0] = vsapi->getFrameFilter(n, d->node[0], frameCtx);
+            int height = vsapi->getFrameHeight(src[0], 0);
+            int width = vsapi->getFrameWidth(src[0], 0);
+            int planes[3] = { 0, 1, 2 };
+            const VSFrameRef *srcf[3] = { d->plane[0] != poCopy ? nullptr : src[0], d->plane[1] != poCopy ? nullptr : src[0], d->plane[2] != poCopy ? nullptr : src[0] };
+            dst = vsapi->newVideoFrame2(fi, width, height, srcf, planes, src[0], core);
+        }
 
         const uint8_t *srcp[MAX_EXPR_INPUTS] = {};
         int src_stride[MAX_EXPR_INPUTS] = {};
@@ -3164,6 +3286,10 @@ static const VSFrameRef *VS_CC exprGetFrame(int n, int activationReason, void **
             if (d->plane[plane] != poProcess)
                 continue;
 
+            // get the write pointer first since it may copy the plane when working in place
+            uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+            int dst_stride = vsapi->getStride(dst, plane);
+
             for (int i = 0; i < numInputs; i++) {
                 if (d->node[i]) {
                     srcp[i] = vsapi->getReadPtr(src[i], plane);
@@ -3171,9 +3297,6 @@ static const VSFrameRef *VS_CC exprGetFrame(int n, int activationReason, void **
                     ptroffsets[i + 1] = vsapi->getFrameFormat(src[i])->bytesPerSample * 8;
                 }
             }
-
-            uint8_t *dstp = vsapi->getWritePtr(dst, plane);
-            int dst_stride = vsapi->getStride(dst, plane);
             int h = vsapi->getFrameHeight(dst, plane);
             int w = vsapi->getFrameWidth(dst, plane);
 
@@ -3194,7 +3317,7 @@ static const VSFrameRef *VS_CC exprGetFrame(int n, int activationReason, void **
                     proc(rwptrs, ptroffsets, niterations);
                 }
             } else {
-                ExprInterpreter interpreter(d->bytecode[plane].data(), d->bytecode[plane].size());
+                ExprInterpreter interpreter(d->bytecode[plane].data(), d->bytecode[plane].size(), d->tables);
 
                 for (int y = 0; y < h; y++) {
                     for (int x = 0; x < w; x++) {
@@ -3209,6 +3332,8 @@ static const VSFrameRef *VS_CC exprGetFrame(int n, int activationReason, void **
             }
         }
 
+        if (src[0] == dst)
+            src[0] = nullptr;
         for (int i = 0; i < MAX_EXPR_INPUTS; i++) {
             vsapi->freeFrame(src[i]);
         }
@@ -3220,13 +3345,168 @@ static const VSFrameRef *VS_CC exprGetFrame(int n, int activationReason, void **
 
 static void VS_CC exprFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
     ExprData *d = static_cast<ExprData *>(instanceData);
+    unregisterPointFilter(d);
     for (int i = 0; i < MAX_EXPR_INPUTS; i++)
         vsapi->freeNode(d->node[i]);
     delete d;
 }
 
+//////////////////////////////////////////
+// Merging of pointwise filters
+
+struct PointFilterChain {
+    VSCore *core;
+    int64_t id;
+    std::vector<PointFilterStage> stages;
+};
+
+// keyed by instance data since that's all the free functions get
+std::mutex pointFilterLock;
+std::unordered_map<void *, PointFilterChain> pointFilters;
+std::map<std::pair<VSCore *, int64_t>, void *> pointFilterNodes;
+
+// merged expressions grow quickly when stages use x several times
+#define MAX_MERGED_NODES 4096
+
+void registerPointFilterChain(void *instanceData, const VSMap *out, std::vector<PointFilterStage> stages, VSCore *core, const VSAPI *vsapi)
+{
+    int err;
+    VSNodeRef *node = vsapi->propGetNode(out, "clip", 0, &err);
+    if (err)
+        return;
+
+    VSNodeInfo info;
+    vsapi->getNodeInfo(node, &info);
+    vsapi->freeNode(node);
+
+    std::lock_guard<std::mutex> lock(pointFilterLock);
+    pointFilterNodes[std::make_pair(core, info.id)] = instanceData;
+    pointFilters[instanceData] = { core, info.id, std::move(stages) };
+}
+
+// The value the next stage reads, rounded and clamped the same way as when
+// it's stored in an intermediate frame
+ExpressionTreeNode *stageInput(ExpressionTree &tree, const ExpressionTreeNode *value, const VSFormat *format)
+{
+    if (!value) {
+        if (format->sampleType == stInteger && format->bytesPerSample == 1)
+            return tree.makeNode({ ExprOpType::MEM_LOAD_U8, 0 });
+        else if (format->sampleType == stInteger && format->bytesPerSample == 2)
+            return tree.makeNode({ ExprOpType::MEM_LOAD_U16, 0 });
+        else if (format->sampleType == stFloat && format->bytesPerSample == 2)
+            return tree.makeNode({ ExprOpType::MEM_LOAD_F16, 0 });
+        else
+            return tree.makeNode({ ExprOpType::MEM_LOAD_F32, 0 });
+    }
+
+    if (format->sampleType == stFloat && format->bytesPerSample == 2)
+        throw std::runtime_error("half precision intermediate");
+
+    ExpressionTreeNode *node = tree.clone(value);
+    if (format->sampleType == stInteger) {
+        ExpressionTreeNode *lower = tree.makeNode(ExprOpType::MAX);
+        lower->setLeft(node);
+        lower->setRight(tree.makeNode({ ExprOpType::CONSTANT, 0.0f }));
+        ExpressionTreeNode *upper = tree.makeNode(ExprOpType::MIN);
+        upper->setLeft(lower);
+        upper->setRight(tree.makeNode({ ExprOpType::CONSTANT, static_cast<float>((1 << format->bitsPerSample) - 1) }));
+        node = tree.makeNode(ExprOpType::ROUND);
+        node->setLeft(upper);
+    }
+    return node;
+}
+
+ExpressionTreeNode *substituteInput(ExpressionTree &tree, const ExpressionTreeNode *node, const std::function<ExpressionTreeNode *()> &input)
+{
+    if (!node)
+        return nullptr;
+    if (isOpCode(*node, { ExprOpType::MEM_LOAD_U8, ExprOpType::MEM_LOAD_U16, ExprOpType::MEM_LOAD_F16, ExprOpType::MEM_LOAD_F32 }))
+        return input();
+
+    ExpressionTreeNode *newnode = tree.makeNode(node->op);
+    newnode->setLeft(substituteInput(tree, node->left, input));
+    newnode->setRight(substituteInput(tree, node->right, input));
+    return newnode;
+}
+
+// Compiles the stages applied one after another to d->node[0] into a single program per plane
+void compileChain(ExprData *d, const std::vector<PointFilterStage> &stages, const VSFormat *srcFormat, int cpulevel)
+{
+    for (int plane = 0; plane < d->vi.format->numPlanes; plane++) {
+        ExpressionTree tree;
+        ExpressionTreeNode *value = nullptr;
+        const VSFormat *format = srcFormat;
+
+        for (const PointFilterStage &stage : stages) {
+            if (!stage.process[plane]) {
+                if (stage.format != format)
+                    throw std::runtime_error("unprocessed plane changes format");
+                continue;
+            }
+
+            const ExpressionTreeNode *prev = value;
+            if (!stage.lut[plane].empty()) {
+                if (format->sampleType != stInteger || stage.lut[plane].size() != static_cast<size_t>(1) << format->bitsPerSample)
+                    throw std::runtime_error("lut doesn't match the input format");
+                d->tables.push_back(stage.lut[plane]);
+                value = tree.makeNode({ ExprOpType::LUT, static_cast<uint32_t>(d->tables.size() - 1) });
+                value->setLeft(stageInput(tree, prev, format));
+            } else {
+                VSVideoInfo vi = d->vi;
+                vi.format = format;
+                const VSVideoInfo *vip = &vi;
+                ExpressionTree parsed = parseExpr(stage.expr[plane], &vip, 1);
+                value = substituteInput(tree, parsed.getRoot(), [&]() { return stageInput(tree, prev, format); });
+            }
+
+            format = stage.format;
+            if (tree.size() > MAX_MERGED_NODES)
+                throw std::runtime_error("merged expression too large");
+        }
+
+        if (!value) {
+            d->plane[plane] = poCopy;
+            continue;
+        }
+
+        d->plane[plane] = poProcess;
+        tree.setRoot(value);
+        d->bytecode[plane] = compile(tree, d->vi.format);
+    }
+
+#ifdef VS_TARGET_CPU_X86
+    for (int plane = 0; plane < d->vi.format->numPlanes; plane++) {
+        if (d->plane[plane] == poProcess) {
+            std::unique_ptr<ExprCompiler> compiler = make_compiler(d->numInputs, cpulevel, d->tables);
+            for (auto op : d->bytecode[plane])
+                compiler->addInstruction(op);
+            d->proc[plane] = compiler->getCode();
+            if (!d->proc[plane])
+                throw std::runtime_error("compilation failed");
+        }
+    }
+#ifdef VS_TARGET_OS_WINDOWS
+    FlushInstructionCache(GetCurrentProcess(), nullptr, 0);
+#endif
+#endif
+}
+
+bool isSupportedExprFormat(const VSFormat *format)
+{
+#ifdef VS_TARGET_CPU_X86
+    bool f16c = getCPUFeatures()->f16c;
+#else
+    bool f16c = false;
+#endif
+    if (format->sampleType == stInteger)
+        return format->bitsPerSample <= 16;
+    return format->bitsPerSample == 32 || (format->bitsPerSample == 16 && f16c);
+}
+
 static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<ExprData> d(new ExprData);
+    PointFilterStage stage = {};
+    bool pointwise = false;
     int err;
 
 #ifdef VS_TARGET_CPU_X86
@@ -3299,6 +3579,21 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
             expr[i] = expr[nexpr - 1];
         }
 
+        // a single input expression can be merged with the pointwise filters before and after it
+        pointwise = (d->numInputs == 1);
+        stage.format = d->vi.format;
+        for (int i = 0; i < d->vi.format->numPlanes; i++) {
+            stage.process[i] = !expr[i].empty();
+            stage.expr[i] = expr[i];
+            if (expr[i].empty() && d->vi.format != vi[0]->format)
+                pointwise = false;
+        }
+
+        if (pointwise && fusePointFilter(d->node[0], stage, out, core, vsapi)) {
+            vsapi->freeNode(d->node[0]);
+            return;
+        }
+
         for (int i = 0; i < 3; i++) {
             if (!expr[i].empty()) {
                 d->plane[i] = poProcess;
@@ -3320,7 +3615,7 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
                 for (int i = 0; i < d->vi.format->numPlanes; i++) {
                     if (d->plane[i] == poProcess) {
 #ifdef VS_TARGET_CPU_X86
-                        std::unique_ptr<ExprCompiler> compiler = make_compiler(d->numInputs, cpulevel);
+                        std::unique_ptr<ExprCompiler> compiler = make_compiler(d->numInputs, cpulevel, d->tables);
                         for (auto op : d->bytecode[i]) {
                             compiler->addInstruction(op);
                         }
@@ -3342,7 +3637,10 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
         return;
     }
 
-    vsapi->createFilter(in, out, "Expr", exprInit, exprGetFrame, exprFree, fmParallel, 0, d.release(), core);
+    ExprData *data = d.release();
+    vsapi->createFilter(in, out, "Expr", exprInit, exprGetFrame, exprFree, fmParallel, 0, data, core);
+    if (pointwise)
+        registerPointFilterChain(data, out, { stage }, core, vsapi);
 }
 
 } // namespace
@@ -3351,6 +3649,78 @@ static void VS_CC exprCreate(const VSMap *in, VSMap *out, void *userData, VSCore
 //////////////////////////////////////////
 // Init
 
+bool fusePointFilter(VSNodeRef *node, const PointFilterStage &stage, VSMap *out, VSCore *core, const VSAPI *vsapi) {
+#ifdef VS_TARGET_CPU_X86
+    // the interpreter is a lot slower than the separate filters
+    int cpulevel = vs_get_cpulevel(core);
+    if (cpulevel == VS_CPU_LEVEL_NONE)
+        return false;
+
+    // look through the cache that's usually inserted after the previous filter
+    VSNodeInfo info;
+    vsapi->getNodeInfo(node, &info);
+    VSNodeRef *producer = (info.flags & nfIsCache) ? vsapi->getNodeInput(node, 0) : vsapi->cloneNodeRef(node);
+    if (!producer)
+        return false;
+    vsapi->getNodeInfo(producer, &info);
+
+    std::vector<PointFilterStage> stages;
+    {
+        std::lock_guard<std::mutex> lock(pointFilterLock);
+        auto iter = pointFilterNodes.find(std::make_pair(core, info.id));
+        if (iter != pointFilterNodes.end())
+            stages = pointFilters[iter->second].stages;
+    }
+
+    VSNodeRef *source = stages.empty() ? nullptr : vsapi->getNodeInput(producer, 0);
+    vsapi->freeNode(producer);
+    if (!source)
+        return false;
+
+    stages.push_back(stage);
+
+    std::unique_ptr<ExprData> d(new ExprData);
+    d->node[0] = source;
+    d->numInputs = 1;
+    d->vi = *vsapi->getVideoInfo(source);
+    d->vi.format = stage.format;
+
+    try {
+        if (!isSupportedExprFormat(vsapi->getVideoInfo(source)->format) || !isSupportedExprFormat(stage.format))
+            throw std::runtime_error("unsupported format");
+        compileChain(d.get(), stages, vsapi->getVideoInfo(source)->format, cpulevel);
+    } catch (std::runtime_error &) {
+        // simply don't merge
+        vsapi->freeNode(source);
+        return false;
+    }
+
+    // the merged filter only depends on the first filter's input
+    VSMap *args = vsapi->createMap();
+    vsapi->propSetNode(args, "clips", source, paReplace);
+    ExprData *data = d.release();
+    vsapi->createFilter(args, out, "Expr", exprInit, exprGetFrame, exprFree, fmParallel, 0, data, core);
+    vsapi->freeMap(args);
+    registerPointFilterChain(data, out, std::move(stages), core, vsapi);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void registerPointFilter(void *instanceData, const VSMap *out, const PointFilterStage &stage, VSCore *core, const VSAPI *vsapi) {
+    registerPointFilterChain(instanceData, out, { stage }, core, vsapi);
+}
+
+void unregisterPointFilter(void *instanceData) {
+    std::lock_guard<std::mutex> lock(pointFilterLock);
+    auto iter = pointFilters.find(instanceData);
+    if (iter != pointFilters.end()) {
+        pointFilterNodes.erase(std::make_pair(iter->second.core, iter->second.id));
+        pointFilters.erase(iter);
+    }
+}
+
 void VS_CC exprInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
     //configFunc("com.vapoursynth.expr", "expr", "VapourSynth Expr Filter", VAPOURSYNTH_API_VERSION, 1, plugin);
     registerFunc("Expr", "clips:clip[];expr:data[];format:int:opt;", exprCreate, nullptr, plugin);
@@ -89,6 +89,18 @@ static void VS_CC singleClipFree(void *instanceData, VSCore *core, const VSAPI *
     free(instanceData);
 }
 
+// Declares hints for the clips a filter's create function just stored in out.
+// Does nothing if creating the filter failed.
+static inline void setOutputHints(VSMap *out, int flags, int spatialRadius, int temporalRadius, int untouchedPlanes, const VSAPI *vsapi) {
+    VSFilterHints hints = { flags, spatialRadius, temporalRadius, untouchedPlanes };
+    int numClips = vsapi->propNumElements(out, "clip");
+    for (int i = 0; i < numClips; i++) {
+        VSNodeRef *node = vsapi->propGetNode(out, "clip", i, NULL);
+        vsapi->setFilterHints(node, &hints);
+        vsapi->freeNode(node);
+    }
+}
+
 static inline int64_t floatToInt64S(float f) {
     if (f > INT64_MAX)
         return INT64_MAX;
@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "frametrace.h"
+#include "vscore.h"
+#include <cinttypes>
+#include <cstdio>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#include "../common/vsutf16.h"
+#endif
+
+static std::atomic<uint64_t> tracerSerial(0);
+
+// the buffer the calling thread used last, looked up again when it records for another core
+struct ThreadBufferCache {
+    uint64_t serial = UINT64_MAX;
+    void *buffer = nullptr;
+    bool worker = false;
+};
+
+static thread_local ThreadBufferCache threadBuffer;
+
+FrameTracer::Buffer::~Buffer() {
+    Chunk *chunk = head.next;
+    while (chunk) {
+        Chunk *next = chunk->next;
+        delete chunk;
+        chunk = next;
+    }
+}
+
+FrameTracer::FrameTracer() : serial(tracerSerial++), enabled(false), generation(0), startTime(0) {
+}
+
+void FrameTracer::setWorkerThread() {
+    threadBuffer.worker = true;
+}
+
+FrameTracer::Buffer *FrameTracer::getThreadBuffer() {
+    if (threadBuffer.serial == serial)
+        return static_cast<Buffer *>(threadBuffer.buffer);
+
+    std::lock_guard<std::mutex> l(lock);
+    Buffer *buffer = nullptr;
+    for (const auto &iter : buffers) {
+        if (iter->threadId == std::this_thread::get_id())
+            buffer = iter.get();
+    }
+    if (!buffer) {
+        buffers.emplace_back(new Buffer(static_cast<int>(buffers.size()) + 1, threadBuffer.worker));
+        buffer = buffers.back().get();
+    }
+    threadBuffer.serial = serial;
+    threadBuffer.buffer = buffer;
+    return buffer;
+}
+
+int64_t FrameTracer::registerNode(VSNode *node) {
+    if (!node)
+        return -1;
+    unsigned currentGeneration = generation;
+    if (node->traceGeneration.exchange(currentGeneration) != currentGeneration) {
+        std::lock_guard<std::mutex> l(lock);
+        nodeNames[node->id] = node->name;
+    }
+    return node->id;
+}
+
+void FrameTracer::add(TraceEventType type, int64_t nodeId, int n, int activationReason, int64_t start, int64_t end) {
+    Buffer *buffer = getThreadBuffer();
+    unsigned currentGeneration = generation;
+
+    // only the owning thread touches the chunks so a new trace simply starts writing from the beginning again
+    if (buffer->generation.load(std::memory_order_relaxed) != currentGeneration) {
+        for (Chunk *chunk = &buffer->head; chunk; chunk = chunk->next)
+            chunk->size.store(0, std::memory_order_relaxed);
+        buffer->current = &buffer->head;
+        buffer->generation.store(currentGeneration, std::memory_order_release);
+    }
+
+    Chunk *chunk = buffer->current;
+    size_t size = chunk->size.load(std::memory_order_relaxed);
+    if (size == chunkSize) {
+        Chunk *next = chunk->next;
+        if (!next) {
+            next = new Chunk();
+            chunk->next.store(next, std::memory_order_release);
+        }
+        buffer->current = chunk = next;
+        size = 0;
+    }
+
+    TraceEvent &e = chunk->events[size];
+    e.start = start;
+    e.duration = end - start;
+    e.nodeId = nodeId;
+    e.n = n;
+    e.type = static_cast<int8_t>(type);
+    e.activationReason = static_cast<int8_t>(activationReason);
+    // publishes the event to stop()
+    chunk->size.store(size + 1, std::memory_order_release);
+}
+
+void FrameTracer::start() {
+    std::lock_guard<std::mutex> l(lock);
+    nodeNames.clear();
+    startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    ++generation;
+    enabled = true;
+}
+
+static void appendJSONString(std::string &buf, const std::string &s) {
+    buf += '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            buf += '\\';
+            buf += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char tmp[8];
+            snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+            buf += tmp;
+        } else {
+            buf += c;
+        }
+    }
+    buf += '"';
+}
+
+static FILE *openFile(const std::string &path, const char *mode) {
+#ifdef VS_TARGET_OS_WINDOWS
+    return _wfopen(utf16_from_utf8(path).c_str(), utf16_from_utf8(mode).c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+bool FrameTracer::stop(const std::string &filename) {
+    std::lock_guard<std::mutex> l(lock);
+    enabled = false;
+
+    static const char *reasonNames[] = { "initial", "frame_ready", "all_frames_ready" };
+    static const char *categories[] = { "getframe", "output", "idle", "request", "busy" };
+    unsigned currentGeneration = generation;
+
+    std::string buf = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char tmp[256];
+    bool first = true;
+    for (const auto &buffer : buffers) {
+        snprintf(tmp, sizeof(tmp), "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s %d\"}}",
+            first ? "" : ",\n", buffer->tid, buffer->worker ? "Worker" : "Thread", buffer->tid);
+        buf += tmp;
+        first = false;
+
+        // threads that haven't recorded anything since the trace was started still hold events from an earlier one
+        if (buffer->generation.load(std::memory_order_acquire) != currentGeneration)
+            continue;
+
+        for (const Chunk *chunk = &buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t size = chunk->size.load(std::memory_order_acquire);
+            for (size_t i = 0; i < size; i++) {
+                const TraceEvent &e = chunk->events[i];
+                buf += ",\n{\"name\":";
+                if (e.type == teIdle) {
+                    buf += "\"idle\"";
+                } else {
+                    auto name = nodeNames.find(e.nodeId);
+                    appendJSONString(buf, name != nodeNames.end() ? name->second : std::string("unknown"));
+                }
+                if (e.type == teRequest || e.type == teBusy)
+                    snprintf(tmp, sizeof(tmp), ",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", categories[e.type], buffer->tid, e.start / 1000.0);
+                else
+                    snprintf(tmp, sizeof(tmp), ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", categories[e.type], buffer->tid, e.start / 1000.0, e.duration / 1000.0);
+                buf += tmp;
+                if (e.type == teRun) {
+                    snprintf(tmp, sizeof(tmp), ",\"args\":{\"node\":%" PRId64 ",\"frame\":%d,\"reason\":\"%s\"}}", e.nodeId, e.n, e.activationReason == arError ? "error" : reasonNames[e.activationReason]);
+                } else if (e.type != teIdle) {
+                    snprintf(tmp, sizeof(tmp), ",\"args\":{\"node\":%" PRId64 ",\"frame\":%d}}", e.nodeId, e.n);
+                } else {
+                    snprintf(tmp, sizeof(tmp), "}");
+                }
+                buf += tmp;
+            }
+        }
+    }
+    buf += "\n]}\n";
+
+    FILE *f = openFile(filename, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+    return !fclose(f) && ok;
+}
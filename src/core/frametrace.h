@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef FRAMETRACE_H
+#define FRAMETRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct VSNode;
+
+enum TraceEventType {
+    teRun,      // a getframe call
+    teOutput,   // a frame or error delivered to the requester
+    teIdle,     // a worker waiting for work
+    teRequest,  // a frame request that was queued
+    teBusy      // a queued task that was passed over because its filter was busy
+};
+
+struct TraceEvent {
+    int64_t start; // nanoseconds since the trace was started
+    int64_t duration;
+    int64_t nodeId;
+    int n;
+    int8_t type;
+    int8_t activationReason;
+};
+
+// Records what the thread pool does into one buffer per thread that only the owning thread appends to,
+// so recording never takes a lock. The buffers are kept until the core is freed and reused by later traces.
+class FrameTracer {
+private:
+    static const size_t chunkSize = 4096;
+
+    struct Chunk {
+        TraceEvent events[chunkSize];
+        std::atomic<size_t> size;
+        std::atomic<Chunk *> next;
+        Chunk() : size(0), next(nullptr) {}
+    };
+
+    struct Buffer {
+        Chunk head;
+        Chunk *current;
+        std::atomic<unsigned> generation; // the trace the events belong to
+        std::thread::id threadId;
+        int tid;
+        bool worker;
+        Buffer(int tid, bool worker) : current(&head), generation(0), threadId(std::this_thread::get_id()), tid(tid), worker(worker) {}
+        ~Buffer();
+    };
+
+    const uint64_t serial;
+    std::atomic<bool> enabled;
+    std::atomic<unsigned> generation;
+    std::atomic<int64_t> startTime; // steady clock time in nanoseconds
+    std::mutex lock;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    std::map<int64_t, std::string> nodeNames;
+
+    Buffer *getThreadBuffer();
+public:
+    FrameTracer();
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+    int64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - startTime.load(std::memory_order_relaxed);
+    }
+    // records the node's name for the current trace and returns the id events refer to it by, -1 for null
+    int64_t registerNode(VSNode *node);
+    // nodeId is -1 for events that don't belong to a filter
+    void add(TraceEventType type, int64_t nodeId, int n, int activationReason, int64_t start, int64_t end);
+    // node may be null for events that don't belong to a filter
+    void add(TraceEventType type, VSNode *node, int n, int activationReason, int64_t start, int64_t end) {
+        add(type, registerNode(node), n, activationReason, start, end);
+    }
+    void start();
+    // stops recording and writes the events as Chrome trace event JSON, returns false if the file couldn't be written
+    bool stop(const std::string &filename);
+    // marks the calling thread as a thread pool worker in the trace
+    static void setWorkerThread();
+};
+
+#endif // FRAMETRACE_H
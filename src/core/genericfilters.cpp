@@ -24,15 +24,23 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <locale>
+#include <sstream>
 #include <string>
 #include <array>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <VapourSynth.h>
 #include <VSHelper.h>
 #include "cpufeatures.h"
 #include "filtershared.h"
 #include "filtersharedcpp.h"
+#include "internalfilters.h"
+#include "kernel/autotune.h"
 #include "kernel/cpulevel.h"
 #include "kernel/generic.h"
 
@@ -95,6 +103,8 @@ struct GenericData {
     bool saturate;
 
     int cpulevel;
+    // the kernel for every processed plane, picked when the filter is created
+    decltype(&vs_generic_3x3_conv_byte_c) funcs[3];
 };
 
 template<typename T, typename OP>
@@ -104,56 +114,319 @@ static const VSFrameRef *VS_CC singlePixelGetFrame(int n, int activationReason,
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
-        const VSFormat *fi = vsapi->getFrameFormat(src);
+        // the output format is always the same as the input so the frame can be processed in place
+        VSFrameRef *dst = vsapi->getFrameFilterForModify(n, d->node, frameCtx);
+        const VSFormat *fi = vsapi->getFrameFormat(dst);
 
         try {
             shared816FFormatCheck(fi);
         } catch (const std::runtime_error &error) {
             vsapi->setFilterError((d->name + ": "_s + error.what()).c_str(), frameCtx);
-            vsapi->freeFrame(src);
+            vsapi->freeFrame(dst);
             return nullptr;
         }
 
-        const int pl[] = { 0, 1, 2 };
-        const VSFrameRef *fr[] = {
-            d->process[0] ? nullptr : src,
-            d->process[1] ? nullptr : src,
-            d->process[2] ? nullptr : src
-        };
-
-        VSFrameRef *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
-
         for (int plane = 0; plane < fi->numPlanes; plane++) {
             if (d->process[plane]) {
                 OP opts(d, fi, plane);
-                uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
-                const uint8_t * VS_RESTRICT srcp = vsapi->getReadPtr(src, plane);
-                int width = vsapi->getFrameWidth(src, plane);
-                int height = vsapi->getFrameHeight(src, plane);
-                ptrdiff_t stride = vsapi->getStride(src, plane);
+                uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+                int width = vsapi->getFrameWidth(dst, plane);
+                int height = vsapi->getFrameHeight(dst, plane);
+                ptrdiff_t stride = vsapi->getStride(dst, plane);
 
                 for (int h = 0; h < height; h++) {
                     if (fi->bytesPerSample == 1)
-                        OP::template processPlane<uint8_t>(srcp, dstp, width, opts);
+                        OP::template processPlane<uint8_t>(dstp, dstp, width, opts);
                     else if (fi->bytesPerSample == 2)
-                        OP::template processPlane<uint16_t>(reinterpret_cast<const uint16_t *>(srcp), reinterpret_cast<uint16_t *>(dstp), width, opts);
+                        OP::template processPlane<uint16_t>(reinterpret_cast<const uint16_t *>(dstp), reinterpret_cast<uint16_t *>(dstp), width, opts);
                     else if (fi->bytesPerSample == 4)
-                        OP::template processPlaneF<float>(reinterpret_cast<const float *>(srcp), reinterpret_cast<float *>(dstp), width, opts);
-                    srcp += stride;
+                        OP::template processPlaneF<float>(reinterpret_cast<const float *>(dstp), reinterpret_cast<float *>(dstp), width, opts);
                     dstp += stride;
                 }
             }
         }
 
-        vsapi->freeFrame(src);
+        return dst;
+    }
+
+    return nullptr;
+}
+
+//////////////////////////////////////////
+// Strip-mined chains
+
+// Filters that only look at a few rows above and below each output row can be
+// run together strip by strip. A chain of them reads its input frame, keeps the
+// intermediate rows in two small buffers that stay in cache and only writes the
+// final output frame. Each strip is computed with enough extra rows for the
+// whole chain's vertical support, the kernels themselves are unchanged.
+
+typedef std::function<void(const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned width, unsigned height)> StripFunc;
+
+struct StripStage {
+    int radius; // rows needed above and below
+    int spatialRadius; // pixels needed in any direction
+    bool process[3];
+    StripFunc func[3];
+};
+
+struct StripChain {
+    VSCore *core;
+    int64_t id;
+    std::vector<StripStage> stages;
+};
+
+struct StripChainData {
+    VSNodeRef *node;
+    const VSVideoInfo *vi;
+    const char *name;
+    std::vector<StripStage> stages;
+};
+
+// keyed by instance data since that's all the free functions get
+static std::mutex stripFilterLock;
+static std::unordered_map<void *, StripChain> stripFilters;
+static std::map<std::pair<VSCore *, int64_t>, void *> stripFilterNodes;
+
+// the extra rows computed for every strip grow with the chain's support
+static const int maxStripRadius = 8;
+// size of each intermediate row buffer, it's made bigger when that's needed to fit the minimum strip height
+static const size_t stripBufferSize = 128 * 1024;
+// strips are at least this many times the chain's radius high so the recomputed rows stay a small fraction of the work
+static const int minStripRadiusMultiple = 8;
+
+static void registerStripFilter(void *instanceData, const VSMap *out, std::vector<StripStage> stages, VSCore *core, const VSAPI *vsapi) {
+    int err;
+    VSNodeRef *node = vsapi->propGetNode(out, "clip", 0, &err);
+    if (err)
+        return;
+
+    VSNodeInfo info;
+    vsapi->getNodeInfo(node, &info);
+    vsapi->freeNode(node);
+
+    std::lock_guard<std::mutex> lock(stripFilterLock);
+    stripFilterNodes[std::make_pair(core, info.id)] = instanceData;
+    stripFilters[instanceData] = { core, info.id, std::move(stages) };
+}
+
+static void unregisterStripFilter(void *instanceData) {
+    std::lock_guard<std::mutex> lock(stripFilterLock);
+    auto iter = stripFilters.find(instanceData);
+    if (iter != stripFilters.end()) {
+        stripFilterNodes.erase(std::make_pair(iter->second.core, iter->second.id));
+        stripFilters.erase(iter);
+    }
+}
+
+template<typename T>
+static void VS_CC stripFilterFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    unregisterStripFilter(instanceData);
+    templateNodeFree<T>(instanceData, core, vsapi);
+}
+
+// Invert, Limiter, Binarize and Levels can also be merged with other pointwise filters
+template<typename T>
+static void VS_CC pointFilterFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    unregisterPointFilter(instanceData);
+    stripFilterFree<T>(instanceData, core, vsapi);
+}
+
+// the planes a filter copies unchanged from its input
+template<typename T>
+static int unprocessedPlanes(const T *d, const VSFormat *fi) {
+    int mask = 0;
+    for (int i = 0; i < (fi ? fi->numPlanes : 3); i++)
+        if (!d->process[i])
+            mask |= 1 << i;
+    return mask;
+}
+
+static void stripPlane(const std::vector<const StripStage *> &stages, int plane, const uint8_t *srcp, ptrdiff_t src_stride, uint8_t *dstp, ptrdiff_t dst_stride, int width, int height, int bytesPerSample, VSFrameContext *frameCtx, const VSAPI *vsapi) {
+    int radius = 0;
+    for (const StripStage *stage : stages)
+        radius += stage->radius;
+
+    ptrdiff_t buf_stride = (width * bytesPerSample + 63) & ~63;
+    int strip = std::max({ 16, minStripRadiusMultiple * radius, static_cast<int>(stripBufferSize / buf_stride) - 2 * radius });
+    // the last strip takes the remainder so no kernel sees a tiny plane
+    int maxRows = std::min(height, 2 * strip - 1 + 2 * radius);
+    uint8_t *buf[2] = {
+        static_cast<uint8_t *>(vsapi->allocScratch(buf_stride * maxRows, frameCtx)),
+        static_cast<uint8_t *>(vsapi->allocScratch(buf_stride * maxRows, frameCtx))
+    };
+
+    for (int y0 = 0; y0 < height;) {
+        int y1 = (height - y0 < 2 * strip) ? height : y0 + strip;
+        int halo = radius;
+        int first = std::max(0, y0 - halo);
+        int last = std::min(height, y1 + halo);
+        const uint8_t *in = srcp + first * src_stride;
+        ptrdiff_t in_stride = src_stride;
+
+        // every stage filters all rows it gets, the rows near a strip edge
+        // that aren't a frame edge are wrong and get dropped for the next stage
+        for (size_t i = 0; i < stages.size(); i++) {
+            uint8_t *outp = buf[i % 2];
+            stages[i]->func[plane](in, in_stride, outp, buf_stride, width, last - first);
+            halo -= stages[i]->radius;
+            int next_first = std::max(0, y0 - halo);
+            in = outp + (next_first - first) * buf_stride;
+            in_stride = buf_stride;
+            first = next_first;
+            last = std::min(height, y1 + halo);
+        }
 
+        vs_bitblt(dstp + y0 * dst_stride, static_cast<int>(dst_stride), in, static_cast<int>(in_stride), width * bytesPerSample, y1 - y0);
+        y0 = y1;
+    }
+}
+
+static const VSFrameRef *VS_CC stripChainGetframe(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    StripChainData *d = static_cast<StripChainData *>(*instanceData);
+
+    if (activationReason == arInitial) {
+        vsapi->requestFrameFilter(n, d->node, frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+        const VSFormat *fi = vsapi->getFrameFormat(src);
+
+        // reject the same frames the filters would on their own
+        try {
+            shared816FFormatCheck(fi);
+            bool spatial = false;
+            for (const StripStage &stage : d->stages)
+                spatial = spatial || stage.spatialRadius > 0;
+            if (spatial && (vsapi->getFrameWidth(src, fi->numPlanes - 1) < 4 || vsapi->getFrameHeight(src, fi->numPlanes - 1) < 4))
+                throw std::runtime_error("Cannot process frames with subsampled planes smaller than 4x4.");
+        } catch (const std::runtime_error &error) {
+            vsapi->setFilterError((d->name + ": "_s + error.what()).c_str(), frameCtx);
+            vsapi->freeFrame(src);
+            return nullptr;
+        }
+
+        std::vector<const StripStage *> stages[3];
+        for (int plane = 0; plane < fi->numPlanes; plane++)
+            for (const StripStage &stage : d->stages)
+                if (stage.process[plane])
+                    stages[plane].push_back(&stage);
+
+        const int pl[] = { 0, 1, 2 };
+        const VSFrameRef *fr[] = {
+            stages[0].empty() ? src : nullptr,
+            stages[1].empty() ? src : nullptr,
+            stages[2].empty() ? src : nullptr
+        };
+
+        VSFrameRef *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
+
+        for (int plane = 0; plane < fi->numPlanes; plane++) {
+            if (!stages[plane].empty())
+                stripPlane(stages[plane], plane, vsapi->getReadPtr(src, plane), vsapi->getStride(src, plane), vsapi->getWritePtr(dst, plane), vsapi->getStride(dst, plane),
+                    vsapi->getFrameWidth(src, plane), vsapi->getFrameHeight(src, plane), fi->bytesPerSample, frameCtx, vsapi);
+        }
+
+        vsapi->freeFrame(src);
         return dst;
     }
 
     return nullptr;
 }
 
+// Called before a filter with the given stage creates its node. When node
+// comes from another strip filter or chain the stage is appended to it and a
+// chain reading that filter's input is stored in out.
+static bool fuseStripFilter(VSNodeRef *node, const StripStage &stage, const char *name, VSMap *out, VSCore *core, const VSAPI *vsapi) {
+    // look through the cache that's usually inserted after the previous filter
+    VSNodeInfo info;
+    vsapi->getNodeInfo(node, &info);
+    VSNodeRef *producer = (info.flags & nfIsCache) ? vsapi->getNodeInput(node, 0) : vsapi->cloneNodeRef(node);
+    if (!producer)
+        return false;
+    vsapi->getNodeInfo(producer, &info);
+
+    std::vector<StripStage> stages;
+    {
+        std::lock_guard<std::mutex> lock(stripFilterLock);
+        auto iter = stripFilterNodes.find(std::make_pair(core, info.id));
+        if (iter != stripFilterNodes.end())
+            stages = stripFilters[iter->second].stages;
+    }
+
+    int radius = stage.radius;
+    for (const StripStage &s : stages)
+        radius += s.radius;
+
+    VSNodeRef *source = (stages.empty() || radius > maxStripRadius) ? nullptr : vsapi->getNodeInput(producer, 0);
+    vsapi->freeNode(producer);
+    if (!source)
+        return false;
+
+    stages.push_back(stage);
+
+    std::unique_ptr<StripChainData> d(new StripChainData);
+    d->node = source;
+    d->vi = vsapi->getVideoInfo(source);
+    d->name = name;
+    d->stages = stages;
+
+    // the chain only depends on the first filter's input
+    VSMap *args = vsapi->createMap();
+    vsapi->propSetNode(args, "clip", source, paReplace);
+    vsapi->createFilter(args, out, name, templateNodeInit<StripChainData>, stripChainGetframe, stripFilterFree<StripChainData>, fmParallel, 0, d.get(), core);
+    vsapi->freeMap(args);
+
+    int spatialRadius = 0;
+    int untouchedPlanes = 0;
+    for (int plane = 0; plane < (d->vi->format ? d->vi->format->numPlanes : 3); plane++)
+        untouchedPlanes |= 1 << plane;
+    for (const StripStage &s : stages) {
+        spatialRadius += s.spatialRadius;
+        for (int plane = 0; plane < 3; plane++)
+            if (s.process[plane])
+                untouchedPlanes &= ~(1 << plane);
+    }
+    setOutputHints(out, spatialRadius ? fhPure : (fhPure | fhPointwise), spatialRadius, 0, untouchedPlanes, vsapi);
+    registerStripFilter(d.get(), out, std::move(stages), core, vsapi);
+    d.release();
+    return true;
+}
+
+template<typename OP, typename T>
+static StripStage pointStripStage(T *d, const VSFormat *fi) {
+    StripStage stage = {};
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        stage.process[plane] = d->process[plane];
+        if (!d->process[plane])
+            continue;
+
+        OP opts(d, fi, plane);
+        int bytesPerSample = fi->bytesPerSample;
+        stage.func[plane] = [opts, bytesPerSample](const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned width, unsigned height) {
+            for (unsigned h = 0; h < height; h++) {
+                if (bytesPerSample == 1)
+                    OP::template processPlane<uint8_t>(src, dst, width, opts);
+                else if (bytesPerSample == 2)
+                    OP::template processPlane<uint16_t>(reinterpret_cast<const uint16_t *>(src), reinterpret_cast<uint16_t *>(dst), width, opts);
+                else
+                    OP::template processPlaneF<float>(reinterpret_cast<const float *>(src), reinterpret_cast<float *>(dst), width, opts);
+                src += src_stride;
+                dst += dst_stride;
+            }
+        };
+    }
+    return stage;
+}
+
+// enough digits to get exactly the same float back when the expression is parsed
+static std::string exprConstant(float v) {
+    std::ostringstream stream;
+    stream.imbue(std::locale::classic());
+    stream.precision(9);
+    stream << v;
+    return stream.str();
+}
+
 template<typename T>
 static void templateInit(T& d, const char *name, bool allowVariableFormat, const VSMap *in, VSMap *out, const VSAPI *vsapi) {
     *d = {};
@@ -354,6 +627,82 @@ static decltype(&vs_generic_3x3_conv_byte_c) genericSelectC(const VSFormat *fi,
     return nullptr;
 }
 
+template <GenericOperations op>
+static decltype(&vs_generic_3x3_conv_byte_c) genericSelect(const VSFormat *fi, GenericData *d) {
+    decltype(&vs_generic_3x3_conv_byte_c) func = nullptr;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2)
+        func = genericSelectAVX2<op>(fi, d);
+    if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2)
+        func = genericSelectSSE2<op>(fi, d);
+#endif
+    if (!func)
+        func = genericSelectC<op>(fi, d);
+
+    return func;
+}
+
+template <GenericOperations op>
+static const char *genericKernelName(const GenericData *d) {
+    if (op != GenericConvolution)
+        return d->filter_name;
+    else if (d->convolution_type == ConvolutionHorizontal)
+        return "ConvolutionH";
+    else if (d->convolution_type == ConvolutionVertical)
+        return "ConvolutionV";
+    else if (d->matrix_elements == 9)
+        return "Convolution3x3";
+    else
+        return "Convolution5x5";
+}
+
+static void genericAutotuneRun(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque) {
+    reinterpret_cast<decltype(&vs_generic_3x3_conv_byte_c)>(func)(buffers[0], stride, buffers[1], stride, static_cast<const vs_generic_params *>(opaque), width, height);
+}
+
+// picks the fastest of the allowed kernels for planes of this size instead of the one for the highest cpu level
+template <GenericOperations op>
+static decltype(&vs_generic_3x3_conv_byte_c) genericSelectTuned(const VSFormat *fi, GenericData *d, vs_generic_params &params, unsigned width, unsigned height) {
+    vs_autotune_func funcs[3];
+    int levels[3];
+    int count = 0;
+
+#ifdef VS_TARGET_CPU_X86
+    if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
+        funcs[count] = reinterpret_cast<vs_autotune_func>(genericSelectAVX2<op>(fi, d));
+        levels[count] = VS_CPU_LEVEL_AVX2;
+        count += !!funcs[count];
+    }
+    if (d->cpulevel >= VS_CPU_LEVEL_SSE2) {
+        funcs[count] = reinterpret_cast<vs_autotune_func>(genericSelectSSE2<op>(fi, d));
+        levels[count] = VS_CPU_LEVEL_SSE2;
+        count += !!funcs[count];
+    }
+#endif
+    funcs[count] = reinterpret_cast<vs_autotune_func>(genericSelectC<op>(fi, d));
+    levels[count] = VS_CPU_LEVEL_NONE;
+    count += !!funcs[count];
+
+    return reinterpret_cast<decltype(&vs_generic_3x3_conv_byte_c)>(vs_autotune_select(genericKernelName<op>(d), vs_autotune_pixel(fi->bytesPerSample),
+        width, height, 2, funcs, levels, count, genericAutotuneRun, &params));
+}
+
+// with autotune set the planes of clips with constant dimensions get the fastest kernel for their size, the others the one for the highest cpu level
+template <GenericOperations op>
+static void genericSelectPlanes(GenericData *d, bool autotune) {
+    const VSFormat *fi = d->vi->format;
+    decltype(&vs_generic_3x3_conv_byte_c) func = genericSelect<op>(fi, d);
+
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        d->funcs[plane] = func;
+        if (d->process[plane] && func && autotune && d->vi->width && d->vi->height) {
+            vs_generic_params params = make_generic_params(d, fi, plane);
+            d->funcs[plane] = genericSelectTuned<op>(fi, d, params, planeWidth(d->vi, plane), planeHeight(d->vi, plane));
+        }
+    }
+}
+
 template <GenericOperations op>
 static const VSFrameRef *VS_CC genericGetframe(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     GenericData *d = static_cast<GenericData *>(*instanceData);
@@ -384,19 +733,8 @@ static const VSFrameRef *VS_CC genericGetframe(int n, int activationReason, void
 
         VSFrameRef *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
 
-        void (*func)(const void *, ptrdiff_t, void *, ptrdiff_t, const vs_generic_params *, unsigned, unsigned) = nullptr;
-
-#ifdef VS_TARGET_CPU_X86
-        if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2)
-            func = genericSelectAVX2<op>(fi, d);
-        if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2)
-            func = genericSelectSSE2<op>(fi, d);
-#endif
-        if (!func)
-            func = genericSelectC<op>(fi, d);
-
         for (int plane = 0; plane < fi->numPlanes; plane++) {
-            if (func && d->process[plane]) {
+            if (d->funcs[plane] && d->process[plane]) {
                 uint8_t *dstp = vsapi->getWritePtr(dst, plane);
                 const uint8_t *srcp = vsapi->getReadPtr(src, plane);
                 int width = vsapi->getFrameWidth(src, plane);
@@ -405,7 +743,7 @@ static const VSFrameRef *VS_CC genericGetframe(int n, int activationReason, void
                 int dst_stride = vsapi->getStride(dst, plane);
 
                 vs_generic_params params = make_generic_params(d, fi, plane);
-                func(srcp, src_stride, dstp, dst_stride, &params, width, height);
+                d->funcs[plane](srcp, src_stride, dstp, dst_stride, &params, width, height);
             }
         }
 
@@ -416,6 +754,39 @@ static const VSFrameRef *VS_CC genericGetframe(int n, int activationReason, void
     return nullptr;
 }
 
+template <GenericOperations op>
+static int genericRadius(const GenericData *d) {
+    if (op != GenericConvolution || (d->convolution_type == ConvolutionSquare && d->matrix_elements == 9))
+        return 1;
+    else if (d->convolution_type == ConvolutionSquare)
+        return 2;
+    else
+        return d->matrix_elements / 2;
+}
+
+template <GenericOperations op>
+static StripStage genericStripStage(GenericData *d, const VSFormat *fi) {
+    StripStage stage = {};
+
+    stage.spatialRadius = genericRadius<op>(d);
+    if (op != GenericConvolution || d->convolution_type != ConvolutionHorizontal)
+        stage.radius = stage.spatialRadius;
+
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        stage.process[plane] = d->process[plane];
+        if (!d->process[plane])
+            continue;
+
+        vs_generic_params params = make_generic_params(d, fi, plane);
+        decltype(&vs_generic_3x3_conv_byte_c) planeFunc = d->funcs[plane];
+        stage.func[plane] = [planeFunc, params](const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned width, unsigned height) {
+            planeFunc(src, src_stride, dst, dst_stride, &params, width, height);
+        };
+    }
+
+    return stage;
+}
+
 template <GenericOperations op>
 static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
     std::unique_ptr<GenericData> d(new GenericData{});
@@ -588,13 +959,28 @@ static void VS_CC genericCreate(const VSMap *in, VSMap *out, void *userData, VSC
             throw std::runtime_error("Height must be bigger than convolution radius.");
 
         d->cpulevel = vs_get_cpulevel(core);
+        genericSelectPlanes<op>(d.get(), !!vs_get_autotune(core));
     } catch (const std::runtime_error &error) {
         vsapi->freeNode(d->node);
         vsapi->setError(out, (d->filter_name + ": "_s + error.what()).c_str());
         return;
     }
 
-    vsapi->createFilter(in, out, d->filter_name, templateNodeInit<GenericData>, genericGetframe<op>, templateNodeFree<GenericData>, fmParallel, 0, d.get(), core);
+    const VSFormat *fi = d->vi->format;
+    StripStage stage = {};
+    if (fi) {
+        stage = genericStripStage<op>(d.get(), fi);
+
+        if (fuseStripFilter(d->node, stage, d->filter_name, out, core, vsapi)) {
+            vsapi->freeNode(d->node);
+            return;
+        }
+    }
+
+    vsapi->createFilter(in, out, d->filter_name, templateNodeInit<GenericData>, genericGetframe<op>, stripFilterFree<GenericData>, fmParallel, 0, d.get(), core);
+    setOutputHints(out, fhPure, genericRadius<op>(d.get()), 0, unprocessedPlanes(d.get(), fi), vsapi);
+    if (fi)
+        registerStripFilter(d.get(), out, { stage }, core, vsapi);
     d.release();
 }
 
@@ -618,13 +1004,13 @@ struct InvertOp {
     }
 
     template<typename T>
-    static FORCE_INLINE void processPlane(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const InvertOp &opts) {
+    static FORCE_INLINE void processPlane(const T *src, T *dst, unsigned width, const InvertOp &opts) {
         for (unsigned w = 0; w < width; w++)
             dst[w] = static_cast<T>(opts.max) - std::min(src[w], static_cast<T>(opts.max));
     }
 
     template<typename T>
-    static FORCE_INLINE void processPlaneF(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const InvertOp &opts) {
+    static FORCE_INLINE void processPlaneF(const T *src, T *dst, unsigned width, const InvertOp &opts) {
         if (opts.uv) {
             for (unsigned w = 0; w < width; w++)
                 dst[w] = -src[w];
@@ -646,7 +1032,39 @@ static void VS_CC invertCreate(const VSMap *in, VSMap *out, void *userData, VSCo
         return;
     }
 
-    vsapi->createFilter(in, out, d->name, templateNodeInit<InvertData>, singlePixelGetFrame<InvertData, InvertOp>, templateNodeFree<InvertData>, fmParallel, 0, d.get(), core);
+    const VSFormat *fi = d->vi->format;
+    PointFilterStage stage = {};
+    StripStage strip = {};
+    if (fi) {
+        stage.format = fi;
+        for (int plane = 0; plane < fi->numPlanes; plane++) {
+            InvertOp opts(d.get(), fi, plane);
+            std::string max = std::to_string(opts.max);
+            stage.process[plane] = d->process[plane];
+            if (fi->sampleType == stInteger)
+                stage.expr[plane] = max + " x " + max + " min -";
+            else
+                stage.expr[plane] = opts.uv ? "x -1 *" : "1 x -";
+        }
+
+        if (fusePointFilter(d->node, stage, out, core, vsapi)) {
+            vsapi->freeNode(d->node);
+            return;
+        }
+
+        strip = pointStripStage<InvertOp>(d.get(), fi);
+        if (fuseStripFilter(d->node, strip, d->name, out, core, vsapi)) {
+            vsapi->freeNode(d->node);
+            return;
+        }
+    }
+
+    vsapi->createFilter(in, out, d->name, templateNodeInit<InvertData>, singlePixelGetFrame<InvertData, InvertOp>, pointFilterFree<InvertData>, fmParallel, 0, d.get(), core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, unprocessedPlanes(d.get(), fi), vsapi);
+    if (fi) {
+        registerPointFilter(d.get(), out, stage, core, vsapi);
+        registerStripFilter(d.get(), out, { strip }, core, vsapi);
+    }
     d.release();
 }
 
@@ -673,13 +1091,13 @@ struct LimitOp {
     }
 
     template<typename T>
-    static FORCE_INLINE void processPlane(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const LimitOp &opts) {
+    static FORCE_INLINE void processPlane(const T *src, T *dst, unsigned width, const LimitOp &opts) {
         for (unsigned w = 0; w < width; w++)
             dst[w] = std::min(static_cast<T>(opts.max), std::max(static_cast<T>(opts.min), src[w]));
     }
 
     template<typename T>
-    static FORCE_INLINE void processPlaneF(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const LimitOp &opts) {
+    static FORCE_INLINE void processPlaneF(const T *src, T *dst, unsigned width, const LimitOp &opts) {
         for (unsigned w = 0; w < width; w++)
             dst[w] = std::min(opts.maxf, std::max(opts.minf, src[w]));
     }
@@ -701,7 +1119,32 @@ static void VS_CC limitCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         return;
     }
 
-    vsapi->createFilter(in, out, d->name, templateNodeInit<LimitData>, singlePixelGetFrame<LimitData, LimitOp>, templateNodeFree<LimitData>, fmParallel, 0, d.get(), core);
+    const VSFormat *fi = d->vi->format;
+    PointFilterStage stage = {};
+    stage.format = fi;
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        stage.process[plane] = d->process[plane];
+        if (fi->sampleType == stInteger)
+            stage.expr[plane] = "x " + std::to_string(d->min[plane]) + " max " + std::to_string(d->max[plane]) + " min";
+        else
+            stage.expr[plane] = "x " + exprConstant(d->minf[plane]) + " max " + exprConstant(d->maxf[plane]) + " min";
+    }
+
+    if (fusePointFilter(d->node, stage, out, core, vsapi)) {
+        vsapi->freeNode(d->node);
+        return;
+    }
+
+    StripStage strip = pointStripStage<LimitOp>(d.get(), fi);
+    if (fuseStripFilter(d->node, strip, d->name, out, core, vsapi)) {
+        vsapi->freeNode(d->node);
+        return;
+    }
+
+    vsapi->createFilter(in, out, d->name, templateNodeInit<LimitData>, singlePixelGetFrame<LimitData, LimitOp>, pointFilterFree<LimitData>, fmParallel, 0, d.get(), core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, unprocessedPlanes(d.get(), fi), vsapi);
+    registerPointFilter(d.get(), out, stage, core, vsapi);
+    registerStripFilter(d.get(), out, { strip }, core, vsapi);
     d.release();
 }
 
@@ -730,7 +1173,7 @@ struct BinarizeOp {
     }
 
     template<typename T>
-    static FORCE_INLINE void processPlane(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const BinarizeOp &opts) {
+    static FORCE_INLINE void processPlane(const T *src, T *dst, unsigned width, const BinarizeOp &opts) {
         for (unsigned w = 0; w < width; w++)
             if (src[w] < opts.thr)
                 dst[w] = static_cast<T>(opts.v0);
@@ -739,7 +1182,7 @@ struct BinarizeOp {
     }
 
     template<typename T>
-    static FORCE_INLINE void processPlaneF(const T * VS_RESTRICT src, T * VS_RESTRICT dst, unsigned width, const BinarizeOp &opts) {
+    static FORCE_INLINE void processPlaneF(const T *src, T *dst, unsigned width, const BinarizeOp &opts) {
         for (unsigned w = 0; w < width; w++)
             if (src[w] < opts.thrf)
                 dst[w] = opts.v0f;
@@ -762,7 +1205,32 @@ static void VS_CC binarizeCreate(const VSMap *in, VSMap *out, void *userData, VS
         return;
     }
 
-    vsapi->createFilter(in, out, d->name, templateNodeInit<BinarizeData>, singlePixelGetFrame<BinarizeData, BinarizeOp>, templateNodeFree<BinarizeData>, fmParallel, 0, d.get(), core);
+    const VSFormat *fi = d->vi->format;
+    PointFilterStage stage = {};
+    stage.format = fi;
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        stage.process[plane] = d->process[plane];
+        if (fi->sampleType == stInteger)
+            stage.expr[plane] = "x " + std::to_string(d->thr[plane]) + " < " + std::to_string(d->v0[plane]) + " " + std::to_string(d->v1[plane]) + " ?";
+        else
+            stage.expr[plane] = "x " + exprConstant(d->thrf[plane]) + " < " + exprConstant(d->v0f[plane]) + " " + exprConstant(d->v1f[plane]) + " ?";
+    }
+
+    if (fusePointFilter(d->node, stage, out, core, vsapi)) {
+        vsapi->freeNode(d->node);
+        return;
+    }
+
+    StripStage strip = pointStripStage<BinarizeOp>(d.get(), fi);
+    if (fuseStripFilter(d->node, strip, d->name, out, core, vsapi)) {
+        vsapi->freeNode(d->node);
+        return;
+    }
+
+    vsapi->createFilter(in, out, d->name, templateNodeInit<BinarizeData>, singlePixelGetFrame<BinarizeData, BinarizeOp>, pointFilterFree<BinarizeData>, fmParallel, 0, d.get(), core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, unprocessedPlanes(d.get(), fi), vsapi);
+    registerPointFilter(d.get(), out, stage, core, vsapi);
+    registerStripFilter(d.get(), out, { strip }, core, vsapi);
     d.release();
 }
 
@@ -778,6 +1246,55 @@ struct LevelsData {
     std::vector<uint8_t> lut;
 };
 
+template<typename T>
+static void levelsPlane(const LevelsData &d, const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned w, unsigned h, int bitsPerSample) {
+    T maxval = static_cast<T>((static_cast<int64_t>(1) << bitsPerSample) - 1);
+    const T * VS_RESTRICT lut = reinterpret_cast<const T *>(d.lut.data());
+
+    for (unsigned hl = 0; hl < h; hl++) {
+        const T *srcp = reinterpret_cast<const T *>(src);
+        T *dstp = reinterpret_cast<T *>(dst);
+        for (unsigned x = 0; x < w; x++)
+            dstp[x] = lut[std::min(srcp[x], maxval)];
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+template<typename T>
+static void levelsPlaneF(const LevelsData &d, const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned w, unsigned h) {
+    T gamma = d.gamma;
+    T range_in = 1.f / (d.max_in - d.min_in);
+    T range_out = d.max_out - d.min_out;
+    T min_in = d.min_in;
+    T min_out = d.min_out;
+    T max_in = d.max_in;
+
+    if (std::abs(d.gamma - static_cast<T>(1.0)) < std::numeric_limits<T>::epsilon()) {
+        T range_scale = range_out / (d.max_in - d.min_in);
+        for (unsigned hl = 0; hl < h; hl++) {
+            const T *srcp = reinterpret_cast<const T *>(src);
+            T *dstp = reinterpret_cast<T *>(dst);
+            for (unsigned x = 0; x < w; x++)
+                dstp[x] = (std::max(std::min(srcp[x], max_in) - min_in, 0.f)) * range_scale + min_out;
+
+            src += src_stride;
+            dst += dst_stride;
+        }
+    } else {
+        for (unsigned hl = 0; hl < h; hl++) {
+            const T *srcp = reinterpret_cast<const T *>(src);
+            T *dstp = reinterpret_cast<T *>(dst);
+            for (unsigned x = 0; x < w; x++)
+                dstp[x] = std::pow((std::max(std::min(srcp[x], max_in) - min_in, 0.f)) * range_in, gamma) * range_out + min_out;
+
+            src += src_stride;
+            dst += dst_stride;
+        }
+    }
+}
+
 template<typename T>
 static const VSFrameRef *VS_CC levelsGetframe(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     LevelsData *d = reinterpret_cast<LevelsData *>(*instanceData);
@@ -785,35 +1302,17 @@ static const VSFrameRef *VS_CC levelsGetframe(int n, int activationReason, void
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
-        const VSFormat *fi = vsapi->getFrameFormat(src);
-        const int pl[] = { 0, 1, 2 };
-        const VSFrameRef *fr[] = { d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src };
-        VSFrameRef *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
+        VSFrameRef *dst = vsapi->getFrameFilterForModify(n, d->node, frameCtx);
+        const VSFormat *fi = vsapi->getFrameFormat(dst);
 
         for (int plane = 0; plane < fi->numPlanes; plane++) {
             if (d->process[plane]) {
-                const T * VS_RESTRICT srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
-                int src_stride = vsapi->getStride(src, plane);
-                T * VS_RESTRICT dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
-                int dst_stride = vsapi->getStride(dst, plane);
-                int h = vsapi->getFrameHeight(src, plane);
-                int w = vsapi->getFrameWidth(src, plane);
-
-                T maxval = static_cast<T>((static_cast<int64_t>(1) << fi->bitsPerSample) - 1);
-                const T * VS_RESTRICT lut = reinterpret_cast<const T *>(d->lut.data());
-
-                for (int hl = 0; hl < h; hl++) {
-                    for (int x = 0; x < w; x++)
-                        dstp[x] = lut[std::min(srcp[x], maxval)];
-
-                    dstp += dst_stride / sizeof(T);
-                    srcp += src_stride / sizeof(T);
-                }
+                uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+                int stride = vsapi->getStride(dst, plane);
+                levelsPlane<T>(*d, dstp, stride, dstp, stride, vsapi->getFrameWidth(dst, plane), vsapi->getFrameHeight(dst, plane), fi->bitsPerSample);
             }
         }
 
-        vsapi->freeFrame(src);
         return dst;
     }
 
@@ -827,50 +1326,17 @@ static const VSFrameRef *VS_CC levelsGetframeF(int n, int activationReason, void
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
-        const VSFormat *fi = vsapi->getFrameFormat(src);
-        const int pl[] = { 0, 1, 2 };
-        const VSFrameRef *fr[] = { d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src };
-        VSFrameRef *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
+        VSFrameRef *dst = vsapi->getFrameFilterForModify(n, d->node, frameCtx);
+        const VSFormat *fi = vsapi->getFrameFormat(dst);
 
         for (int plane = 0; plane < fi->numPlanes; plane++) {
             if (d->process[plane]) {
-                const T * VS_RESTRICT srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
-                int src_stride = vsapi->getStride(src, plane);
-                T * VS_RESTRICT dstp = reinterpret_cast<T *>(vsapi->getWritePtr(dst, plane));
-                int dst_stride = vsapi->getStride(dst, plane);
-                int h = vsapi->getFrameHeight(src, plane);
-                int w = vsapi->getFrameWidth(src, plane);
-
-                T gamma = d->gamma;
-                T range_in = 1.f / (d->max_in - d->min_in);
-                T range_out = d->max_out - d->min_out;
-                T min_in = d->min_in;
-                T min_out = d->min_out;
-                T max_in = d->max_in;
-
-                if (std::abs(d->gamma - static_cast<T>(1.0)) < std::numeric_limits<T>::epsilon()) {
-                    T range_scale = range_out / (d->max_in - d->min_in);
-                    for (int hl = 0; hl < h; hl++) {
-                        for (int x = 0; x < w; x++)
-                            dstp[x] = (std::max(std::min(srcp[x], max_in) - min_in, 0.f)) * range_scale + min_out;
-
-                        dstp += dst_stride / sizeof(T);
-                        srcp += src_stride / sizeof(T);
-                    }
-                } else {
-                    for (int hl = 0; hl < h; hl++) {
-                        for (int x = 0; x < w; x++)
-                            dstp[x] = std::pow((std::max(std::min(srcp[x], max_in) - min_in, 0.f)) * range_in, gamma) * range_out + min_out;
-
-                        dstp += dst_stride / sizeof(T);
-                        srcp += src_stride / sizeof(T);
-                    }
-                }
+                uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+                int stride = vsapi->getStride(dst, plane);
+                levelsPlaneF<T>(*d, dstp, stride, dstp, stride, vsapi->getFrameWidth(dst, plane), vsapi->getFrameHeight(dst, plane));
             }
         }
 
-        vsapi->freeFrame(src);
         return dst;
     }
 
@@ -927,12 +1393,56 @@ static void VS_CC levelsCreate(const VSMap *in, VSMap *out, void *userData, VSCo
         }
     }
 
+    // only the integer version is merged since it's a lut, pow() in Expr isn't exact
+    PointFilterStage stage = {};
+    if (d->vi->format->sampleType == stInteger) {
+        stage.format = d->vi->format;
+        for (int plane = 0; plane < d->vi->format->numPlanes; plane++) {
+            stage.process[plane] = d->process[plane];
+            if (!d->process[plane])
+                continue;
+            if (d->vi->format->bytesPerSample == 1)
+                stage.lut[plane].assign(d->lut.begin(), d->lut.end());
+            else
+                stage.lut[plane].assign(reinterpret_cast<const uint16_t *>(d->lut.data()), reinterpret_cast<const uint16_t *>(d->lut.data()) + d->lut.size() / 2);
+        }
+
+        if (fusePointFilter(d->node, stage, out, core, vsapi)) {
+            vsapi->freeNode(d->node);
+            return;
+        }
+    }
+
+    // the strip functions get their own copy of the settings since they can outlive this filter
+    StripStage strip = {};
+    LevelsData params = *d;
+    params.node = nullptr;
+    int bitsPerSample = d->vi->format->bitsPerSample;
+    for (int plane = 0; plane < d->vi->format->numPlanes; plane++) {
+        strip.process[plane] = d->process[plane];
+        if (d->vi->format->bytesPerSample == 1)
+            strip.func[plane] = [params, bitsPerSample](const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned w, unsigned h) { levelsPlane<uint8_t>(params, src, src_stride, dst, dst_stride, w, h, bitsPerSample); };
+        else if (d->vi->format->bytesPerSample == 2)
+            strip.func[plane] = [params, bitsPerSample](const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned w, unsigned h) { levelsPlane<uint16_t>(params, src, src_stride, dst, dst_stride, w, h, bitsPerSample); };
+        else
+            strip.func[plane] = [params](const uint8_t *src, ptrdiff_t src_stride, uint8_t *dst, ptrdiff_t dst_stride, unsigned w, unsigned h) { levelsPlaneF<float>(params, src, src_stride, dst, dst_stride, w, h); };
+    }
+
+    if (fuseStripFilter(d->node, strip, d->name, out, core, vsapi)) {
+        vsapi->freeNode(d->node);
+        return;
+    }
+
     if (d->vi->format->bytesPerSample == 1)
-        vsapi->createFilter(in, out, d->name, templateNodeInit<LevelsData>, levelsGetframe<uint8_t>, templateNodeFree<LevelsData>, fmParallel, 0, d.get(), core);
+        vsapi->createFilter(in, out, d->name, templateNodeInit<LevelsData>, levelsGetframe<uint8_t>, pointFilterFree<LevelsData>, fmParallel, 0, d.get(), core);
     else if (d->vi->format->bytesPerSample == 2)
-        vsapi->createFilter(in, out, d->name, templateNodeInit<LevelsData>, levelsGetframe<uint16_t>, templateNodeFree<LevelsData>, fmParallel, 0, d.get(), core);
+        vsapi->createFilter(in, out, d->name, templateNodeInit<LevelsData>, levelsGetframe<uint16_t>, pointFilterFree<LevelsData>, fmParallel, 0, d.get(), core);
     else
-        vsapi->createFilter(in, out, d->name, templateNodeInit<LevelsData>, levelsGetframeF<float>, templateNodeFree<LevelsData>, fmParallel, 0, d.get(), core);
+        vsapi->createFilter(in, out, d->name, templateNodeInit<LevelsData>, levelsGetframeF<float>, pointFilterFree<LevelsData>, fmParallel, 0, d.get(), core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, unprocessedPlanes(d.get(), d->vi->format), vsapi);
+    if (stage.format)
+        registerPointFilter(d.get(), out, stage, core, vsapi);
+    registerStripFilter(d.get(), out, { strip }, core, vsapi);
     d.release();
 }
 
@@ -0,0 +1,368 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "graphfile.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#include "../common/vsutf16.h"
+#endif
+
+// The file lists the plugin function calls in the order they have to be made followed by the saved clips:
+//   VapourSynthGraph 2
+//   <number of calls>
+//   <plugin id> <function> <number of arguments> followed by <key> <type> <number of values> <values> per argument
+//   <number of clips> <clip>...
+// Strings are written as <length>:<bytes>, floats as the hexadecimal bits of the double so they're read back
+// exactly whatever the locale is and clips as <call> <key> <position> which refers to a clip returned by an
+// earlier call.
+
+static const char graphHeader[] = "VapourSynthGraph 2";
+
+static FILE *openFile(const std::string &path, const char *mode) {
+#ifdef VS_TARGET_OS_WINDOWS
+    return _wfopen(utf16_from_utf8(path).c_str(), utf16_from_utf8(mode).c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static std::string describeCall(const VSInvocation &invocation) {
+    return invocation.pluginNamespace + "." + invocation.funcName;
+}
+
+static PInvocation getClipInvocation(const VSNodeRef &ref, std::string &key, int &position) {
+    PInvocation invocation;
+    if (!ref.clip->getInvocation(ref.index, invocation, key, position))
+        return nullptr;
+    return invocation;
+}
+
+// the calls that returned the clips passed as arguments, throws if an argument can't be saved
+static std::vector<PInvocation> getInputCalls(const VSInvocation &invocation) {
+    std::vector<PInvocation> inputs;
+    for (const auto &iter : invocation.args.getStorage()) {
+        const std::string &key = iter.first.name();
+        switch (iter.second.getType()) {
+        case VSVariant::vNode:
+            for (size_t i = 0; i < iter.second.size(); i++) {
+                std::string outputKey;
+                int position;
+                PInvocation input = getClipInvocation(iter.second.getValue<VSNodeRef>(i), outputKey, position);
+                if (!input)
+                    throw VSException("Argument '" + key + "' of " + describeCall(invocation) + " is a clip that wasn't returned by a plugin function while graph recording was enabled and can't be saved");
+                inputs.push_back(input);
+            }
+            break;
+        case VSVariant::vFrame:
+            throw VSException("Argument '" + key + "' of " + describeCall(invocation) + " is a frame, frames can't be saved");
+        case VSVariant::vMethod:
+            throw VSException("Argument '" + key + "' of " + describeCall(invocation) + " is a function, functions such as Python callables can't be saved");
+        default:
+            break;
+        }
+    }
+    return inputs;
+}
+
+// depth first so every call comes after the calls that returned its inputs
+static void addCalls(const PInvocation &root, std::map<VSInvocation *, size_t> &callIndex, std::vector<PInvocation> &calls) {
+    struct PendingCall {
+        PInvocation invocation;
+        std::vector<PInvocation> inputs;
+        size_t next;
+    };
+
+    if (callIndex.count(root.get()))
+        return;
+
+    // the calls on the stack, an input that's already on it would never be finished
+    std::set<VSInvocation *> pending;
+    std::vector<PendingCall> stack;
+    stack.push_back({ root, getInputCalls(*root), 0 });
+    pending.insert(root.get());
+    while (!stack.empty()) {
+        PendingCall &top = stack.back();
+        if (top.next < top.inputs.size()) {
+            PInvocation input = top.inputs[top.next++];
+            if (pending.count(input.get()))
+                throw VSException(describeCall(*input) + " has its own result as an input and can't be saved");
+            if (!callIndex.count(input.get())) {
+                stack.push_back({ input, getInputCalls(*input), 0 });
+                pending.insert(input.get());
+            }
+        } else {
+            callIndex[top.invocation.get()] = calls.size();
+            calls.push_back(top.invocation);
+            pending.erase(top.invocation.get());
+            stack.pop_back();
+        }
+    }
+}
+
+static void writeString(std::string &buf, const std::string &s) {
+    buf += std::to_string(s.size());
+    buf += ':';
+    buf += s;
+    buf += ' ';
+}
+
+static void writeClip(std::string &buf, const VSNodeRef &ref, const std::map<VSInvocation *, size_t> &callIndex) {
+    std::string key;
+    int position;
+    PInvocation invocation = getClipInvocation(ref, key, position);
+    buf += std::to_string(callIndex.at(invocation.get()));
+    buf += ' ';
+    writeString(buf, key);
+    buf += std::to_string(position);
+    buf += ' ';
+}
+
+void saveGraph(const VSMap &nodes, const std::string &filename, VSMap &out) {
+    try {
+        const VSVariant *clips = nodes.find("clip");
+        if (!clips || clips->getType() != VSVariant::vNode)
+            throw VSException("No clips to save");
+
+        std::map<VSInvocation *, size_t> callIndex;
+        std::vector<PInvocation> calls;
+        for (size_t i = 0; i < clips->size(); i++) {
+            std::string key;
+            int position;
+            PInvocation invocation = getClipInvocation(clips->getValue<VSNodeRef>(i), key, position);
+            if (!invocation)
+                throw VSException("Clip " + std::to_string(i) + " wasn't returned by a plugin function while graph recording was enabled and can't be saved");
+            addCalls(invocation, callIndex, calls);
+        }
+
+        std::string buf = graphHeader;
+        buf += "\n" + std::to_string(calls.size()) + "\n";
+        for (const auto &call : calls) {
+            writeString(buf, call->pluginId);
+            writeString(buf, call->funcName);
+            buf += std::to_string(call->args.size());
+            buf += ' ';
+            for (const auto &iter : call->args.getStorage()) {
+                const VSVariant &v = iter.second;
+                writeString(buf, iter.first.name());
+                const char type[] = { 'u', 'i', 'f', 's', 'c' };
+                buf += type[v.getType()];
+                buf += ' ';
+                buf += std::to_string(v.size());
+                buf += ' ';
+                for (size_t i = 0; i < v.size(); i++) {
+                    if (v.getType() == VSVariant::vInt) {
+                        buf += std::to_string(v.getValue<int64_t>(i));
+                        buf += ' ';
+                    } else if (v.getType() == VSVariant::vFloat) {
+                        double value = v.getValue<double>(i);
+                        uint64_t bits;
+                        memcpy(&bits, &value, sizeof(bits));
+                        char tmp[32];
+                        snprintf(tmp, sizeof(tmp), "%016" PRIx64 " ", bits);
+                        buf += tmp;
+                    } else if (v.getType() == VSVariant::vData) {
+                        writeString(buf, *v.getValue<VSMapData>(i));
+                    } else {
+                        writeClip(buf, v.getValue<VSNodeRef>(i), callIndex);
+                    }
+                }
+            }
+            buf += '\n';
+        }
+
+        buf += std::to_string(clips->size());
+        buf += ' ';
+        for (size_t i = 0; i < clips->size(); i++)
+            writeClip(buf, clips->getValue<VSNodeRef>(i), callIndex);
+        buf += '\n';
+
+        FILE *f = openFile(filename, "wb");
+        if (!f)
+            throw VSException("Couldn't open " + filename + " for writing");
+        bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+        ok = !fclose(f) && ok;
+        if (!ok)
+            throw VSException("Couldn't write " + filename);
+    } catch (VSException &e) {
+        out.setError(e.what());
+    }
+}
+
+class GraphReader {
+private:
+    const std::string &data;
+    size_t pos;
+
+    void skipSpace() {
+        while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\n' || data[pos] == '\r'))
+            pos++;
+    }
+
+    [[noreturn]] void invalid() {
+        throw VSException("Invalid graph file, error at offset " + std::to_string(pos));
+    }
+public:
+    explicit GraphReader(const std::string &data) : data(data), pos(0) {}
+
+    std::string line() {
+        size_t end = data.find('\n', pos);
+        if (end == std::string::npos)
+            invalid();
+        std::string s = data.substr(pos, end - pos);
+        pos = end + 1;
+        return s;
+    }
+
+    std::string token() {
+        skipSpace();
+        size_t start = pos;
+        while (pos < data.size() && data[pos] != ' ' && data[pos] != '\n' && data[pos] != '\r')
+            pos++;
+        if (start == pos)
+            invalid();
+        return data.substr(start, pos - start);
+    }
+
+    int64_t integer() {
+        std::string s = token();
+        char *end;
+        int64_t v = strtoll(s.c_str(), &end, 10);
+        if (*end)
+            invalid();
+        return v;
+    }
+
+    size_t count() {
+        int64_t v = integer();
+        if (v < 0 || static_cast<uint64_t>(v) > data.size())
+            invalid();
+        return static_cast<size_t>(v);
+    }
+
+    double real() {
+        std::string s = token();
+        char *end;
+        uint64_t bits = strtoull(s.c_str(), &end, 16);
+        if (*end || s.size() != 16)
+            invalid();
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    std::string string() {
+        skipSpace();
+        size_t colon = data.find(':', pos);
+        if (colon == std::string::npos)
+            invalid();
+        char *end;
+        unsigned long long length = strtoull(data.c_str() + pos, &end, 10);
+        if (end != data.c_str() + colon || length > data.size() - colon - 1)
+            invalid();
+        pos = colon + 1 + static_cast<size_t>(length);
+        return data.substr(colon + 1, static_cast<size_t>(length));
+    }
+
+    const VSNodeRef &clip(const std::vector<VSMap> &results) {
+        size_t call = count();
+        std::string key = string();
+        int64_t position = integer();
+        const VSVariant *v = call < results.size() ? results[call].find(key.c_str()) : nullptr;
+        if (!v || v->getType() != VSVariant::vNode || position < 0 || static_cast<size_t>(position) >= v->size())
+            invalid();
+        return v->getValue<VSNodeRef>(static_cast<size_t>(position));
+    }
+};
+
+void loadGraph(const std::string &filename, VSCore *core, VSMap &out) {
+    try {
+        FILE *f = openFile(filename, "rb");
+        if (!f)
+            throw VSException("Couldn't open " + filename + " for reading");
+        std::string data;
+        char buffer[65536];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            data.append(buffer, read);
+        fclose(f);
+
+        GraphReader reader(data);
+        if (reader.line() != graphHeader)
+            throw VSException(filename + " isn't a graph file");
+
+        std::vector<VSMap> results;
+        size_t numCalls = reader.count();
+        for (size_t i = 0; i < numCalls; i++) {
+            std::string pluginId = reader.string();
+            std::string funcName = reader.string();
+            VSMap args;
+            size_t numArgs = reader.count();
+            for (size_t j = 0; j < numArgs; j++) {
+                std::string key = reader.string();
+                std::string type = reader.token();
+                size_t numValues = reader.count();
+                VSVariant v;
+                if (type == "i") {
+                    v = VSVariant(VSVariant::vInt);
+                    for (size_t k = 0; k < numValues; k++)
+                        v.append(reader.integer());
+                } else if (type == "f") {
+                    v = VSVariant(VSVariant::vFloat);
+                    for (size_t k = 0; k < numValues; k++)
+                        v.append(reader.real());
+                } else if (type == "s") {
+                    v = VSVariant(VSVariant::vData);
+                    for (size_t k = 0; k < numValues; k++)
+                        v.append(reader.string());
+                } else if (type == "c") {
+                    v = VSVariant(VSVariant::vNode);
+                    for (size_t k = 0; k < numValues; k++)
+                        v.append(reader.clip(results));
+                } else {
+                    throw VSException("Invalid graph file, unknown argument type " + type);
+                }
+                args.insert(key.c_str(), std::move(v));
+            }
+
+            VSPlugin *plugin = core->getPluginById(pluginId);
+            if (!plugin)
+                throw VSException("Plugin " + pluginId + " needed by " + funcName + " isn't loaded");
+            VSMap ret = plugin->invoke(funcName, args);
+            if (ret.hasError())
+                throw VSException("Recreating " + plugin->fnamespace + "." + funcName + " failed: " + ret.getErrorMessage());
+            results.push_back(ret);
+        }
+
+        VSVariant clips(VSVariant::vNode);
+        size_t numClips = reader.count();
+        for (size_t i = 0; i < numClips; i++)
+            clips.append(reader.clip(results));
+        out.insert("clip", std::move(clips));
+    } catch (VSException &e) {
+        out.setError(e.what());
+    }
+}
@@ -0,0 +1,32 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef GRAPHFILE_H
+#define GRAPHFILE_H
+
+#include "vscore.h"
+#include <string>
+
+// Writes the plugin function calls that created the clips stored under "clip" in nodes, errors are set in out
+void saveGraph(const VSMap &nodes, const std::string &filename, VSMap &out);
+// Makes the same calls again in core and stores the recreated clips under "clip" in out
+void loadGraph(const std::string &filename, VSCore *core, VSMap &out);
+
+#endif // GRAPHFILE_H
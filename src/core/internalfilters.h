@@ -29,6 +29,8 @@ extern "C" {
 void VS_CC stdlibInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
 void VS_CC mergeInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
 void VS_CC reorderInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
+// Returns the instance data of the filter behind node if it was created with getFrame, otherwise NULL
+void *getFilterInstanceData(VSNodeRef *node, VSFilterGetFrame getFrame);
 #ifdef __cplusplus
 }
 #endif
@@ -39,4 +41,27 @@ void VS_CC lutInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerF
 void VS_CC boxBlurInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
 void VS_CC resizeInitialize(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin);
 
+#ifdef __cplusplus
+#include <string>
+#include <vector>
+
+// What a pointwise filter does to each plane, either an expression in Expr
+// syntax that reads x or a table indexed by the integer input value. Chains
+// of such filters are merged into a single Expr, see exprfilter.cpp.
+struct PointFilterStage {
+    const VSFormat *format; // output format
+    bool process[3];
+    std::string expr[3];
+    std::vector<float> lut[3];
+};
+
+// Called before a pointwise filter creates its node. When node comes from
+// another pointwise filter both are merged into one Expr reading that
+// filter's input and stored in out, the caller then only has to clean up.
+bool fusePointFilter(VSNodeRef *node, const PointFilterStage &stage, VSMap *out, VSCore *core, const VSAPI *vsapi);
+// Remembers what the node just stored in out does so later filters can be merged with it
+void registerPointFilter(void *instanceData, const VSMap *out, const PointFilterStage &stage, VSCore *core, const VSAPI *vsapi);
+void unregisterPointFilter(void *instanceData);
+#endif
+
 #endif // INTERNALFILTERS_H
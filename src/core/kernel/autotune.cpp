@@ -0,0 +1,276 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <VSHelper.h>
+#include "autotune.h"
+#include "cpulevel.h"
+#include "../cpufeatures.h"
+#include "../vscore.h"
+
+#ifdef VS_TARGET_OS_WINDOWS
+#include "../../common/vsutf16.h"
+#else
+#include <unistd.h>
+#endif
+
+// The profile file holds one result per line after the header:
+//   <kernel> <byte|word|float> <width bucket> <cpu level name>
+
+static const char profileHeader[] = "VapourSynthAutotune 1";
+static const char *pixelNames[] = { "byte", "word", "float" };
+
+// only a few rows are timed, that's enough to get the per row cost of the widest frames
+static const unsigned maxBenchmarkRows = 64;
+static const int benchmarkRuns = 5;
+
+namespace {
+
+struct AutotuneKey {
+    std::string kernel;
+    int pixel;
+    unsigned bucket;
+
+    bool operator<(const AutotuneKey &other) const {
+        return std::tie(kernel, pixel, bucket) < std::tie(other.kernel, other.pixel, other.bucket);
+    }
+};
+
+} // namespace
+
+// the results only depend on the cpu so they're shared by all cores in the process
+static std::mutex tableLock;
+static std::map<AutotuneKey, int> table;
+static std::string profilePath;
+// held while timing so two threads don't slow each other's measurements down
+static std::mutex benchmarkLock;
+
+static FILE *openFile(const std::string &path, const char *mode) {
+#ifdef VS_TARGET_OS_WINDOWS
+    return _wfopen(utf16_from_utf8(path).c_str(), utf16_from_utf8(mode).c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static unsigned widthBucket(unsigned width) {
+    unsigned bucket = 1;
+    while (bucket <= width / 2)
+        bucket *= 2;
+    return bucket;
+}
+
+static vs_autotune_func pickLevel(const vs_autotune_func *funcs, const int *levels, int count, int level) {
+    // a profile made with more instruction sets than are allowed now falls back to the highest allowed one
+    for (int i = 0; i < count; i++) {
+        if (levels[i] <= level)
+            return funcs[i];
+    }
+    return funcs[count - 1];
+}
+
+static void fillBuffer(uint8_t *buffer, int pixel, size_t size) {
+    uint32_t seed = 0x12345678;
+    for (size_t i = 0; i < size / 4; i++) {
+        seed = seed * 1664525 + 1013904223;
+        uint32_t v = seed >> 8;
+        if (pixel == VS_AUTOTUNE_WORD) {
+            // 10 bit values are valid for every word format
+            v &= 0x3FF03FF;
+        } else if (pixel == VS_AUTOTUNE_FLOAT) {
+            float f = (v & 0xFFFF) / 65535.f;
+            memcpy(&v, &f, sizeof(v));
+        }
+        memcpy(buffer + i * 4, &v, sizeof(v));
+    }
+}
+
+static void saveProfile() {
+    std::string path;
+    std::map<AutotuneKey, int> results;
+    {
+        std::lock_guard<std::mutex> lock(tableLock);
+        path = profilePath;
+        results = table;
+    }
+    if (path.empty())
+        return;
+
+    std::string buf = profileHeader;
+    buf += '\n';
+    for (const auto &iter : results)
+        buf += iter.first.kernel + " " + pixelNames[iter.first.pixel] + " " + std::to_string(iter.first.bucket) + " " + vs_cpulevel_to_str(iter.second) + "\n";
+
+    // written to a temporary file first so a failed write never leaves a truncated profile behind
+    static std::atomic<unsigned> tempCounter(0);
+#ifdef VS_TARGET_OS_WINDOWS
+    std::string tempPath = path + "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(tempCounter++);
+#else
+    std::string tempPath = path + "." + std::to_string(getpid()) + "." + std::to_string(tempCounter++);
+#endif
+
+    FILE *f = openFile(tempPath, "wb");
+    bool ok = !!f;
+    if (f) {
+        ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+        ok = !fclose(f) && ok;
+    }
+
+#ifdef VS_TARGET_OS_WINDOWS
+    if (!ok || !MoveFileEx(utf16_from_utf8(tempPath).c_str(), utf16_from_utf8(path).c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFile(utf16_from_utf8(tempPath).c_str());
+#else
+    if (!ok || rename(tempPath.c_str(), path.c_str())) {
+        remove(tempPath.c_str());
+#endif
+        vsWarning("Couldn't write the autotune profile %s", path.c_str());
+    }
+}
+
+int vs_get_autotune(const struct VSCore *core) {
+    return core->getAutotune();
+}
+
+int vs_set_autotune(struct VSCore *core, int enable) {
+    return core->setAutotune(enable);
+}
+
+int vs_autotune_set_profile(const char *path) {
+    // a file that isn't a profile is left alone and never becomes the file the results are saved to
+    std::map<AutotuneKey, int> results;
+    FILE *f = *path ? openFile(path, "rb") : nullptr;
+    if (f) {
+        char line[256];
+        bool ok = fgets(line, sizeof(line), f) && !strncmp(line, profileHeader, sizeof(profileHeader) - 1);
+        while (ok && fgets(line, sizeof(line), f)) {
+            char kernel[128];
+            char pixel[16];
+            char isa[16];
+            unsigned bucket;
+            if (sscanf(line, "%127s %15s %u %15s", kernel, pixel, &bucket, isa) != 4)
+                continue;
+            for (int i = 0; i < 3; i++) {
+                if (!strcmp(pixel, pixelNames[i]))
+                    results[{ kernel, i, bucket }] = vs_cpulevel_from_str(isa);
+            }
+        }
+        fclose(f);
+        if (!ok)
+            return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(tableLock);
+    profilePath = path;
+    for (const auto &iter : results)
+        table[iter.first] = iter.second;
+    return 1;
+}
+
+vs_autotune_func vs_autotune_select(const char *kernel, int pixel, unsigned width, unsigned height, int num_buffers,
+    const vs_autotune_func *funcs, const int *levels, int count, vs_autotune_run run, void *opaque) {
+    if (count <= 1)
+        return count ? funcs[0] : nullptr;
+
+    AutotuneKey key = { kernel, pixel, widthBucket(width) };
+    {
+        std::lock_guard<std::mutex> lock(tableLock);
+        auto iter = table.find(key);
+        if (iter != table.end())
+            return pickLevel(funcs, levels, count, iter->second);
+    }
+
+    std::lock_guard<std::mutex> benchmark(benchmarkLock);
+    {
+        std::lock_guard<std::mutex> lock(tableLock);
+        auto iter = table.find(key);
+        if (iter != table.end())
+            return pickLevel(funcs, levels, count, iter->second);
+    }
+
+    unsigned rows = std::min(height, maxBenchmarkRows);
+    ptrdiff_t stride = (static_cast<ptrdiff_t>(width) * (pixel == VS_AUTOTUNE_BYTE ? 1 : (pixel == VS_AUTOTUNE_WORD ? 2 : 4)) + 63) & ~static_cast<ptrdiff_t>(63);
+    size_t size = static_cast<size_t>(stride) * rows;
+    void *buffers[VS_AUTOTUNE_MAX_BUFFERS] = {};
+    num_buffers = std::min(num_buffers, VS_AUTOTUNE_MAX_BUFFERS);
+    for (int i = 0; i < num_buffers; i++) {
+        buffers[i] = vs_aligned_malloc<uint8_t>(size, 64);
+        fillBuffer(static_cast<uint8_t *>(buffers[i]), pixel, size);
+    }
+
+    int best = 0;
+    int64_t bestTime = INT64_MAX;
+    for (int i = 0; i < count; i++) {
+        // the first run only warms up the caches
+        run(funcs[i], buffers, stride, width, rows, opaque);
+        int64_t fastest = INT64_MAX;
+        for (int j = 0; j < benchmarkRuns; j++) {
+            auto start = std::chrono::steady_clock::now();
+            run(funcs[i], buffers, stride, width, rows, opaque);
+            auto end = std::chrono::steady_clock::now();
+            fastest = std::min<int64_t>(fastest, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+        // ties go to the lower cpu level since it doesn't slow down the neighbouring cores
+        if (fastest <= bestTime) {
+            best = i;
+            bestTime = fastest;
+        }
+    }
+
+    for (int i = 0; i < num_buffers; i++)
+        vs_aligned_free(buffers[i]);
+
+    {
+        std::lock_guard<std::mutex> lock(tableLock);
+        table[key] = levels[best];
+    }
+    saveProfile();
+    return funcs[best];
+}
+
+vs_autotune_func vs_autotune_dispatch(const char *kernel, const vs_autotune_func kernels[][3], int pixel, int cpulevel, int autotune,
+    unsigned width, unsigned height, int num_buffers, vs_autotune_run run, void *opaque) {
+    vs_autotune_func funcs[VS_AUTOTUNE_NUM_LEVELS];
+    int levels[VS_AUTOTUNE_NUM_LEVELS];
+    int count = 0;
+
+    for (int level = VS_AUTOTUNE_NUM_LEVELS - 1; level >= 0; level--) {
+#ifdef VS_TARGET_CPU_X86
+        if (level == VS_CPU_LEVEL_AVX2 && !getCPUFeatures()->avx2)
+            continue;
+#endif
+        if (level <= cpulevel) {
+            funcs[count] = kernels[level][pixel];
+            levels[count++] = level;
+        }
+    }
+
+    if (!autotune || count == 1)
+        return funcs[0];
+    return vs_autotune_select(kernel, pixel, width, height, num_buffers, funcs, levels, count, run, opaque);
+}
@@ -0,0 +1,76 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    VS_AUTOTUNE_BYTE = 0,
+    VS_AUTOTUNE_WORD = 1,
+    VS_AUTOTUNE_FLOAT = 2
+};
+
+#define VS_AUTOTUNE_MAX_BUFFERS 4
+
+#ifdef VS_TARGET_CPU_X86
+#define VS_AUTOTUNE_NUM_LEVELS 3
+#else
+#define VS_AUTOTUNE_NUM_LEVELS 1
+#endif
+
+static inline int vs_autotune_pixel(int bytes_per_sample) {
+    return bytes_per_sample == 1 ? VS_AUTOTUNE_BYTE : (bytes_per_sample == 2 ? VS_AUTOTUNE_WORD : VS_AUTOTUNE_FLOAT);
+}
+
+struct VSCore;
+
+typedef void (*vs_autotune_func)(void);
+// Runs func once on the scratch buffers, all of them hold height rows of width pixels filled with valid sample values
+typedef void (*vs_autotune_run)(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque);
+
+int vs_get_autotune(const struct VSCore *core);
+int vs_set_autotune(struct VSCore *core, int enable);
+
+// Loads earlier results from the file and saves new ones to it, an empty path stops saving. Returns 0 and keeps the
+// previous file if the file exists but isn't a profile.
+int vs_autotune_set_profile(const char *path);
+
+// Picks one of count kernels, sorted from the highest cpu level to the lowest, for planes of the given dimensions.
+// The first time a kernel, pixel type and width bucket is seen all candidates are timed on scratch buffers and
+// the fastest one is remembered. Later calls and other cores only look the result up.
+vs_autotune_func vs_autotune_select(const char *kernel, int pixel, unsigned width, unsigned height, int num_buffers,
+    const vs_autotune_func *funcs, const int *levels, int count, vs_autotune_run run, void *opaque);
+
+// Returns kernels[level][pixel] for the highest allowed cpu level, or with autotune set the allowed one that's fastest
+// for planes of this size. The table has a row of byte, word and float kernels for every cpu level starting with C.
+vs_autotune_func vs_autotune_dispatch(const char *kernel, const vs_autotune_func kernels[][3], int pixel, int cpulevel, int autotune,
+    unsigned width, unsigned height, int num_buffers, vs_autotune_run run, void *opaque);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
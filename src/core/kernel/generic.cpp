@@ -22,6 +22,7 @@
 #include <array>
 #include <cmath>
 #include <cstdint>
+#include <limits>
 #include <type_traits>
 #include "generic.h"
 
@@ -309,7 +310,7 @@ void conv_plane_5x5(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t
         T *dst_p = static_cast<T *>(line_ptr(dst, i, dst_stride));
 
         for (unsigned j = 0; j < std::min(width, 2U); ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
             unsigned idx[5];
 
             idx[0] = j < 2 ? std::min(2 - j, width - 1) : j - 2;
@@ -350,7 +351,7 @@ void conv_plane_5x5(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t
         }
 
         for (unsigned j = std::max(2U, width - std::min(width, 2U)); j < width; ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
             unsigned idx[5];
 
             idx[0] = j < 2 ? std::min(2 - j, width - 1) : j - 2;
@@ -396,7 +397,7 @@ void conv_plane_h(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t ds
         T *dstp = static_cast<T *>(line_ptr(dst, i, dst_stride));
 
         for (unsigned j = 0; j < std::min(width, support); ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
 
             Accum accum = 0;
 
@@ -428,7 +429,7 @@ void conv_plane_h(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t ds
         }
 
         for (unsigned j = std::max(support, width - std::min(width, support)); j < width; ++j) {
-            unsigned dist_from_right = width - 1 - i;
+            unsigned dist_from_right = width - 1 - j;
 
             Accum accum = 0;
 
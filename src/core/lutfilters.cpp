@@ -61,21 +61,31 @@ static const VSFrameRef *VS_CC lutGetframe(int n, int activationReason, void **i
     if (activationReason == arInitial) {
         vsapi->requestFrameFilter(n, d->node, frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         const VSFormat *fi = d->vi_out.format;
-        const int pl[] = {0, 1, 2};
-        const VSFrameRef *fr[] = {d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src};
-        VSFrameRef *dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
+        const VSFrameRef *src;
+        VSFrameRef *dst;
 
-        T maxval = static_cast<T>((static_cast<int64_t>(1) << fi->bitsPerSample) - 1);
+        if (fi == d->vi->format) {
+            // the lookup can be done in place when the format doesn't change
+            dst = vsapi->getFrameFilterForModify(n, d->node, frameCtx);
+            src = dst;
+        } else {
+            src = vsapi->getFrameFilter(n, d->node, frameCtx);
+            const int pl[] = {0, 1, 2};
+            const VSFrameRef *fr[] = {d->process[0] ? 0 : src, d->process[1] ? 0 : src, d->process[2] ? 0 : src};
+            dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src, 0), vsapi->getFrameHeight(src, 0), fr, pl, src, core);
+        }
+
+        T maxval = static_cast<T>((static_cast<int64_t>(1) << d->vi->format->bitsPerSample) - 1);
 
         for (int plane = 0; plane < fi->numPlanes; plane++) {
 
             if (d->process[plane]) {
-                const T * VS_RESTRICT srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
-                int src_stride = vsapi->getStride(src, plane);
-                U * VS_RESTRICT dstp = reinterpret_cast<U *>(vsapi->getWritePtr(dst, plane));
+                // get the write pointer first since it may copy the plane when working in place
+                U *dstp = reinterpret_cast<U *>(vsapi->getWritePtr(dst, plane));
                 int dst_stride = vsapi->getStride(dst, plane);
+                const T *srcp = reinterpret_cast<const T *>(vsapi->getReadPtr(src, plane));
+                int src_stride = vsapi->getStride(src, plane);
                 int h = vsapi->getFrameHeight(src, plane);
                 int w = vsapi->getFrameWidth(src, plane);
 
@@ -91,7 +101,8 @@ static const VSFrameRef *VS_CC lutGetframe(int n, int activationReason, void **i
             }
         }
 
-        vsapi->freeFrame(src);
+        if (src != dst)
+            vsapi->freeFrame(src);
         return dst;
     }
 
@@ -100,6 +111,7 @@ static const VSFrameRef *VS_CC lutGetframe(int n, int activationReason, void **i
 
 static void VS_CC lutFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
     LutData *d = reinterpret_cast<LutData *>(instanceData);
+    unregisterPointFilter(d);
     d->freeNode = vsapi->freeNode;
     delete d;
 }
@@ -188,7 +200,28 @@ static void lutCreateHelper(const VSMap *in, VSMap *out, VSFuncRef *func, std::u
         }
     }
 
-    vsapi->createFilter(in, out, "Lut", lutInit, lutGetframe<T, U>, lutFree, fmParallel, 0, d.release(), core);
+    // unprocessed planes can't be copied to another format in a merged Expr
+    bool pointwise = true;
+    for (int plane = 0; plane < d->vi->format->numPlanes; plane++)
+        pointwise = pointwise && (d->process[plane] || d->vi_out.format == d->vi->format);
+    PointFilterStage stage = {};
+    if (pointwise) {
+        const U *lut = reinterpret_cast<const U *>(d->lut);
+        stage.format = d->vi_out.format;
+        for (int plane = 0; plane < d->vi->format->numPlanes; plane++) {
+            stage.process[plane] = d->process[plane];
+            if (d->process[plane])
+                stage.lut[plane].assign(lut, lut + inrange);
+        }
+
+        if (fusePointFilter(d->node, stage, out, core, vsapi))
+            return;
+    }
+
+    LutData *data = d.release();
+    vsapi->createFilter(in, out, "Lut", lutInit, lutGetframe<T, U>, lutFree, fmParallel, 0, data, core);
+    if (pointwise)
+        registerPointFilter(data, out, stage, core, vsapi);
 }
 
 static void VS_CC lutCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
@@ -22,10 +22,83 @@
 #include "cpufeatures.h"
 #include "filtershared.h"
 #include "internalfilters.h"
+#include "kernel/autotune.h"
 #include "kernel/cpulevel.h"
 #include "kernel/merge.h"
 #include "VSHelper.h"
 
+// the planes that are set to value in process
+static int planeMask(const int process[3], int value, const VSFormat *fi) {
+    int mask = 0;
+    for (int i = 0; i < fi->numPlanes; i++)
+        if (process[i] == value)
+            mask |= 1 << i;
+    return mask;
+}
+
+//////////////////////////////////////////
+// Kernel selection
+
+#define PIXEL_KERNELS(name, isa) { (vs_autotune_func)name##_byte_##isa, (vs_autotune_func)name##_word_##isa, (vs_autotune_func)name##_float_##isa }
+#ifdef VS_TARGET_CPU_X86
+#define KERNEL_TABLE(name) { PIXEL_KERNELS(name, c), PIXEL_KERNELS(name, sse2), PIXEL_KERNELS(name, avx2) }
+#else
+#define KERNEL_TABLE(name) { PIXEL_KERNELS(name, c) }
+#endif
+
+// indexed by cpu level and then byte, word or float
+static const vs_autotune_func mergeKernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_merge);
+static const vs_autotune_func maskMergeKernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_mask_merge);
+static const vs_autotune_func maskMergePremulKernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_mask_merge_premul);
+static const vs_autotune_func makeDiffKernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_makediff);
+static const vs_autotune_func mergeDiffKernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_mergediff);
+
+#undef KERNEL_TABLE
+#undef PIXEL_KERNELS
+
+typedef void (*merge_func)(const void *, const void *, void *, union vs_merge_weight, unsigned);
+typedef void (*mask_merge_func)(const void *, const void *, const void *, void *, unsigned, unsigned, unsigned);
+typedef void (*diff_func)(const void *, const void *, void *, unsigned, unsigned);
+
+typedef struct {
+    unsigned depth;
+    unsigned offset;
+} MaskMergeParams;
+
+static void mergeAutotuneRun(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque) {
+    for (unsigned y = 0; y < height; y++)
+        ((merge_func)func)((uint8_t *)buffers[0] + y * stride, (uint8_t *)buffers[1] + y * stride, (uint8_t *)buffers[2] + y * stride, *(const union vs_merge_weight *)opaque, width);
+}
+
+static void maskMergeAutotuneRun(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque) {
+    const MaskMergeParams *params = (const MaskMergeParams *)opaque;
+    for (unsigned y = 0; y < height; y++)
+        ((mask_merge_func)func)((uint8_t *)buffers[0] + y * stride, (uint8_t *)buffers[1] + y * stride, (uint8_t *)buffers[2] + y * stride, (uint8_t *)buffers[3] + y * stride, params->depth, params->offset, width);
+}
+
+static void diffAutotuneRun(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque) {
+    for (unsigned y = 0; y < height; y++)
+        ((diff_func)func)((uint8_t *)buffers[0] + y * stride, (uint8_t *)buffers[1] + y * stride, (uint8_t *)buffers[2] + y * stride, *(const unsigned *)opaque, width);
+}
+
+// the kernel for the pixel type of the format or NULL if it has none, the filters pick them once per plane when
+// they're created since autotuning has to look up or benchmark every kernel
+static vs_autotune_func selectKernel(const char *name, const vs_autotune_func kernels[][3], const VSFormat *fi, int cpulevel, int autotune,
+                                     int width, int height, int numBuffers, vs_autotune_run run, void *opaque) {
+    int pixel;
+
+    if (fi->sampleType == stInteger && fi->bytesPerSample == 1)
+        pixel = VS_AUTOTUNE_BYTE;
+    else if (fi->sampleType == stInteger && fi->bytesPerSample == 2)
+        pixel = VS_AUTOTUNE_WORD;
+    else if (fi->sampleType == stFloat && fi->bytesPerSample == 4)
+        pixel = VS_AUTOTUNE_FLOAT;
+    else
+        return NULL;
+
+    return vs_autotune_dispatch(name, kernels, pixel, cpulevel, autotune, width, height, numBuffers, run, opaque);
+}
+
 //////////////////////////////////////////
 // PreMultiply
 
@@ -213,6 +286,7 @@ static void VS_CC preMultiplyCreate(const VSMap *in, VSMap *out, void *userData,
     *data = d;
 
     vsapi->createFilter(in, out, "PreMultiply", preMultiplyInit, preMultiplyGetFrame, preMultiplyFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -225,7 +299,7 @@ typedef struct {
     unsigned weight[3];
     float fweight[3];
     int process[3];
-    int cpulevel;
+    merge_func funcs[3];
 } MergeData;
 
 const unsigned MergeShift = 15;
@@ -257,46 +331,15 @@ static const VSFrameRef *VS_CC mergeGetFrame(int n, int activationReason, void *
                 const uint8_t *srcp2 = vsapi->getReadPtr(src2, plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, void *, union vs_merge_weight, unsigned) = 0;
                 union vs_merge_weight weight;
 
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_merge_byte_avx2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_merge_word_avx2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_merge_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_merge_byte_sse2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_merge_word_sse2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_merge_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_merge_byte_c;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_merge_word_c;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_merge_float_c;
-                }
-
-                if (!func)
-                    continue;
-
                 if (d->vi->format->sampleType == stInteger)
                     weight.u = d->weight[plane];
                 else
                     weight.f = d->fweight[plane];
 
                 for (int y = 0; y < h; ++y) {
-                    func(srcp1, srcp2, dstp, weight, w);
+                    d->funcs[plane](srcp1, srcp2, dstp, weight, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     dstp += stride;
@@ -324,6 +367,7 @@ static void VS_CC mergeCreate(const VSMap *in, VSMap *out, void *userData, VSCor
     MergeData *data;
     int nweight;
     int i;
+    int cpulevel, autotune;
 
     nweight = vsapi->propNumElements(in, "weight");
     for (i = 0; i < 3; i++)
@@ -363,8 +407,6 @@ static void VS_CC mergeCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         }
     }
 
-    d.cpulevel = vs_get_cpulevel(core);
-
     if (isCompatFormat(d.vi) || isCompatFormat(vsapi->getVideoInfo(d.node2))) {
         vsapi->freeNode(d.node1);
         vsapi->freeNode(d.node2);
@@ -390,10 +432,23 @@ static void VS_CC mergeCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         RETERROR("Merge: more weights given than the number of planes to merge");
     }
 
+    cpulevel = vs_get_cpulevel(core);
+    autotune = vs_get_autotune(core);
+    for (i = 0; i < d.vi->format->numPlanes; i++) {
+        union vs_merge_weight weight;
+        if (d.vi->format->sampleType == stInteger)
+            weight.u = d.weight[i];
+        else
+            weight.f = d.fweight[i];
+        d.funcs[i] = d.process[i] ? NULL : (merge_func)selectKernel("Merge", mergeKernels, d.vi->format, cpulevel, autotune,
+            planeWidth(d.vi, i), planeHeight(d.vi, i), 3, mergeAutotuneRun, &weight);
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
     vsapi->createFilter(in, out, "Merge", mergeInit, mergeGetFrame, mergeFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, planeMask(d.process, 1, d.vi->format), vsapi);
 }
 
 //////////////////////////////////////////
@@ -408,7 +463,7 @@ typedef struct {
     int premultiplied;
     int first_plane;
     int process[3];
-    int cpulevel;
+    mask_merge_func funcs[3];
 } MaskedMergeData;
 
 static void VS_CC maskedMergeInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
@@ -448,7 +503,6 @@ static const VSFrameRef *VS_CC maskedMergeGetFrame(int n, int activationReason,
                 const uint8_t *maskp = vsapi->getReadPtr((plane && mask23) ? mask23 : mask, d->first_plane ? 0 : plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, const void *, void *, unsigned, unsigned, unsigned) = 0;
                 int yuvhandling = (plane > 0) && (d->vi->format->colorFamily == cmYUV || d->vi->format->colorFamily == cmYCoCg);
 
                 if (d->premultiplied && d->vi->format->sampleType == stInteger && offset1 != offset2) {
@@ -461,40 +515,12 @@ static const VSFrameRef *VS_CC maskedMergeGetFrame(int n, int activationReason,
                     return 0;
                 }
 
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = d->premultiplied ? vs_mask_merge_premul_byte_avx2 : vs_mask_merge_byte_avx2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = d->premultiplied ? vs_mask_merge_premul_word_avx2 : vs_mask_merge_word_avx2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = d->premultiplied ? vs_mask_merge_premul_float_avx2 : vs_mask_merge_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = d->premultiplied ? vs_mask_merge_premul_byte_sse2 : vs_mask_merge_byte_sse2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = d->premultiplied ? vs_mask_merge_premul_word_sse2 : vs_mask_merge_word_sse2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = d->premultiplied ? vs_mask_merge_premul_float_sse2 : vs_mask_merge_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = d->premultiplied ? (yuvhandling ? vs_mask_merge_premul_byte_c : vs_mask_merge_premul_byte_c) : vs_mask_merge_byte_c;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = d->premultiplied ? (yuvhandling ? vs_mask_merge_premul_word_c : vs_mask_merge_premul_word_c) : vs_mask_merge_word_c;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = d->premultiplied ? vs_mask_merge_premul_float_c : vs_mask_merge_float_c;
-                }
-
-                if (!func)
-                    continue;
-
-                int depth = d->vi->format->bitsPerSample;
+                MaskMergeParams params;
+                params.depth = d->vi->format->bitsPerSample;
+                params.offset = yuvhandling ? (1 << (params.depth - 1)) : offset1;
 
                 for (int y = 0; y < h; y++) {
-                    func(srcp1, srcp2, maskp, dstp, depth, yuvhandling ? (1 << (depth - 1)) : offset1, w);
+                    d->funcs[plane](srcp1, srcp2, maskp, dstp, params.depth, params.offset, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     maskp += stride;
@@ -527,6 +553,7 @@ static void VS_CC maskedMergeCreate(const VSMap *in, VSMap *out, void *userData,
     const VSVideoInfo *maskvi;
     int err;
     int m, n, o, i;
+    int cpulevel, autotune;
 
     d.mask23 = 0;
     d.node1 = vsapi->propGetNode(in, "clipa", 0, 0);
@@ -623,12 +650,22 @@ static void VS_CC maskedMergeCreate(const VSMap *in, VSMap *out, void *userData,
         vsapi->freeMap(min);
     }
 
-    d.cpulevel = vs_get_cpulevel(core);
+    cpulevel = vs_get_cpulevel(core);
+    autotune = vs_get_autotune(core);
+    for (i = 0; i < d.vi->format->numPlanes; i++) {
+        // the offset of the frames isn't known yet but only matters for the output of the benchmark
+        MaskMergeParams params;
+        params.depth = d.vi->format->bitsPerSample;
+        params.offset = ((i > 0) && (d.vi->format->colorFamily == cmYUV || d.vi->format->colorFamily == cmYCoCg)) ? (1 << (params.depth - 1)) : 0;
+        d.funcs[i] = !d.process[i] ? NULL : (mask_merge_func)selectKernel(d.premultiplied ? "MaskedMergePremultiplied" : "MaskedMerge",
+            d.premultiplied ? maskMergePremulKernels : maskMergeKernels, d.vi->format, cpulevel, autotune, planeWidth(d.vi, i), planeHeight(d.vi, i), 4, maskMergeAutotuneRun, &params);
+    }
 
     data = malloc(sizeof(d));
     *data = d;
 
     vsapi->createFilter(in, out, "MaskedMerge", maskedMergeInit, maskedMergeGetFrame, maskedMergeFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, planeMask(d.process, 0, d.vi->format), vsapi);
 }
 
 //////////////////////////////////////////
@@ -639,7 +676,7 @@ typedef struct {
     VSNodeRef *node2;
     const VSVideoInfo *vi;
     int process[3];
-    int cpulevel;
+    diff_func funcs[3];
 } MakeDiffData;
 
 static void VS_CC makeDiffInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
@@ -668,42 +705,9 @@ static const VSFrameRef *VS_CC makeDiffGetFrame(int n, int activationReason, voi
                 const uint8_t *srcp2 = vsapi->getReadPtr(src2, plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, void *, unsigned, unsigned) = 0;
-
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_makediff_byte_avx2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_makediff_word_avx2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_makediff_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_makediff_byte_sse2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_makediff_word_sse2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_makediff_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_makediff_byte_c;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_makediff_word_c;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_makediff_float_c;
-                }
-
-                if (!func)
-                    continue;
-
-                int depth = d->vi->format->bitsPerSample;
-
+                unsigned depth = d->vi->format->bitsPerSample;
                 for (int y = 0; y < h; ++y) {
-                    func(srcp1, srcp2, dstp, depth, w);
+                    d->funcs[plane](srcp1, srcp2, dstp, depth, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     dstp += stride;
@@ -730,6 +734,8 @@ static void VS_CC makeDiffCreate(const VSMap *in, VSMap *out, void *userData, VS
     MakeDiffData d;
     MakeDiffData *data;
     int i, m, n, o;
+    int cpulevel, autotune;
+    unsigned depth;
 
     d.node1 = vsapi->propGetNode(in, "clipa", 0, 0);
     d.node2 = vsapi->propGetNode(in, "clipb", 0, 0);
@@ -778,12 +784,18 @@ static void VS_CC makeDiffCreate(const VSMap *in, VSMap *out, void *userData, VS
         d.process[o] = 1;
     }
 
-    d.cpulevel = vs_get_cpulevel(core);
+    cpulevel = vs_get_cpulevel(core);
+    autotune = vs_get_autotune(core);
+    depth = d.vi->format->bitsPerSample;
+    for (i = 0; i < d.vi->format->numPlanes; i++)
+        d.funcs[i] = !d.process[i] ? NULL : (diff_func)selectKernel("MakeDiff", makeDiffKernels, d.vi->format, cpulevel, autotune,
+            planeWidth(d.vi, i), planeHeight(d.vi, i), 3, diffAutotuneRun, &depth);
 
     data = malloc(sizeof(d));
     *data = d;
 
     vsapi->createFilter(in, out, "MakeDiff", makeDiffInit, makeDiffGetFrame, makeDiffFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, planeMask(d.process, 0, d.vi->format), vsapi);
 }
 
 //////////////////////////////////////////
@@ -794,7 +806,7 @@ typedef struct {
     VSNodeRef *node2;
     const VSVideoInfo *vi;
     int process[3];
-    int cpulevel;
+    diff_func funcs[3];
 } MergeDiffData;
 
 static void VS_CC mergeDiffInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
@@ -823,42 +835,9 @@ static const VSFrameRef *VS_CC mergeDiffGetFrame(int n, int activationReason, vo
                 const uint8_t *srcp2 = vsapi->getReadPtr(src2, plane);
                 uint8_t * VS_RESTRICT dstp = vsapi->getWritePtr(dst, plane);
 
-                void (*func)(const void *, const void *, void *, unsigned, unsigned) = 0;
-
-#ifdef VS_TARGET_CPU_X86
-                if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_mergediff_byte_avx2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_mergediff_word_avx2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_mergediff_float_avx2;
-                }
-                if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_mergediff_byte_sse2;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_mergediff_word_sse2;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_mergediff_float_sse2;
-                }
-#endif
-                if (!func) {
-                    if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 1)
-                        func = vs_mergediff_byte_c;
-                    else if (d->vi->format->sampleType == stInteger && d->vi->format->bytesPerSample == 2)
-                        func = vs_mergediff_word_c;
-                    else if (d->vi->format->sampleType == stFloat && d->vi->format->bytesPerSample == 4)
-                        func = vs_mergediff_float_c;
-                }
-
-                if (!func)
-                    continue;
-
-                int depth = d->vi->format->bitsPerSample;
-
+                unsigned depth = d->vi->format->bitsPerSample;
                 for (int y = 0; y < h; ++y) {
-                    func(srcp1, srcp2, dstp, depth, w);
+                    d->funcs[plane](srcp1, srcp2, dstp, depth, w);
                     srcp1 += stride;
                     srcp2 += stride;
                     dstp += stride;
@@ -932,12 +911,18 @@ static void VS_CC mergeDiffCreate(const VSMap *in, VSMap *out, void *userData, V
         d.process[o] = 1;
     }
 
-    d.cpulevel = vs_get_cpulevel(core);
+    int cpulevel = vs_get_cpulevel(core);
+    int autotune = vs_get_autotune(core);
+    unsigned depth = d.vi->format->bitsPerSample;
+    for (int i = 0; i < d.vi->format->numPlanes; i++)
+        d.funcs[i] = !d.process[i] ? NULL : (diff_func)selectKernel("MergeDiff", mergeDiffKernels, d.vi->format, cpulevel, autotune,
+            planeWidth(d.vi, i), planeHeight(d.vi, i), 3, diffAutotuneRun, &depth);
 
     data = malloc(sizeof(d));
     *data = d;
 
     vsapi->createFilter(in, out, "MergeDiff", mergeDiffInit, mergeDiffGetFrame, mergeDiffFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhPointwise, 0, 0, planeMask(d.process, 0, d.vi->format), vsapi);
 }
 
 //////////////////////////////////////////
@@ -0,0 +1,233 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "plugincache.h"
+#include "VapourSynth.h"
+#include "version.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef VS_TARGET_OS_WINDOWS
+#include "../common/vsutf16.h"
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+// The cache is a text file with one line per plugin followed by one line per function:
+//   P <path> <mtime> <size> <filename> <id> <namespace> <full name> <api version> <read only>
+//   F <name> <arguments>
+// with the fields separated by tabs. The mtime is in nanoseconds, or FILETIME units on Windows.
+// The first line identifies the core that wrote it, the whole file is ignored when it doesn't
+// match since a different core may reject other plugins.
+
+static const char cacheHeader[] = "VapourSynthPluginCache";
+
+static std::string headerLine() {
+    return std::string(cacheHeader) + " " + std::to_string(VAPOURSYNTH_API_VERSION) + " " + std::to_string(VAPOURSYNTH_CORE_VERSION);
+}
+
+static std::vector<std::string> splitFields(const std::string &line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos)
+            return fields;
+        start = end + 1;
+    }
+}
+
+static bool isStorable(const std::string &s) {
+    return s.find_first_of("\t\r\n") == std::string::npos;
+}
+
+static FILE *openFile(const std::string &path, const char *mode) {
+#ifdef VS_TARGET_OS_WINDOWS
+    return _wfopen(utf16_from_utf8(path).c_str(), utf16_from_utf8(mode).c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+static bool readLine(FILE *f, std::string &line) {
+    line.clear();
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c == '\n')
+            return true;
+        line.push_back(static_cast<char>(c));
+    }
+    return !line.empty();
+}
+
+PluginCache::PluginCache(const std::string &cachePath) : cachePath(cachePath), modified(false) {
+    if (cachePath.empty())
+        return;
+
+    FILE *f = openFile(cachePath, "rb");
+    if (!f) {
+        modified = true;
+        return;
+    }
+
+    std::string line;
+    if (!readLine(f, line) || line != headerLine()) {
+        fclose(f);
+        modified = true;
+        return;
+    }
+
+    PluginCacheEntry *current = nullptr;
+    while (readLine(f, line)) {
+        std::vector<std::string> fields = splitFields(line);
+        if (fields[0] == "P" && fields.size() == 10) {
+            PluginCacheEntry entry;
+            entry.path = fields[1];
+            entry.mtime = strtoll(fields[2].c_str(), nullptr, 10);
+            entry.size = strtoll(fields[3].c_str(), nullptr, 10);
+            entry.filename = fields[4];
+            entry.id = fields[5];
+            entry.fnamespace = fields[6];
+            entry.fullname = fields[7];
+            entry.apiVersion = atoi(fields[8].c_str());
+            entry.readOnly = fields[9] == "1";
+            current = &(entries[entry.path] = entry);
+        } else if (fields[0] == "F" && fields.size() == 3 && current) {
+            current->functions.push_back(std::make_pair(fields[1], fields[2]));
+        } else {
+            // a damaged file is simply rebuilt
+            entries.clear();
+            modified = true;
+            break;
+        }
+    }
+
+    fclose(f);
+}
+
+const PluginCacheEntry *PluginCache::find(const std::string &path, int64_t mtime, int64_t size) {
+    auto iter = entries.find(path);
+    if (iter == entries.end() || iter->second.mtime != mtime || iter->second.size != size)
+        return nullptr;
+    used.insert(path);
+    return &iter->second;
+}
+
+void PluginCache::insert(const PluginCacheEntry &entry) {
+    if (cachePath.empty())
+        return;
+
+    bool storable = isStorable(entry.path) && isStorable(entry.filename) && isStorable(entry.id) && isStorable(entry.fnamespace) && isStorable(entry.fullname);
+    for (const auto &iter : entry.functions)
+        storable = storable && isStorable(iter.first) && isStorable(iter.second);
+    if (!storable)
+        return;
+
+    entries[entry.path] = entry;
+    used.insert(entry.path);
+    modified = true;
+}
+
+void PluginCache::save() {
+    if (cachePath.empty())
+        return;
+
+    // the file may be shared with cores that autoload from other directories so entries that weren't looked
+    // up are kept, only the ones whose file is gone or has changed since are dropped
+    for (auto iter = entries.begin(); iter != entries.end();) {
+        int64_t mtime;
+        int64_t size;
+        if (!used.count(iter->first) && (!getFileInfo(iter->first, mtime, size) || mtime != iter->second.mtime || size != iter->second.size)) {
+            iter = entries.erase(iter);
+            modified = true;
+        } else {
+            ++iter;
+        }
+    }
+
+    if (!modified)
+        return;
+
+    // create the directories leading up to the file, failures show up when opening it
+    for (size_t pos = cachePath.find_first_of("/\\", 1); pos != std::string::npos; pos = cachePath.find_first_of("/\\", pos + 1)) {
+#ifdef VS_TARGET_OS_WINDOWS
+        CreateDirectory(utf16_from_utf8(cachePath.substr(0, pos)).c_str(), nullptr);
+#else
+        mkdir(cachePath.substr(0, pos).c_str(), 0755);
+#endif
+    }
+
+    // written to a temporary file first so other processes never see a partial cache, the counter keeps cores
+    // saved at the same time in one process apart
+    static std::atomic<unsigned> tempCounter(0);
+#ifdef VS_TARGET_OS_WINDOWS
+    std::string tempPath = cachePath + "." + std::to_string(GetCurrentProcessId()) + "." + std::to_string(tempCounter++);
+#else
+    std::string tempPath = cachePath + "." + std::to_string(getpid()) + "." + std::to_string(tempCounter++);
+#endif
+
+    FILE *f = openFile(tempPath, "wb");
+    if (!f)
+        return;
+
+    bool ok = fprintf(f, "%s\n", headerLine().c_str()) > 0;
+    for (const auto &iter : entries) {
+        const PluginCacheEntry &e = iter.second;
+        ok = ok && fprintf(f, "P\t%s\t%lld\t%lld\t%s\t%s\t%s\t%s\t%d\t%d\n", e.path.c_str(), static_cast<long long>(e.mtime), static_cast<long long>(e.size),
+            e.filename.c_str(), e.id.c_str(), e.fnamespace.c_str(), e.fullname.c_str(), e.apiVersion, e.readOnly ? 1 : 0) > 0;
+        for (const auto &func : e.functions)
+            ok = ok && fprintf(f, "F\t%s\t%s\n", func.first.c_str(), func.second.c_str()) > 0;
+    }
+    ok = !fclose(f) && ok;
+
+#ifdef VS_TARGET_OS_WINDOWS
+    if (!ok || !MoveFileEx(utf16_from_utf8(tempPath).c_str(), utf16_from_utf8(cachePath).c_str(), MOVEFILE_REPLACE_EXISTING))
+        DeleteFile(utf16_from_utf8(tempPath).c_str());
+#else
+    if (!ok || rename(tempPath.c_str(), cachePath.c_str()))
+        remove(tempPath.c_str());
+#endif
+}
+
+bool PluginCache::getFileInfo(const std::string &path, int64_t &mtime, int64_t &size) {
+#ifdef VS_TARGET_OS_WINDOWS
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesEx(utf16_from_utf8(path).c_str(), GetFileExInfoStandard, &data))
+        return false;
+    mtime = (static_cast<int64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    size = (static_cast<int64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st))
+        return false;
+    // whole seconds miss a plugin that's rebuilt right after it was cached so use the full timestamp
+#ifdef VS_TARGET_OS_DARWIN
+    mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    size = static_cast<int64_t>(st.st_size);
+#endif
+    return true;
+}
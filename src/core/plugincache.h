@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef PLUGINCACHE_H
+#define PLUGINCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Everything needed to register an autoloaded plugin without loading the library
+struct PluginCacheEntry {
+    std::string path; // the path the library was found at while autoloading, used as the key
+    int64_t mtime;
+    int64_t size;
+    std::string filename; // the resolved path that's loaded
+    std::string id;
+    std::string fnamespace;
+    std::string fullname;
+    int apiVersion;
+    bool readOnly;
+    std::vector<std::pair<std::string, std::string>> functions; // name and argument string
+};
+
+class PluginCache {
+private:
+    std::string cachePath;
+    std::map<std::string, PluginCacheEntry> entries;
+    std::set<std::string> used;
+    bool modified;
+public:
+    // an empty path disables the cache
+    explicit PluginCache(const std::string &cachePath);
+    // returns nullptr if there's no entry or the file has changed since it was written
+    const PluginCacheEntry *find(const std::string &path, int64_t mtime, int64_t size);
+    void insert(const PluginCacheEntry &entry);
+    // writes all entries except the ones for files that were removed or changed since they were cached
+    void save();
+    static bool getFileInfo(const std::string &path, int64_t &mtime, int64_t &size);
+};
+
+#endif // PLUGINCACHE_H
@@ -22,6 +22,7 @@
 #include "VSHelper.h"
 #include "filtershared.h"
 #include <stdlib.h>
+#include <string.h>
 
 //////////////////////////////////////////
 // Shared
@@ -79,6 +80,277 @@ static int compareInts(const void* a, const void* b) {
     return 0;
 }
 
+//////////////////////////////////////////
+// Remap
+
+// Filters that only pick frames from their inputs describe their output as a
+// list of segments that each take evenly spaced frames from one clip. When an
+// input is itself described this way its segments are used instead, so a chain
+// of edits becomes a single node reading the original clips and a request is a
+// binary search no matter how many edits were made.
+
+#define REMAP_MAX_SEGMENTS 65536
+
+typedef struct {
+    int first; // first output frame
+    int length;
+    int clip;
+    int start; // source frame for the first output frame
+    int step;
+    // frame durations are multiplied by durationMul / durationDiv
+    int64_t durationMul;
+    int64_t durationDiv;
+} RemapSegment;
+
+typedef struct {
+    int64_t id;
+    int clip;
+} RemapClipId;
+
+typedef struct {
+    VSNodeRef **node;
+    int numclips;
+    VSVideoInfo vi;
+    RemapSegment *segments;
+    int numsegments;
+    int capacity;
+    int failed;
+    // sorted by node id so each clip is only added once, only used while adding segments
+    RemapClipId *ids;
+    int numids;
+} RemapData;
+
+static void VS_CC remapInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
+    RemapData *d = (RemapData *) * instanceData;
+    vsapi->setVideoInfo(&d->vi, 1, node);
+}
+
+static const RemapSegment *remapFindSegment(const RemapData *d, int n) {
+    int lo = 0;
+    int hi = d->numsegments - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (d->segments[mid].first <= n)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return &d->segments[lo];
+}
+
+static const VSFrameRef *VS_CC remapGetframe(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+    RemapData *d = (RemapData *) * instanceData;
+
+    if (activationReason == arInitial) {
+        const RemapSegment *s = remapFindSegment(d, n);
+        *frameData = (void *)s;
+        vsapi->requestFrameFilter(s->start + s->step * (n - s->first), d->node[s->clip], frameCtx);
+    } else if (activationReason == arAllFramesReady) {
+        const RemapSegment *s = (const RemapSegment *) * frameData;
+        const VSFrameRef *src = vsapi->getFrameFilter(s->start + s->step * (n - s->first), d->node[s->clip], frameCtx);
+        if (s->durationMul != s->durationDiv) {
+            VSFrameRef *dst = vsapi->copyFrame(src, core);
+            vsapi->freeFrame(src);
+
+            VSMap *dst_props = vsapi->getFramePropsRW(dst);
+            int errNum, errDen;
+            int64_t durationNum = vsapi->propGetInt(dst_props, "_DurationNum", 0, &errNum);
+            int64_t durationDen = vsapi->propGetInt(dst_props, "_DurationDen", 0, &errDen);
+            if (!errNum && !errDen) {
+                muldivRational(&durationNum, &durationDen, s->durationMul, s->durationDiv);
+                vsapi->propSetInt(dst_props, "_DurationNum", durationNum, paReplace);
+                vsapi->propSetInt(dst_props, "_DurationDen", durationDen, paReplace);
+            }
+            return dst;
+        } else {
+            return src;
+        }
+    }
+
+    return 0;
+}
+
+static void remapClear(RemapData *d, const VSAPI *vsapi) {
+    for (int i = 0; i < d->numclips; i++)
+        vsapi->freeNode(d->node[i]);
+
+    free(d->node);
+    free(d->segments);
+    free(d->ids);
+}
+
+static void VS_CC remapFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+    RemapData *d = (RemapData *)instanceData;
+    remapClear(d, vsapi);
+    free(d);
+}
+
+static int remapClipIndex(RemapData *d, VSNodeRef *node, const VSAPI *vsapi) {
+    VSNodeInfo info;
+    vsapi->getNodeInfo(node, &info);
+
+    // the id doesn't say which output is used so only single output nodes are shared
+    int pos = d->numids;
+    if (info.numOutputs == 1) {
+        int lo = 0;
+        int hi = d->numids;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (d->ids[mid].id < info.id)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < d->numids && d->ids[lo].id == info.id)
+            return d->ids[lo].clip;
+        pos = lo;
+    }
+
+    d->node = realloc(d->node, sizeof(d->node[0]) * (d->numclips + 1));
+    d->node[d->numclips] = vsapi->cloneNodeRef(node);
+
+    if (info.numOutputs == 1) {
+        d->ids = realloc(d->ids, sizeof(d->ids[0]) * (d->numids + 1));
+        memmove(d->ids + pos + 1, d->ids + pos, sizeof(d->ids[0]) * (d->numids - pos));
+        d->ids[pos].id = info.id;
+        d->ids[pos].clip = d->numclips;
+        d->numids++;
+    }
+
+    return d->numclips++;
+}
+
+static void remapAppend(RemapData *d, int clip, int start, int step, int length, int64_t durationMul, int64_t durationDiv) {
+    if (d->failed || length <= 0)
+        return;
+
+    int first = 0;
+
+    if (d->numsegments) {
+        RemapSegment *last = &d->segments[d->numsegments - 1];
+        first = last->first + last->length;
+
+        if (last->clip == clip && last->durationMul == durationMul && last->durationDiv == durationDiv) {
+            // a single frame can continue any progression
+            int laststep = (last->length == 1) ? start - last->start : last->step;
+            if ((length == 1 || step == laststep) && (int64_t)last->start + (int64_t)laststep * last->length == start) {
+                last->step = laststep;
+                last->length += length;
+                return;
+            }
+        }
+    }
+
+    if (d->numsegments == REMAP_MAX_SEGMENTS) {
+        d->failed = 1;
+        return;
+    }
+
+    if (d->numsegments == d->capacity) {
+        d->capacity = d->capacity ? d->capacity * 2 : 16;
+        d->segments = realloc(d->segments, sizeof(d->segments[0]) * d->capacity);
+    }
+
+    RemapSegment *s = &d->segments[d->numsegments++];
+    s->first = first;
+    s->length = length;
+    s->clip = clip;
+    s->start = start;
+    s->step = step;
+    s->durationMul = durationMul;
+    s->durationDiv = durationDiv;
+}
+
+// Appends frames start, start + step, ... of node to the output
+static void remapAddClip(RemapData *d, VSNodeRef *node, int start, int step, int length, int64_t durationMul, int64_t durationDiv, const VSAPI *vsapi) {
+    if (d->failed || length <= 0)
+        return;
+
+    int64_t end = start + (int64_t)step * (length - 1);
+    int numFrames = vsapi->getVideoInfo(node)->numFrames;
+    if (start < 0 || start >= numFrames || end < 0 || end >= numFrames) {
+        d->failed = 1;
+        return;
+    }
+
+    const RemapData *src = (const RemapData *)getFilterInstanceData(node, remapGetframe);
+    if (!src) {
+        remapAppend(d, remapClipIndex(d, node, vsapi), start, step, length, durationMul, durationDiv);
+        return;
+    }
+
+    // the clip lookup is only done once for each of src's clips
+    int *clips = malloc(sizeof(clips[0]) * src->numclips);
+    for (int i = 0; i < src->numclips; i++)
+        clips[i] = -1;
+
+    const RemapSegment *s = NULL;
+    for (int i = 0; i < length && !d->failed;) {
+        int n = start + step * i;
+        // usually the frames continue in the neighbouring segment
+        if (s && step > 0 && s + 1 < src->segments + src->numsegments && n >= s[1].first && n < s[1].first + s[1].length)
+            s++;
+        else if (s && step < 0 && s > src->segments && n >= s[-1].first && n < s[-1].first + s[-1].length)
+            s--;
+        else
+            s = remapFindSegment(src, n);
+        int offset = n - s->first;
+        int count = length - i;
+        if (step > 0)
+            count = VSMIN(count, (s->length - 1 - offset) / step + 1);
+        else if (step < 0)
+            count = VSMIN(count, offset / -step + 1);
+
+        int64_t mul = durationMul;
+        int64_t div = durationDiv;
+        muldivRational(&mul, &div, s->durationMul, s->durationDiv);
+        // the frames are inside the segment so the combined step can't overflow
+        if (clips[s->clip] < 0)
+            clips[s->clip] = remapClipIndex(d, src->node[s->clip], vsapi);
+        remapAppend(d, clips[s->clip], s->start + s->step * offset, count > 1 ? s->step * step : 0, count, mul, div);
+        i += count;
+    }
+
+    free(clips);
+}
+
+// Creates a remap filter from the segments added to d. Returns 0 when the
+// segments couldn't describe the filter and the caller has to create its own.
+static int remapCreate(RemapData *d, const char *name, const VSVideoInfo *vi, VSMap *out, VSCore *core, const VSAPI *vsapi) {
+    if (d->failed || !d->numsegments || d->segments[d->numsegments - 1].first + d->segments[d->numsegments - 1].length != vi->numFrames) {
+        remapClear(d, vsapi);
+        return 0;
+    }
+
+    d->vi = *vi;
+
+    // the edits cancelled each other out
+    const RemapSegment *s = d->segments;
+    const VSVideoInfo *srcvi = vsapi->getVideoInfo(d->node[0]);
+    if (d->numclips == 1 && d->numsegments == 1 && s->start == 0 && (s->step == 1 || s->length == 1) && s->durationMul == s->durationDiv &&
+        isSameFormat(vi, srcvi) && vi->numFrames == srcvi->numFrames && vi->fpsNum == srcvi->fpsNum && vi->fpsDen == srcvi->fpsDen) {
+        vsapi->propSetNode(out, "clip", d->node[0], paReplace);
+        remapClear(d, vsapi);
+        return 1;
+    }
+
+    // the node only depends on the clips it reads frames from
+    VSMap *args = vsapi->createMap();
+    for (int i = 0; i < d->numclips; i++)
+        vsapi->propSetNode(args, "clips", d->node[i], paAppend);
+
+    free(d->ids);
+    d->ids = NULL;
+    d->numids = 0;
+
+    RemapData *data = malloc(sizeof(*d));
+    *data = *d;
+
+    vsapi->createFilter(args, out, name, remapInit, remapGetframe, remapFree, fmParallel, nfNoCache, data, core);
+    vsapi->freeMap(args);
+    return 1;
+}
+
 //////////////////////////////////////////
 // Trim
 
@@ -160,6 +432,15 @@ static void VS_CC trimCreate(const VSMap *in, VSMap *out, void *userData, VSCore
         return;
     }
 
+    RemapData r = { 0 };
+    remapAddClip(&r, d.node, d.first, 1, d.trimlen, 1, 1, vsapi);
+    VSVideoInfo vi = d.vi;
+    vi.numFrames = d.trimlen;
+    if (remapCreate(&r, "Trim", &vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -290,6 +571,19 @@ static void VS_CC interleaveCreate(const VSMap *in, VSMap *out, void *userData,
         if (d.modifyDuration)
             muldivRational(&d.vi.fpsNum, &d.vi.fpsDen, d.numclips, 1);
 
+        // every frame is added on its own so very long clips are left to interleaveGetframe, even when
+        // the frames would merge into a few segments it takes too long to find out
+        RemapData r = { 0 };
+        r.failed = d.vi.numFrames > REMAP_MAX_SEGMENTS;
+        for (int n = 0; n < d.vi.numFrames && !r.failed; n++)
+            remapAddClip(&r, d.node[n % d.numclips], n / d.numclips, 1, 1, 1, d.modifyDuration ? d.numclips : 1, vsapi);
+        if (remapCreate(&r, "Interleave", &d.vi, out, core, vsapi)) {
+            for (int i = 0; i < d.numclips; i++)
+                vsapi->freeNode(d.node[i]);
+            free(d.node);
+            return;
+        }
+
         data = malloc(sizeof(d));
         *data = d;
 
@@ -319,6 +613,13 @@ static void VS_CC reverseCreate(const VSMap *in, VSMap *out, void *userData, VSC
     d.node = vsapi->propGetNode(in, "clip", 0, 0);
     d.vi = vsapi->getVideoInfo(d.node);
 
+    RemapData r = { 0 };
+    remapAddClip(&r, d.node, d.vi->numFrames - 1, -1, d.vi->numFrames, 1, 1, vsapi);
+    if (remapCreate(&r, "Reverse", d.vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -381,6 +682,23 @@ static void VS_CC loopCreate(const VSMap *in, VSMap *out, void *userData, VSCore
         d.vi.numFrames = INT_MAX;
     }
 
+    RemapData r = { 0 };
+    for (int n = 0; !r.failed; n += d.numFramesIn) {
+        // once all frames so far are the same one the clip only repeats a single frame, so the rest is added at once
+        // instead of merging one loop at a time into the segment
+        if (r.numsegments == 1 && r.segments[0].length > 1 && r.segments[0].step == 0) {
+            remapAddClip(&r, d.node, 0, 0, d.vi.numFrames - n, 1, 1, vsapi);
+            break;
+        }
+        remapAddClip(&r, d.node, 0, 1, VSMIN(d.numFramesIn, d.vi.numFrames - n), 1, 1, vsapi);
+        if (d.vi.numFrames - n <= d.numFramesIn)
+            break;
+    }
+    if (remapCreate(&r, "Loop", &d.vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -486,6 +804,35 @@ static void VS_CC selectEveryCreate(const VSMap *in, VSMap *out, void *userData,
     if (d.modifyDuration)
         muldivRational(&d.vi.fpsNum, &d.vi.fpsDen, d.num, d.cycle);
 
+    RemapData r = { 0 };
+    int64_t durationMul = 1;
+    int64_t durationDiv = 1;
+    if (d.modifyDuration)
+        muldivRational(&durationMul, &durationDiv, d.cycle, d.num);
+    if (d.num == 1) {
+        remapAddClip(&r, d.node, d.offsets[0], d.cycle, d.vi.numFrames, durationMul, durationDiv, vsapi);
+    } else {
+        // consecutive offsets are added together, past REMAP_MAX_SEGMENTS additions selectEveryGetframe is used
+        // instead since going through all frames of a very long clip takes too long
+        int additions = 0;
+        for (int n = 0; n < d.vi.numFrames && !r.failed;) {
+            int i = n % d.num;
+            int length = 1;
+            while (i + length < d.num && n + length < d.vi.numFrames && d.offsets[i + length] == d.offsets[i] + length)
+                length++;
+            if (++additions > REMAP_MAX_SEGMENTS)
+                r.failed = 1;
+            else
+                remapAddClip(&r, d.node, (n / d.num) * d.cycle + d.offsets[i], 1, length, durationMul, durationDiv, vsapi);
+            n += length;
+        }
+    }
+    if (remapCreate(&r, "SelectEvery", &d.vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        free(d.offsets);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -498,7 +845,7 @@ static void VS_CC selectEveryCreate(const VSMap *in, VSMap *out, void *userData,
 typedef struct {
     VSNodeRef **node;
     VSVideoInfo vi;
-    int *numframes;
+    int *firstframe; // first output frame of each clip
     int numclips;
 } SpliceData;
 
@@ -507,39 +854,26 @@ static void VS_CC spliceInit(VSMap *in, VSMap *out, void **instanceData, VSNode
     vsapi->setVideoInfo(&d->vi, 1, node);
 }
 
-typedef struct {
-    int f;
-    int idx;
-} SpliceCtx;
-
 static const VSFrameRef *VS_CC spliceGetframe(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
     SpliceData *d = (SpliceData *) * instanceData;
 
     if (activationReason == arInitial) {
-        int frame = 0;
-        int idx = 0;
-        int cumframe = 0;
-        SpliceCtx *s = malloc(sizeof(SpliceCtx));
-
-        for (int i = 0; i < d->numclips; i++) {
-            if ((n >= cumframe && n < cumframe + d->numframes[i]) || i == d->numclips - 1) {
-                idx = i;
-                frame = n - cumframe;
-                break;
-            }
-
-            cumframe += d->numframes[i];
+        // the last clip starting at or before n
+        int lo = 0;
+        int hi = d->numclips - 1;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (d->firstframe[mid] <= n)
+                lo = mid;
+            else
+                hi = mid - 1;
         }
 
-        *frameData = s;
-        s->f = frame;
-        s->idx = idx;
-        vsapi->requestFrameFilter(frame, d->node[idx], frameCtx);
+        *frameData = (void *)(intptr_t)lo;
+        vsapi->requestFrameFilter(n - d->firstframe[lo], d->node[lo], frameCtx);
     } else if (activationReason == arAllFramesReady) {
-        SpliceCtx *s = (SpliceCtx *) * frameData;
-        const VSFrameRef *f = vsapi->getFrameFilter(s->f, d->node[s->idx], frameCtx);
-        free(s);
-        return f;
+        int idx = (int)(intptr_t)*frameData;
+        return vsapi->getFrameFilter(n - d->firstframe[idx], d->node[idx], frameCtx);
     }
 
     return 0;
@@ -551,7 +885,7 @@ static void VS_CC spliceFree(void *instanceData, VSCore *core, const VSAPI *vsap
         vsapi->freeNode(d->node[i]);
 
     free(d->node);
-    free(d->numframes);
+    free(d->firstframe);
     free(d);
 }
 
@@ -595,29 +929,79 @@ static void VS_CC spliceCreate(const VSMap *in, VSMap *out, void *userData, VSCo
                 RETERROR("Splice: the clips' lengths don't match");
         }
 
-        d.numframes = malloc(sizeof(d.numframes[0]) * d.numclips);
+        d.firstframe = malloc(sizeof(d.firstframe[0]) * d.numclips);
         d.vi.numFrames = 0;
 
         for (int i = 0; i < d.numclips; i++) {
-            d.numframes[i] = (vsapi->getVideoInfo(d.node[i]))->numFrames;
-            d.vi.numFrames += d.numframes[i];
+            int numFrames = vsapi->getVideoInfo(d.node[i])->numFrames;
+            d.firstframe[i] = d.vi.numFrames;
 
-            // did it overflow?
-            if (d.vi.numFrames < d.numframes[i]) {
-                for (int j = 0; j < d.numclips; i++)
+            if (d.vi.numFrames > INT_MAX - numFrames) {
+                for (int j = 0; j < d.numclips; j++)
                     vsapi->freeNode(d.node[j]);
 
                 free(d.node);
-                free(d.numframes);
+                free(d.firstframe);
 
                 RETERROR("Splice: the resulting clip is too long");
             }
+
+            d.vi.numFrames += numFrames;
+        }
+
+        RemapData r = { 0 };
+        for (int i = 0; i < d.numclips; i++)
+            remapAddClip(&r, d.node[i], 0, 1, vsapi->getVideoInfo(d.node[i])->numFrames, 1, 1, vsapi);
+        if (remapCreate(&r, "Splice", &d.vi, out, core, vsapi)) {
+            for (int i = 0; i < d.numclips; i++)
+                vsapi->freeNode(d.node[i]);
+            free(d.node);
+            free(d.firstframe);
+            return;
+        }
+
+        // read directly from the clips of nested splices
+        int numflat = 0;
+        for (int i = 0; i < d.numclips; i++) {
+            const SpliceData *nested = (const SpliceData *)getFilterInstanceData(d.node[i], spliceGetframe);
+            numflat += nested ? nested->numclips : 1;
         }
 
+        if (numflat > d.numclips) {
+            VSNodeRef **flat = malloc(sizeof(flat[0]) * numflat);
+            int *firstframe = malloc(sizeof(firstframe[0]) * numflat);
+            int pos = 0;
+
+            for (int i = 0; i < d.numclips; i++) {
+                const SpliceData *nested = (const SpliceData *)getFilterInstanceData(d.node[i], spliceGetframe);
+                if (nested) {
+                    for (int j = 0; j < nested->numclips; j++) {
+                        flat[pos] = vsapi->cloneNodeRef(nested->node[j]);
+                        firstframe[pos++] = d.firstframe[i] + nested->firstframe[j];
+                    }
+                    vsapi->freeNode(d.node[i]);
+                } else {
+                    flat[pos] = d.node[i];
+                    firstframe[pos++] = d.firstframe[i];
+                }
+            }
+
+            free(d.node);
+            free(d.firstframe);
+            d.node = flat;
+            d.firstframe = firstframe;
+            d.numclips = numflat;
+        }
+
+        VSMap *args = vsapi->createMap();
+        for (int i = 0; i < d.numclips; i++)
+            vsapi->propSetNode(args, "clips", d.node[i], paAppend);
+
         data = malloc(sizeof(d));
         *data = d;
 
-        vsapi->createFilter(in, out, "Splice", spliceInit, spliceGetframe, spliceFree, fmParallel, nfNoCache, data, core);
+        vsapi->createFilter(args, out, "Splice", spliceInit, spliceGetframe, spliceFree, fmParallel, nfNoCache, data, core);
+        vsapi->freeMap(args);
     }
 }
 
@@ -695,6 +1079,19 @@ static void VS_CC duplicateFramesCreate(const VSMap *in, VSMap *out, void *userD
     }
     d.vi.numFrames += d.num_dups;
 
+    RemapData r = { 0 };
+    int prev = 0;
+    for (int i = 0; i < d.num_dups; i++) {
+        remapAddClip(&r, d.node, prev, 1, d.dups[i] - prev + 1, 1, 1, vsapi);
+        prev = d.dups[i];
+    }
+    remapAddClip(&r, d.node, prev, 1, d.vi.numFrames - d.num_dups - prev, 1, 1, vsapi);
+    if (remapCreate(&r, "DuplicateFrames", &d.vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        free(d.dups);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -785,6 +1182,19 @@ static void VS_CC deleteFramesCreate(const VSMap *in, VSMap *out, void *userData
         }
     }
 
+    RemapData r = { 0 };
+    int prev = 0;
+    for (int i = 0; i < d.num_delete; i++) {
+        remapAddClip(&r, d.node, prev, 1, d.delete[i] - prev, 1, 1, vsapi);
+        prev = d.delete[i] + 1;
+    }
+    remapAddClip(&r, d.node, prev, 1, d.vi.numFrames + d.num_delete - prev, 1, 1, vsapi);
+    if (remapCreate(&r, "DeleteFrames", &d.vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        free(d.delete);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
@@ -893,6 +1303,20 @@ static void VS_CC freezeFramesCreate(const VSMap *in, VSMap *out, void *userData
             return;
         }
 
+    RemapData r = { 0 };
+    int prev = 0;
+    for (int i = 0; i < d.num_freeze; i++) {
+        remapAddClip(&r, d.node, prev, 1, d.freeze[i].first - prev, 1, 1, vsapi);
+        remapAddClip(&r, d.node, d.freeze[i].replacement, 0, d.freeze[i].last - d.freeze[i].first + 1, 1, 1, vsapi);
+        prev = d.freeze[i].last + 1;
+    }
+    remapAddClip(&r, d.node, prev, 1, d.vi->numFrames - prev, 1, 1, vsapi);
+    if (remapCreate(&r, "FreezeFrames", d.vi, out, core, vsapi)) {
+        vsapi->freeNode(d.node);
+        free(d.freeze);
+        return;
+    }
+
     data = malloc(sizeof(d));
     *data = d;
 
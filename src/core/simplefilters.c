@@ -27,10 +27,14 @@
 #include "cpufeatures.h"
 #include "internalfilters.h"
 #include "filtershared.h"
+#include "kernel/autotune.h"
 #include "kernel/cpulevel.h"
 #include "kernel/planestats.h"
 #include "kernel/transpose.h"
 
+// untouched planes hint for filters that only modify frame properties
+static const int allPlanes = 7;
+
 static inline uint32_t doubleToUInt32S(double v) {
     if (v < 0)
         return 0;
@@ -199,16 +203,21 @@ static const VSFrameRef *VS_CC cropGetframe(int n, int activationReason, void **
             return NULL;
         }
 
-        VSFrameRef *dst = vsapi->newVideoFrame(fi, d->width, d->height, src, core);
+        // only copy when the view would need a different stride
+        VSFrameRef *dst = vsapi->cropFrameView(src, d->x, y, d->width, d->height, core);
 
-        for (int plane = 0; plane < fi->numPlanes; plane++) {
-            int srcstride = vsapi->getStride(src, plane);
-            int dststride = vsapi->getStride(dst, plane);
-            const uint8_t *srcdata = vsapi->getReadPtr(src, plane);
-            uint8_t *dstdata = vsapi->getWritePtr(dst, plane);
-            srcdata += srcstride * (y >> (plane ? fi->subSamplingH : 0));
-            srcdata += (d->x >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample;
-            vs_bitblt(dstdata, dststride, srcdata, srcstride, (d->width >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane));
+        if (!dst) {
+            dst = vsapi->newVideoFrame(fi, d->width, d->height, src, core);
+
+            for (int plane = 0; plane < fi->numPlanes; plane++) {
+                int srcstride = vsapi->getStride(src, plane);
+                int dststride = vsapi->getStride(dst, plane);
+                const uint8_t *srcdata = vsapi->getReadPtr(src, plane);
+                uint8_t *dstdata = vsapi->getWritePtr(dst, plane);
+                srcdata += srcstride * (y >> (plane ? fi->subSamplingH : 0));
+                srcdata += (d->x >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample;
+                vs_bitblt(dstdata, dststride, srcdata, srcstride, (d->width >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane));
+            }
         }
 
         vsapi->freeFrame(src);
@@ -255,6 +264,7 @@ static void VS_CC cropAbsCreate(const VSMap *in, VSMap *out, void *userData, VSC
     *data = d;
 
     vsapi->createFilter(in, out, "Crop", cropInit, cropGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, 0, vsapi);
 }
 
 static void VS_CC cropRelCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
@@ -293,6 +303,7 @@ static void VS_CC cropRelCreate(const VSMap *in, VSMap *out, void *userData, VSC
     *data = d;
 
     vsapi->createFilter(in, out, "Crop", cropInit, cropGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -502,6 +513,7 @@ static void VS_CC addBordersCreate(const VSMap *in, VSMap *out, void *userData,
     *data = d;
 
     vsapi->createFilter(in, out, "AddBorders", addBordersInit, addBordersGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure, 0, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -684,6 +696,7 @@ static void VS_CC shufflePlanesCreate(const VSMap *in, VSMap *out, void *userDat
     *data = d;
 
     vsapi->createFilter(in, out, "ShufflePlanes", shufflePlanesInit, shufflePlanesGetframe, shufflePlanesFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -799,6 +812,7 @@ static void VS_CC separateFieldsCreate(const VSMap *in, VSMap *out, void *userDa
     *data = d;
 
     vsapi->createFilter(in, out, "SeparateFields", separateFieldsInit, separateFieldsGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, -1, -1, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -858,31 +872,40 @@ static const VSFrameRef *VS_CC doubleWeaveGetframe(int n, int activationReason,
             return NULL;
         }
 
-        VSFrameRef *dst = vsapi->newVideoFrame(d->vi.format, d->vi.width, d->vi.height, src1, core);
-        const VSFormat *fi = vsapi->getFrameFormat(dst);
-        VSMap *dstprops = vsapi->getFramePropsRW(dst);
-        vsapi->propDeleteKey(dstprops, "_Field");
-        vsapi->propSetInt(dstprops, "_FieldBased", 1 + (srctop == src1), paReplace);
+        // fields that were separated from the same frame can simply be put back together
+        VSFrameRef *dst = vsapi->weaveFrameViews(srctop, srcbtn, core);
 
-        for (int plane = 0; plane < fi->numPlanes; plane++) {
-            const uint8_t *srcptop = vsapi->getReadPtr(srctop, plane);
-            const uint8_t *srcpbtn = vsapi->getReadPtr(srcbtn, plane);
-            int src_stride = vsapi->getStride(srcbtn, plane);
-            uint8_t *dstp = vsapi->getWritePtr(dst, plane);
-            int dst_stride = vsapi->getStride(dst, plane);
-            int h = vsapi->getFrameHeight(srctop, plane);
-            size_t row_size = vsapi->getFrameWidth(dst, plane) * fi->bytesPerSample;
-
-            for (int hl = 0; hl < h; hl++) {
-                memcpy(dstp, srcptop, row_size);
-                dstp += dst_stride;
-                memcpy(dstp, srcpbtn, row_size);
-                srcpbtn += src_stride;
-                srcptop += src_stride;
-                dstp += dst_stride;
+        if (dst) {
+            vsapi->copyFrameProps(src1, dst, core);
+        } else {
+            dst = vsapi->newVideoFrame(d->vi.format, d->vi.width, d->vi.height, src1, core);
+            const VSFormat *fi = vsapi->getFrameFormat(dst);
+
+            for (int plane = 0; plane < fi->numPlanes; plane++) {
+                const uint8_t *srcptop = vsapi->getReadPtr(srctop, plane);
+                const uint8_t *srcpbtn = vsapi->getReadPtr(srcbtn, plane);
+                int top_stride = vsapi->getStride(srctop, plane);
+                int btn_stride = vsapi->getStride(srcbtn, plane);
+                uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+                int dst_stride = vsapi->getStride(dst, plane);
+                int h = vsapi->getFrameHeight(srctop, plane);
+                size_t row_size = vsapi->getFrameWidth(dst, plane) * fi->bytesPerSample;
+
+                for (int hl = 0; hl < h; hl++) {
+                    memcpy(dstp, srcptop, row_size);
+                    dstp += dst_stride;
+                    memcpy(dstp, srcpbtn, row_size);
+                    srcpbtn += btn_stride;
+                    srcptop += top_stride;
+                    dstp += dst_stride;
+                }
             }
         }
 
+        VSMap *dstprops = vsapi->getFramePropsRW(dst);
+        vsapi->propDeleteKey(dstprops, "_Field");
+        vsapi->propSetInt(dstprops, "_FieldBased", 1 + (srctop == src1), paReplace);
+
         vsapi->freeFrame(src1);
         vsapi->freeFrame(src2);
         return dst;
@@ -912,6 +935,7 @@ static void VS_CC doubleWeaveCreate(const VSMap *in, VSMap *out, void *userData,
     *data = d;
 
     vsapi->createFilter(in, out, "DoubleWeave", doubleWeaveInit, doubleWeaveGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, -1, 1, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -953,6 +977,7 @@ static void VS_CC flipVerticalCreate(const VSMap *in, VSMap *out, void *userData
     *data = d;
 
     vsapi->createFilter(in, out, "FlipVertical", singleClipInit, flipVerticalGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure, -1, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -1053,6 +1078,7 @@ static void VS_CC flipHorizontalCreate(const VSMap *in, VSMap *out, void *userDa
     *data = d;
 
     vsapi->createFilter(in, out, d.flip ? "Turn180" : "FlipHorizontal", singleClipInit, flipHorizontalGetframe, singleClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure, -1, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -1177,6 +1203,7 @@ static void VS_CC stackCreate(const VSMap *in, VSMap *out, void *userData, VSCor
         *data = d;
 
         vsapi->createFilter(in, out, d.vertical ? "StackVertical" : "StackHorizontal", stackInit, stackGetframe, stackFree, fmParallel, 0, data, core);
+        setOutputHints(out, fhPure, -1, 0, 0, vsapi);
     }
 }
 
@@ -1365,6 +1392,7 @@ static void VS_CC blankClipCreate(const VSMap *in, VSMap *out, void *userData, V
     *data = d;
 
     vsapi->createFilter(in, out, "BlankClip", blankClipInit, blankClipGetframe, blankClipFree, d.keep ? fmUnordered : fmParallel, nfNoCache, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -1373,6 +1401,8 @@ static void VS_CC blankClipCreate(const VSMap *in, VSMap *out, void *userData, V
 typedef struct {
     VSNodeRef *node;
     VSVideoInfo vi;
+    int durationNumAtom;
+    int durationDenAtom;
 } AssumeFPSData;
 
 static void VS_CC assumeFPSInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
@@ -1390,8 +1420,8 @@ static const VSFrameRef *VS_CC assumeFPSGetframe(int n, int activationReason, vo
         VSFrameRef *dst = vsapi->copyFrame(src, core);
         VSMap *m = vsapi->getFramePropsRW(dst);
         vsapi->freeFrame(src);
-        vsapi->propSetInt(m, "_DurationNum", d->vi.fpsDen, paReplace);
-        vsapi->propSetInt(m, "_DurationDen", d->vi.fpsNum, paReplace);
+        vsapi->propSetIntAtom(m, d->durationNumAtom, d->vi.fpsDen, paReplace);
+        vsapi->propSetIntAtom(m, d->durationDenAtom, d->vi.fpsNum, paReplace);
         return dst;
     }
 
@@ -1439,11 +1469,14 @@ static void VS_CC assumeFPSCreate(const VSMap *in, VSMap *out, void *userData, V
     }
 
     vs_normalizeRational(&d.vi.fpsNum, &d.vi.fpsDen);
+    d.durationNumAtom = vsapi->propGetAtom("_DurationNum");
+    d.durationDenAtom = vsapi->propGetAtom("_DurationDen");
 
     data = malloc(sizeof(d));
     *data = d;
 
     vsapi->createFilter(in, out, "AssumeFPS", assumeFPSInit, assumeFPSGetframe, singleClipFree, fmParallel, nfNoCache, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, allPlanes, vsapi);
 }
 
 //////////////////////////////////////////
@@ -1815,6 +1848,7 @@ static void VS_CC transposeCreate(const VSMap *in, VSMap *out, void *userData, V
     *data = d;
 
     vsapi->createFilter(in, out, "Transpose", transposeInit, transposeGetFrame, transposeFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure, -1, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -1965,6 +1999,7 @@ static void VS_CC pemVerifierCreate(const VSMap *in, VSMap *out, void *userData,
     *data = d;
 
     vsapi->createFilter(in, out, "PEMVerifier", pemVerifierInit, pemVerifierGetFrame, pemVerifierFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhPassThrough, 0, 0, allPlanes, vsapi);
 }
 
 //////////////////////////////////////////
@@ -1974,14 +2009,40 @@ typedef struct {
     VSNodeRef *node1;
     VSNodeRef *node2;
     const VSVideoInfo *vi;
-    char *propAverage;
-    char *propMin;
-    char *propMax;
-    char *propDiff;
+    int propAverage;
+    int propMin;
+    int propMax;
+    int propDiff;
     int plane;
-    int cpulevel;
+    vs_autotune_func func; // the kernel for one or two clips picked when the filter is created
 } PlaneStatsData;
 
+#define PIXEL_KERNELS(name, isa) { (vs_autotune_func)name##_byte_##isa, (vs_autotune_func)name##_word_##isa, (vs_autotune_func)name##_float_##isa }
+#ifdef VS_TARGET_CPU_X86
+#define KERNEL_TABLE(name) { PIXEL_KERNELS(name, c), PIXEL_KERNELS(name, sse2), PIXEL_KERNELS(name, avx2) }
+#else
+#define KERNEL_TABLE(name) { PIXEL_KERNELS(name, c) }
+#endif
+
+static const vs_autotune_func planeStats1Kernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_plane_stats_1);
+static const vs_autotune_func planeStats2Kernels[VS_AUTOTUNE_NUM_LEVELS][3] = KERNEL_TABLE(vs_plane_stats_2);
+
+#undef KERNEL_TABLE
+#undef PIXEL_KERNELS
+
+typedef void (*plane_stats_1_func)(union vs_plane_stats *, const void *, ptrdiff_t, unsigned, unsigned);
+typedef void (*plane_stats_2_func)(union vs_plane_stats *, const void *, ptrdiff_t, const void *, ptrdiff_t, unsigned, unsigned);
+
+static void planeStats1AutotuneRun(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque) {
+    union vs_plane_stats stats = { 0 };
+    ((plane_stats_1_func)func)(&stats, buffers[0], stride, width, height);
+}
+
+static void planeStats2AutotuneRun(vs_autotune_func func, void * const *buffers, ptrdiff_t stride, unsigned width, unsigned height, void *opaque) {
+    union vs_plane_stats stats = { 0 };
+    ((plane_stats_2_func)func)(&stats, buffers[0], stride, buffers[1], stride, width, height);
+}
+
 static void VS_CC planeStatsInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
     PlaneStatsData *d = (PlaneStatsData *)* instanceData;
     vsapi->setVideoInfo(d->vi, 1, node);
@@ -2007,73 +2068,19 @@ static const VSFrameRef *VS_CC planeStatsGetFrame(int n, int activationReason, v
         if (src2) {
             const void *srcp2 = vsapi->getReadPtr(src2, d->plane);
             ptrdiff_t src2_stride = vsapi->getStride(src2, d->plane);
-            void (*func)(union vs_plane_stats *, const void *, ptrdiff_t, const void *, ptrdiff_t, unsigned, unsigned) = NULL;
-
-#ifdef VS_TARGET_CPU_X86
-            if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_2_byte_avx2; break;
-                case 2: func = vs_plane_stats_2_word_avx2; break;
-                case 4: func = vs_plane_stats_2_float_avx2; break;
-                }
-            }
-            if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_2_byte_sse2; break;
-                case 2: func = vs_plane_stats_2_word_sse2; break;
-                case 4: func = vs_plane_stats_2_float_sse2; break;
-                }
-            }
-#endif
-            if (!func) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_2_byte_c; break;
-                case 2: func = vs_plane_stats_2_word_c; break;
-                case 4: func = vs_plane_stats_2_float_c; break;
-                }
-            }
-
-            if (func)
-                func(&stats, srcp, src_stride, srcp2, src2_stride, width, height);
+            ((plane_stats_2_func)d->func)(&stats, srcp, src_stride, srcp2, src2_stride, width, height);
         } else {
-            void (*func)(union vs_plane_stats *, const void *, ptrdiff_t, unsigned, unsigned) = NULL;
-
-#ifdef VS_TARGET_CPU_X86
-            if (getCPUFeatures()->avx2 && d->cpulevel >= VS_CPU_LEVEL_AVX2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_1_byte_avx2; break;
-                case 2: func = vs_plane_stats_1_word_avx2; break;
-                case 4: func = vs_plane_stats_1_float_avx2; break;
-                }
-            }
-            if (!func && d->cpulevel >= VS_CPU_LEVEL_SSE2) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_1_byte_sse2; break;
-                case 2: func = vs_plane_stats_1_word_sse2; break;
-                case 4: func = vs_plane_stats_1_float_sse2; break;
-                }
-            }
-#endif
-            if (!func) {
-                switch (fi->bytesPerSample) {
-                case 1: func = vs_plane_stats_1_byte_c; break;
-                case 2: func = vs_plane_stats_1_word_c; break;
-                case 4: func = vs_plane_stats_1_float_c; break;
-                }
-            }
-
-            if (func)
-                func(&stats, srcp, src_stride, width, height);
+            ((plane_stats_1_func)d->func)(&stats, srcp, src_stride, width, height);
         }
 
         VSMap *dstProps = vsapi->getFramePropsRW(dst);
 
         if (fi->sampleType == stInteger) {
-            vsapi->propSetInt(dstProps, d->propMin, stats.i.min, paReplace);
-            vsapi->propSetInt(dstProps, d->propMax, stats.i.max, paReplace);
+            vsapi->propSetIntAtom(dstProps, d->propMin, stats.i.min, paReplace);
+            vsapi->propSetIntAtom(dstProps, d->propMax, stats.i.max, paReplace);
         } else {
-            vsapi->propSetFloat(dstProps, d->propMin, stats.f.min, paReplace);
-            vsapi->propSetFloat(dstProps, d->propMax, stats.f.max, paReplace);
+            vsapi->propSetFloatAtom(dstProps, d->propMin, stats.f.min, paReplace);
+            vsapi->propSetFloatAtom(dstProps, d->propMax, stats.f.max, paReplace);
         }
 
         double avg = 0.0;
@@ -2088,9 +2095,9 @@ static const VSFrameRef *VS_CC planeStatsGetFrame(int n, int activationReason, v
                 diff = stats.f.diffacc / (double)((int64_t)width * height);
         }
 
-        vsapi->propSetFloat(dstProps, d->propAverage, avg, paReplace);
+        vsapi->propSetFloatAtom(dstProps, d->propAverage, avg, paReplace);
         if (d->node2)
-            vsapi->propSetFloat(dstProps, d->propDiff, diff, paReplace);
+            vsapi->propSetFloatAtom(dstProps, d->propDiff, diff, paReplace);
 
         vsapi->freeFrame(src1);
         vsapi->freeFrame(src2);
@@ -2103,10 +2110,6 @@ static void VS_CC planeStatsFree(void *instanceData, VSCore *core, const VSAPI *
     PlaneStatsData *d = (PlaneStatsData *)instanceData;
     vsapi->freeNode(d->node1);
     vsapi->freeNode(d->node2);
-    free(d->propAverage);
-    free(d->propMin);
-    free(d->propMax);
-    free(d->propDiff);
     free(d);
 }
 
@@ -2143,24 +2146,40 @@ static void VS_CC planeStatsCreate(const VSMap *in, VSMap *out, void *userData,
     if (err)
         tempprop = "PlaneStats";
     size_t l = strlen(tempprop);
-    d.propMin = malloc(l + 3 + 1);
-    d.propMax = malloc(l + 3 + 1);
-    d.propAverage = malloc(l + 7 + 1);
-    d.propDiff = malloc(l + 4 + 1);
-    strcpy(d.propMin, tempprop);
-    strcpy(d.propMax, tempprop);
-    strcpy(d.propAverage, tempprop);
-    strcpy(d.propDiff, tempprop);
-    strcpy(d.propMin + l, "Min");
-    strcpy(d.propMax + l, "Max");
-    strcpy(d.propAverage + l, "Average");
-    strcpy(d.propDiff + l, "Diff");
-    d.cpulevel = vs_get_cpulevel(core);
+    char *propName = malloc(l + 7 + 1);
+    strcpy(propName, tempprop);
+    strcpy(propName + l, "Min");
+    d.propMin = vsapi->propGetAtom(propName);
+    strcpy(propName + l, "Max");
+    d.propMax = vsapi->propGetAtom(propName);
+    strcpy(propName + l, "Average");
+    d.propAverage = vsapi->propGetAtom(propName);
+    strcpy(propName + l, "Diff");
+    d.propDiff = vsapi->propGetAtom(propName);
+    free(propName);
+
+    if (d.propMin < 0) {
+        vsapi->freeNode(d.node1);
+        vsapi->freeNode(d.node2);
+        RETERROR("PlaneStats: prop must be a valid property name");
+    }
+
+    // clips with varying dimensions get the kernel of the highest cpu level since there's no size to tune it for
+    int pixel = vs_autotune_pixel(d.vi->format->bytesPerSample);
+    int cpulevel = vs_get_cpulevel(core);
+    int autotune = isConstantFormat(d.vi) && vs_get_autotune(core);
+    unsigned width = autotune ? planeWidth(d.vi, d.plane) : 0;
+    unsigned height = autotune ? planeHeight(d.vi, d.plane) : 0;
+    if (d.node2)
+        d.func = vs_autotune_dispatch("PlaneStats2", planeStats2Kernels, pixel, cpulevel, autotune, width, height, 2, planeStats2AutotuneRun, NULL);
+    else
+        d.func = vs_autotune_dispatch("PlaneStats", planeStats1Kernels, pixel, cpulevel, autotune, width, height, 1, planeStats1AutotuneRun, NULL);
 
     data = malloc(sizeof(d));
     *data = d;
 
     vsapi->createFilter(in, out, "PlaneStats", planeStatsInit, planeStatsGetFrame, planeStatsFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure, -1, 0, allPlanes, vsapi);
 }
 
 //////////////////////////////////////////
@@ -2230,6 +2249,7 @@ static void VS_CC clipToPropCreate(const VSMap *in, VSMap *out, void *userData,
     *data = d;
 
     vsapi->createFilter(in, out, "ClipToProp", clipToPropInit, clipToPropGetFrame, clipToPropFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, allPlanes, vsapi);
 }
 
 //////////////////////////////////////////
@@ -2327,6 +2347,7 @@ static void VS_CC propToClipCreate(const VSMap *in, VSMap *out, void *userData,
     *data = d;
 
     vsapi->createFilter(in, out, "PropToClip", propToClipInit, propToClipGetFrame, propToClipFree, fmParallel, 0, data, core);
+    setOutputHints(out, fhPure | fhCheap, -1, 0, 0, vsapi);
 }
 
 //////////////////////////////////////////
@@ -2459,6 +2480,7 @@ static void VS_CC setFramePropCreate(const VSMap *in, VSMap *out, void *userData
     *data = d;
 
     vsapi->createFilter(in, out, "SetFrameProp", setFramePropInit, setFramePropGetFrame, setFramePropFree, fmParallel, nfNoCache, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, allPlanes, vsapi);
 }
 
 //////////////////////////////////////////
@@ -2504,6 +2526,7 @@ static void VS_CC setFieldBasedCreate(const VSMap *in, VSMap *out, void *userDat
     *data = d;
 
     vsapi->createFilter(in, out, "SetFieldBased", singleClipInit, setFieldBasedGetFrame, singleClipFree, fmParallel, nfNoCache, data, core);
+    setOutputHints(out, fhPure | fhCheap, 0, 0, allPlanes, vsapi);
 }
 
 static void VS_CC setMaxCpu(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
@@ -2514,6 +2537,17 @@ static void VS_CC setMaxCpu(const VSMap *in, VSMap *out, void *userData, VSCore
     vsapi->propSetData(out, "cpu", str, (int)strlen(str), paReplace);
 }
 
+static void VS_CC setAutotune(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+    int err;
+    int enable = int64ToIntS(vsapi->propGetInt(in, "enable", 0, &err));
+    if (err)
+        enable = -1;
+    const char *profile = vsapi->propGetData(in, "profile", 0, &err);
+    if (profile && !vs_autotune_set_profile(profile))
+        RETERROR("SetAutotune: profile isn't an autotune profile file");
+    vsapi->propSetInt(out, "enable", vs_set_autotune(core, enable), paReplace);
+}
+
 //////////////////////////////////////////
 // Init
 
@@ -2543,4 +2577,5 @@ void VS_CC stdlibInitialize(VSConfigPlugin configFunc, VSRegisterFunction regist
     registerFunc("SetFrameProp", "clip:clip;prop:data;delete:int:opt;intval:int[]:opt;floatval:float[]:opt;data:data[]:opt;", setFramePropCreate, 0, plugin);
     registerFunc("SetFieldBased", "clip:clip;value:int;", setFieldBasedCreate, 0, plugin);
     registerFunc("SetMaxCPU", "cpu:data;", setMaxCpu, 0, plugin);
+    registerFunc("SetAutotune", "enable:int:opt;profile:data:opt;", setAutotune, 0, plugin);
 }
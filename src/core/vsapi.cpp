@@ -21,6 +21,7 @@
 #include "vscore.h"
 #include "cpufeatures.h"
 #include "vslog.h"
+#include "graphfile.h"
 #include <cassert>
 #include <cstring>
 #include <string>
@@ -247,15 +248,10 @@ static const char *VS_CC propGetKey(const VSMap *map, int index) VS_NOEXCEPT {
     return map->key(index);
 }
 
-static int propNumElementsInternal(const VSMap *map, const std::string &key) VS_NOEXCEPT {
-    VSVariant *val = map->find(key);
-    return val ? val->size() : -1;
-}
-
-
 static int VS_CC propNumElements(const VSMap *map, const char *key) VS_NOEXCEPT {
     assert(map && key);
-    return propNumElementsInternal(map, key);
+    VSVariant *val = map->find(key);
+    return val ? val->size() : -1;
 }
 
 static char VS_CC propGetType(const VSMap *map, const char *key) VS_NOEXCEPT {
@@ -265,12 +261,17 @@ static char VS_CC propGetType(const VSMap *map, const char *key) VS_NOEXCEPT {
     return val ? a[val->getType()] : 'u';
 }
 
-#define PROP_GET_SHARED(vt, retexpr) \
-    assert(map && key); \
+static int checkAtom(int atom) {
+    if (!KeyAtoms::isValid(atom))
+        vsFatal("Invalid key atom %d passed", atom);
+    return atom;
+}
+
+#define PROP_GET_SHARED_INTERNAL(lookup, keyname, vt, retexpr) \
     if (map->hasError()) \
-        vsFatal("Attempted to read key '%s' from a map with error set: %s", key, map->getErrorMessage().c_str()); \
+        vsFatal("Attempted to read key '%s' from a map with error set: %s", keyname, map->getErrorMessage().c_str()); \
     int err = 0; \
-    VSVariant *l = map->find(key); \
+    VSVariant *l = (lookup); \
     if (l && l->getType() == (vt)) { \
         if (index >= 0 && static_cast<size_t>(index) < l->size()) { \
             if (error) \
@@ -285,10 +286,18 @@ static char VS_CC propGetType(const VSMap *map, const char *key) VS_NOEXCEPT {
         err = peUnset; \
     } \
     if (!error) \
-        vsFatal("Property read unsuccessful but no error output: %s", key); \
+        vsFatal("Property read unsuccessful but no error output: %s", keyname); \
     *error = err; \
     return 0;
 
+#define PROP_GET_SHARED(vt, retexpr) \
+    assert(map && key); \
+    PROP_GET_SHARED_INTERNAL(map->find(key), key, vt, retexpr)
+
+#define PROP_GET_SHARED_ATOM(vt, retexpr) \
+    assert(map); \
+    PROP_GET_SHARED_INTERNAL(map->find(checkAtom(atom)), KeyAtoms::name(atom).c_str(), vt, retexpr)
+
 static int64_t VS_CC propGetInt(const VSMap *map, const char *key, int index, int *error) VS_NOEXCEPT {
     PROP_GET_SHARED(VSVariant::vInt, l->getValue<int64_t>(index))
 }
@@ -326,29 +335,19 @@ static inline bool isAlphaNumUnderscore(char c) {
     return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
 }
 
-static bool isValidVSMapKey(const std::string &s) {
-    size_t len = s.length();
-    if (!len)
-        return false;
-
+static bool isValidVSMapKey(const char *s) {
     if (!isAlphaUnderscore(s[0]))
         return false;
-    for (size_t i = 1; i < len; i++)
+    for (size_t i = 1; s[i]; i++)
         if (!isAlphaNumUnderscore(s[i]))
             return false;
     return true;
 }
 
-#define PROP_SET_SHARED(vv, appendexpr) \
-    assert(map && key); \
-    if (append != paReplace && append != paAppend && append != paTouch) \
-        vsFatal("Invalid prop append mode given when setting key '%s'", key); \
-    std::string skey = key; \
-    if (!isValidVSMapKey(skey)) \
-        return 1; \
-    if (append != paReplace && map->contains(skey)) { \
+#define PROP_SET_SHARED_INTERNAL(vv, keyexpr, appendexpr) \
+    if (append != paReplace && map->contains(keyexpr)) { \
         map->detach(); \
-        VSVariant &l = map->at(skey); \
+        VSVariant &l = map->at(keyexpr); \
         if (l.getType() != (vv)) { \
             return 1; \
         } else if (append == paAppend) { \
@@ -358,11 +357,25 @@ static bool isValidVSMapKey(const std::string &s) {
         VSVariant l((vv)); \
         if (append != paTouch) \
             l.append(appendexpr); \
-        map->detach(); \
-        map->insert(skey, std::move(l)); \
+        map->insert(keyexpr, std::move(l)); \
     } \
     return 0;
 
+#define PROP_SET_SHARED(vv, appendexpr) \
+    assert(map && key); \
+    if (append != paReplace && append != paAppend && append != paTouch) \
+        vsFatal("Invalid prop append mode given when setting key '%s'", key); \
+    if (!isValidVSMapKey(key)) \
+        return 1; \
+    PROP_SET_SHARED_INTERNAL(vv, key, appendexpr)
+
+#define PROP_SET_SHARED_ATOM(vv, appendexpr) \
+    assert(map); \
+    checkAtom(atom); \
+    if (append != paReplace && append != paAppend && append != paTouch) \
+        vsFatal("Invalid prop append mode given when setting key '%s'", KeyAtoms::name(atom).c_str()); \
+    PROP_SET_SHARED_INTERNAL(vv, atom, appendexpr)
+
 
 static int VS_CC propSetInt(VSMap *map, const char *key, int64_t i, int append) VS_NOEXCEPT {
     PROP_SET_SHARED(VSVariant::vInt, i)
@@ -517,12 +530,11 @@ static int VS_CC propSetIntArray(VSMap *map, const char *key, const int64_t *i,
     assert(map && key && size >= 0);
     if (size < 0)
         return 1;
-    std::string skey = key;
-    if (!isValidVSMapKey(skey))
+    if (!isValidVSMapKey(key))
         return 1;
     VSVariant l(VSVariant::vInt);
     l.setArray(i, size);
-    map->insert(skey, std::move(l));
+    map->insert(key, std::move(l));
     return 0;
 }
 
@@ -530,12 +542,11 @@ static int VS_CC propSetFloatArray(VSMap *map, const char *key, const double *d,
     assert(map && key && size >= 0);
     if (size < 0)
         return 1;
-    std::string skey = key;
-    if (!isValidVSMapKey(skey))
+    if (!isValidVSMapKey(key))
         return 1;
     VSVariant l(VSVariant::vFloat);
     l.setArray(d, size);
-    map->insert(skey, std::move(l));
+    map->insert(key, std::move(l));
     return 0;
 }
 
@@ -556,6 +567,217 @@ static void VS_CC getCoreInfo2(VSCore *core, VSCoreInfo *info) VS_NOEXCEPT {
     core->getCoreInfo2(*info);
 }
 
+static void VS_CC prefetch(VSNodeRef *node, int first, int last, int priority) VS_NOEXCEPT {
+    assert(node);
+    node->clip->prefetch(node, first, last, priority);
+}
+
+static int VS_CC setLargePages(int enable, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->memory->setLargePageEnabled(enable);
+}
+
+static void VS_CC getNodeMemoryInfo(VSNodeRef *node, VSNodeMemoryInfo *info) VS_NOEXCEPT {
+    assert(node && info);
+    node->clip->getMemoryInfo(*info);
+}
+
+static void *VS_CC allocScratch(size_t bytes, VSFrameContext *frameCtx) VS_NOEXCEPT {
+    assert(frameCtx);
+    return ScratchArena::alloc(bytes);
+}
+
+static VSFrameRef *VS_CC getFrameFilterForModify(int n, VSNodeRef *clip, VSFrameContext *frameCtx) VS_NOEXCEPT {
+    assert(clip && frameCtx);
+
+    int numFrames = clip->clip->getVideoInfo(clip->index).numFrames;
+    if (numFrames && n >= numFrames)
+        n = numFrames - 1;
+    auto ref = frameCtx->ctx->availableFrames.find(NodeOutputKey(clip->clip.get(), n, clip->index));
+    if (ref == frameCtx->ctx->availableFrames.end())
+        return nullptr;
+
+    PVideoFrame f = std::move(ref->second);
+    frameCtx->ctx->availableFrames.erase(ref);
+    if (clip->clip->releaseFrameForModify(n, f))
+        return new VSFrameRef(std::move(f));
+    // someone else may still read it so make a copy, the planes are copied on write
+    return new VSFrameRef(std::make_shared<VSFrame>(*f));
+}
+
+static VSFrameRef *VS_CC cropFrameView(const VSFrameRef *f, int left, int top, int width, int height, VSCore *core) VS_NOEXCEPT {
+    assert(f && core);
+    const VSFormat *fi = f->frame->getFormat();
+    if (left < 0 || top < 0 || width <= 0 || height <= 0 || left + width > f->frame->getWidth(0) || top + height > f->frame->getHeight(0))
+        vsFatal("cropFrameView: the cropped area %dx%d at %d,%d is outside the %dx%d frame", width, height, left, top, f->frame->getWidth(0), f->frame->getHeight(0));
+    if ((left | width) % (1 << fi->subSamplingW) || (top | height) % (1 << fi->subSamplingH))
+        vsFatal("cropFrameView: the cropped area has to be a multiple of the subsampling");
+    PVideoFrame view = VSFrame::cropView(f->frame, left, top, width, height);
+    return view ? new VSFrameRef(std::move(view)) : nullptr;
+}
+
+static VSFrameRef *VS_CC fieldFrameView(const VSFrameRef *f, int field, VSCore *core) VS_NOEXCEPT {
+    assert(f && core);
+    if (field != 0 && field != 1)
+        vsFatal("fieldFrameView: field must be 0 or 1, passed %d", field);
+    if (f->frame->getHeight(0) % (2 << f->frame->getFormat()->subSamplingH))
+        vsFatal("fieldFrameView: frame height must be mod 2 in the smallest subsampled plane");
+    return new VSFrameRef(VSFrame::fieldView(f->frame, field));
+}
+
+static VSFrameRef *VS_CC weaveFrameViews(const VSFrameRef *top, const VSFrameRef *bottom, VSCore *core) VS_NOEXCEPT {
+    assert(top && bottom && core);
+    PVideoFrame view = VSFrame::weaveViews(top->frame, bottom->frame);
+    return view ? new VSFrameRef(std::move(view)) : nullptr;
+}
+
+static int VS_CC setMemoryLimitEnforced(int enforce, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->memory->setLimitEnforced(enforce);
+}
+
+static void VS_CC getMemoryLimitInfo(VSCore *core, VSMemoryLimitInfo *info) VS_NOEXCEPT {
+    assert(core && info);
+    core->getMemoryLimitInfo(*info);
+}
+
+static int VS_CC propGetAtom(const char *key) VS_NOEXCEPT {
+    assert(key);
+    if (!isValidVSMapKey(key))
+        return -1;
+    return KeyAtoms::intern(key);
+}
+
+static int VS_CC propNumElementsAtom(const VSMap *map, int atom) VS_NOEXCEPT {
+    assert(map);
+    VSVariant *val = map->find(checkAtom(atom));
+    return val ? val->size() : -1;
+}
+
+static int64_t VS_CC propGetIntAtom(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT {
+    PROP_GET_SHARED_ATOM(VSVariant::vInt, l->getValue<int64_t>(index))
+}
+
+static double VS_CC propGetFloatAtom(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT {
+    PROP_GET_SHARED_ATOM(VSVariant::vFloat, l->getValue<double>(index))
+}
+
+static const char *VS_CC propGetDataAtom(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT {
+    PROP_GET_SHARED_ATOM(VSVariant::vData, l->getValue<VSMapData>(index)->c_str())
+}
+
+static int VS_CC propGetDataSizeAtom(const VSMap *map, int atom, int index, int *error) VS_NOEXCEPT {
+    PROP_GET_SHARED_ATOM(VSVariant::vData, static_cast<int>(l->getValue<VSMapData>(index)->size()))
+}
+
+static int VS_CC propSetIntAtom(VSMap *map, int atom, int64_t i, int append) VS_NOEXCEPT {
+    PROP_SET_SHARED_ATOM(VSVariant::vInt, i)
+}
+
+static int VS_CC propSetFloatAtom(VSMap *map, int atom, double d, int append) VS_NOEXCEPT {
+    PROP_SET_SHARED_ATOM(VSVariant::vFloat, d)
+}
+
+static int VS_CC propSetDataAtom(VSMap *map, int atom, const char *d, int length, int append) VS_NOEXCEPT {
+    PROP_SET_SHARED_ATOM(VSVariant::vData, length >= 0 ? std::string(d, length) : std::string(d))
+}
+
+static int VS_CC propDeleteKeyAtom(VSMap *map, int atom) VS_NOEXCEPT {
+    assert(map);
+    return map->erase(checkAtom(atom));
+}
+
+static void VS_CC getNodeInfo(VSNodeRef *node, VSNodeInfo *info) VS_NOEXCEPT {
+    assert(node && info);
+    node->clip->getNodeInfo(*info);
+}
+
+static VSNodeRef *VS_CC getNodeInput(VSNodeRef *node, int index) VS_NOEXCEPT {
+    assert(node);
+    return node->clip->getInput(index);
+}
+
+static VSMap *VS_CC getNodeGraph(VSNodeRef *node) VS_NOEXCEPT {
+    assert(node);
+    // depth first so every node comes after all its inputs
+    VSMap *map = new VSMap();
+    std::set<VSNode *> visited;
+    std::vector<std::pair<VSNodeRef *, int>> stack;
+    visited.insert(node->clip.get());
+    stack.push_back(std::make_pair(new VSNodeRef(node->clip, 0), 0));
+    while (!stack.empty()) {
+        VSNodeRef *current = stack.back().first;
+        int input = stack.back().second++;
+        VSNodeInfo info;
+        current->clip->getNodeInfo(info);
+        if (input < info.numInputs) {
+            VSNodeRef *ref = current->clip->getInput(input);
+            if (ref && visited.insert(ref->clip.get()).second) {
+                ref->index = 0;
+                stack.push_back(std::make_pair(ref, 0));
+            } else {
+                delete ref;
+            }
+        } else {
+            propSetNode(map, "nodes", current, paAppend);
+            delete current;
+            stack.pop_back();
+        }
+    }
+    return map;
+}
+
+static VSMap *VS_CC saveGraph(const VSMap *clips, const char *filename) VS_NOEXCEPT {
+    assert(clips && filename);
+    VSMap *map = new VSMap();
+    ::saveGraph(*clips, filename, *map);
+    return map;
+}
+
+static VSMap *VS_CC loadGraph(const char *filename, VSCore *core) VS_NOEXCEPT {
+    assert(filename && core);
+    VSMap *map = new VSMap();
+    ::loadGraph(filename, core, *map);
+    return map;
+}
+
+static int VS_CC setGraphRecording(int enable, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->setGraphRecording(enable);
+}
+
+static int VS_CC setProfiling(int enable, VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    return core->setProfiling(enable);
+}
+
+static VSMap *VS_CC getProfile(VSCore *core, int reset) VS_NOEXCEPT {
+    assert(core);
+    VSMap *map = new VSMap();
+    core->getProfile(*map, !!reset);
+    return map;
+}
+
+static void VS_CC startTrace(VSCore *core) VS_NOEXCEPT {
+    assert(core);
+    core->tracer.start();
+}
+
+static int VS_CC stopTrace(VSCore *core, const char *filename) VS_NOEXCEPT {
+    assert(core && filename);
+    return core->tracer.stop(filename);
+}
+
+static void VS_CC getCoreStats(VSCore *core, VSMap *stats) VS_NOEXCEPT {
+    assert(core && stats);
+    core->getStats(*stats);
+}
+
+static void VS_CC setFilterHints(VSNodeRef *node, const VSFilterHints *hints) VS_NOEXCEPT {
+    assert(node && hints);
+    node->clip->setHints(*hints);
+}
+
 
 
 const VSAPI vs_internal_vsapi = {
@@ -648,7 +870,40 @@ const VSAPI vs_internal_vsapi = {
     &logMessage,
     &addMessageHandler,
     &removeMessageHandler,
-    &getCoreInfo2
+    &getCoreInfo2,
+
+    &prefetch,
+    &setLargePages,
+    &getNodeMemoryInfo,
+    &allocScratch,
+    &getFrameFilterForModify,
+    &cropFrameView,
+    &fieldFrameView,
+    &weaveFrameViews,
+    &setMemoryLimitEnforced,
+    &getMemoryLimitInfo,
+    &propGetAtom,
+    &propNumElementsAtom,
+    &propGetIntAtom,
+    &propGetFloatAtom,
+    &propGetDataAtom,
+    &propGetDataSizeAtom,
+    &propSetIntAtom,
+    &propSetFloatAtom,
+    &propSetDataAtom,
+    &propDeleteKeyAtom,
+    &getNodeInfo,
+    &getNodeInput,
+    &getNodeGraph,
+    &setFilterHints,
+    &saveGraph,
+    &loadGraph,
+    &setProfiling,
+    &getProfile,
+    &startTrace,
+    &stopTrace,
+    &getCoreStats,
+    &setGraphRecording
 };
 
 ///////////////////////////////
@@ -22,13 +22,18 @@
 #include "VSHelper.h"
 #include "version.h"
 #include "cpufeatures.h"
+#include "plugincache.h"
+#include "vsprobes.h"
 #ifndef VS_TARGET_OS_WINDOWS
 #include <dirent.h>
 #include <cstddef>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <cstdio>
 #include "settings.h"
 #endif
 #include <cassert>
+#include <chrono>
 #include <queue>
 
 #ifdef VS_TARGET_CPU_X86
@@ -124,53 +129,145 @@ void ExtFunction::call(const VSMap *in, VSMap *out) {
 
 ///////////////
 
-VSVariant::VSVariant(VSVType vtype) : vtype(vtype), internalSize(0), storage(nullptr) {
-}
-
-VSVariant::VSVariant(const VSVariant &v) : vtype(v.vtype), internalSize(v.internalSize), storage(nullptr) {
-    if (internalSize) {
-        switch (vtype) {
-        case VSVariant::vInt:
-            storage = new IntList(*reinterpret_cast<IntList *>(v.storage)); break;
-        case VSVariant::vFloat:
-            storage = new FloatList(*reinterpret_cast<FloatList *>(v.storage)); break;
-        case VSVariant::vData:
-            storage = new DataList(*reinterpret_cast<DataList *>(v.storage)); break;
-        case VSVariant::vNode:
-            storage = new NodeList(*reinterpret_cast<NodeList *>(v.storage)); break;
-        case VSVariant::vFrame:
-            storage = new FrameList(*reinterpret_cast<FrameList *>(v.storage)); break;
-        case VSVariant::vMethod:
-            storage = new FuncList(*reinterpret_cast<FuncList *>(v.storage)); break;
-        default:;
-        }
+namespace {
+
+struct KeyAtom {
+    std::string name;
+    size_t hash;
+    int atom;
+    KeyAtom *next;
+};
+
+// Atoms are looked up in a fixed size hash table where entries are only ever prepended to the bucket lists,
+// this way readers can walk the lists without a lock while new keys are added
+const size_t numKeyBuckets = 1024;
+const size_t keyChunkSize = 1024;
+const size_t maxKeyChunks = 4096;
+
+std::atomic<KeyAtom *> keyBuckets[numKeyBuckets];
+std::atomic<KeyAtom **> keyChunks[maxKeyChunks];
+std::atomic<int> numKeyAtoms;
+std::mutex keyAtomLock;
+
+size_t hashKey(const char *key) {
+    // FNV-1a
+    size_t hash = static_cast<size_t>(14695981039346656037ULL);
+    for (; *key; key++) {
+        hash ^= static_cast<unsigned char>(*key);
+        hash *= static_cast<size_t>(1099511628211ULL);
     }
+    return hash;
+}
+
+KeyAtom *findKeyAtom(const char *key, size_t hash) {
+    for (KeyAtom *entry = keyBuckets[hash % numKeyBuckets].load(std::memory_order_acquire); entry; entry = entry->next) {
+        if (entry->hash == hash && entry->name == key)
+            return entry;
+    }
+    return nullptr;
+}
+
+}
+
+int KeyAtoms::find(const char *key) {
+    KeyAtom *entry = findKeyAtom(key, hashKey(key));
+    return entry ? entry->atom : -1;
+}
+
+int KeyAtoms::intern(const char *key) {
+    size_t hash = hashKey(key);
+    KeyAtom *entry = findKeyAtom(key, hash);
+    if (entry)
+        return entry->atom;
+
+    std::lock_guard<std::mutex> lock(keyAtomLock);
+    // another thread may have added it in the meantime
+    entry = findKeyAtom(key, hash);
+    if (entry)
+        return entry->atom;
+
+    int atom = numKeyAtoms;
+    size_t chunk = atom / keyChunkSize;
+    if (chunk >= maxKeyChunks) {
+        static bool warned = false;
+        if (!warned)
+            vsWarning("Too many different map keys used, new keys will be stored without atoms");
+        warned = true;
+        return -1;
+    }
+    KeyAtom **entries = keyChunks[chunk];
+    if (!entries) {
+        entries = new KeyAtom *[keyChunkSize];
+        keyChunks[chunk].store(entries, std::memory_order_release);
+    }
+
+    std::atomic<KeyAtom *> &bucket = keyBuckets[hash % numKeyBuckets];
+    entry = new KeyAtom{ key, hash, atom, bucket.load(std::memory_order_relaxed) };
+    entries[atom % keyChunkSize] = entry;
+    numKeyAtoms.store(atom + 1, std::memory_order_release);
+    bucket.store(entry, std::memory_order_release);
+    return atom;
+}
+
+bool KeyAtoms::isValid(int atom) {
+    return atom >= 0 && atom < numKeyAtoms.load(std::memory_order_acquire);
+}
+
+const std::string &KeyAtoms::name(int atom) {
+    assert(isValid(atom));
+    return keyChunks[atom / keyChunkSize].load(std::memory_order_acquire)[atom % keyChunkSize]->name;
+}
+
+///////////////
+
+VSVariant::VSVariant(VSVType vtype) : vtype(vtype), internalSize(0), list(nullptr) {
 }
 
-VSVariant::VSVariant(VSVariant &&v) : vtype(v.vtype), internalSize(v.internalSize), storage(v.storage) {
+VSVariant::VSVariant(const VSVariant &v) : vtype(v.vtype), internalSize(v.internalSize), intValue(v.intValue) {
+    if (hasList())
+        ++list->refCount;
+}
+
+VSVariant::VSVariant(VSVariant &&v) noexcept : vtype(v.vtype), internalSize(v.internalSize), intValue(v.intValue) {
     v.vtype = vUnset;
-    v.storage = nullptr;
     v.internalSize = 0;
 }
 
 VSVariant::~VSVariant() {
-    if (storage) {
-        switch (vtype) {
-        case VSVariant::vInt:
-            delete reinterpret_cast<IntList *>(storage); break;
-        case VSVariant::vFloat:
-            delete reinterpret_cast<FloatList *>(storage); break;
-        case VSVariant::vData:
-            delete reinterpret_cast<DataList *>(storage); break;
-        case VSVariant::vNode:
-            delete reinterpret_cast<NodeList *>(storage); break;
-        case VSVariant::vFrame:
-            delete reinterpret_cast<FrameList *>(storage); break;
-        case VSVariant::vMethod:
-            delete reinterpret_cast<FuncList *>(storage); break;
-        default:;
-        }
+    releaseList();
+}
+
+VSVariant &VSVariant::operator=(const VSVariant &v) {
+    if (v.hasList())
+        ++v.list->refCount;
+    releaseList();
+    vtype = v.vtype;
+    internalSize = v.internalSize;
+    intValue = v.intValue;
+    return *this;
+}
+
+VSVariant &VSVariant::operator=(VSVariant &&v) noexcept {
+    if (this != &v) {
+        releaseList();
+        vtype = v.vtype;
+        internalSize = v.internalSize;
+        intValue = v.intValue;
+        v.vtype = vUnset;
+        v.internalSize = 0;
     }
+    return *this;
+}
+
+bool VSVariant::hasList() const {
+    if (vtype == vInt || vtype == vFloat)
+        return internalSize > 1;
+    return internalSize > 0;
+}
+
+void VSVariant::releaseList() {
+    if (hasList() && !--list->refCount)
+        delete list;
 }
 
 size_t VSVariant::size() const {
@@ -181,62 +278,172 @@ VSVariant::VSVType VSVariant::getType() const {
     return vtype;
 }
 
+template<typename T>
+std::vector<T> &VSVariant::writableValues() {
+    if (!hasList()) {
+        list = new VSVariantList<T>();
+    } else if (list->refCount > 1) {
+        VSVariantListBase *copy = list->clone();
+        releaseList();
+        list = copy;
+    }
+    return static_cast<VSVariantList<T> *>(list)->values;
+}
+
+template<typename T>
+void VSVariant::appendValue(VSVType t, const T &val) {
+    assert(vtype == vUnset || vtype == t);
+    vtype = t;
+    writableValues<T>().push_back(val);
+    internalSize++;
+}
+
 void VSVariant::append(int64_t val) {
-    initStorage(vInt);
-    reinterpret_cast<IntList *>(storage)->push_back(val);
+    assert(vtype == vUnset || vtype == vInt);
+    vtype = vInt;
+    if (internalSize == 0) {
+        intValue = val;
+    } else if (internalSize == 1) {
+        VSVariantList<int64_t> *l = new VSVariantList<int64_t>();
+        l->values.push_back(intValue);
+        l->values.push_back(val);
+        list = l;
+    } else {
+        writableValues<int64_t>().push_back(val);
+    }
     internalSize++;
 }
 
 void VSVariant::append(double val) {
-    initStorage(vFloat);
-    reinterpret_cast<FloatList *>(storage)->push_back(val);
+    assert(vtype == vUnset || vtype == vFloat);
+    vtype = vFloat;
+    if (internalSize == 0) {
+        floatValue = val;
+    } else if (internalSize == 1) {
+        VSVariantList<double> *l = new VSVariantList<double>();
+        l->values.push_back(floatValue);
+        l->values.push_back(val);
+        list = l;
+    } else {
+        writableValues<double>().push_back(val);
+    }
     internalSize++;
 }
 
 void VSVariant::append(const std::string &val) {
-    initStorage(vData);
-    reinterpret_cast<DataList *>(storage)->push_back(std::make_shared<std::string>(val));
-    internalSize++;
+    appendValue(vData, std::make_shared<std::string>(val));
 }
 
 void VSVariant::append(const VSNodeRef &val) {
-    initStorage(vNode);
-    reinterpret_cast<NodeList *>(storage)->push_back(val);
-    internalSize++;
+    appendValue(vNode, val);
 }
 
 void VSVariant::append(const PVideoFrame &val) {
-    initStorage(vFrame);
-    reinterpret_cast<FrameList *>(storage)->push_back(val);
-    internalSize++;
+    appendValue(vFrame, val);
 }
 
 void VSVariant::append(const PExtFunction &val) {
-    initStorage(vMethod);
-    reinterpret_cast<FuncList *>(storage)->push_back(val);
-    internalSize++;
+    appendValue(vMethod, val);
 }
 
-void VSVariant::initStorage(VSVType t) {
-    assert(vtype == vUnset || vtype == t);
-    vtype = t;
-    if (!storage) {
-        switch (t) {
-        case VSVariant::vInt:
-            storage = new IntList(); break;
-        case VSVariant::vFloat:
-            storage = new FloatList(); break;
-        case VSVariant::vData:
-            storage = new DataList(); break;
-        case VSVariant::vNode:
-            storage = new NodeList(); break;
-        case VSVariant::vFrame:
-            storage = new FrameList(); break;
-        case VSVariant::vMethod:
-            storage = new FuncList(); break;
-        default:;
-        }
+void VSVariant::setArray(const int64_t *val, size_t size) {
+    assert(val && vtype == vInt && !internalSize);
+    if (size == 1) {
+        intValue = *val;
+    } else if (size > 1) {
+        VSVariantList<int64_t> *l = new VSVariantList<int64_t>();
+        l->values.assign(val, val + size);
+        list = l;
     }
+    internalSize = size;
+}
+
+void VSVariant::setArray(const double *val, size_t size) {
+    assert(val && vtype == vFloat && !internalSize);
+    if (size == 1) {
+        floatValue = *val;
+    } else if (size > 1) {
+        VSVariantList<double> *l = new VSVariantList<double>();
+        l->values.assign(val, val + size);
+        list = l;
+    }
+    internalSize = size;
+}
+
+///////////////
+
+size_t VSMap::lowerBound(const std::string &name) const {
+    auto iter = std::lower_bound(data->data.begin(), data->data.end(), name, [](const VSMapEntry &e, const std::string &name) {
+        return e.first.name() < name;
+    });
+    return iter - data->data.begin();
+}
+
+int VSMap::indexOf(int key) const {
+    if (key < 0)
+        return -1;
+    const std::vector<VSMapEntry> &d = data->data;
+    if (d.size() <= linearSearchSize) {
+        for (size_t i = 0; i < d.size(); i++)
+            if (d[i].first.getAtom() == key)
+                return static_cast<int>(i);
+        return -1;
+    }
+    size_t i = lowerBound(KeyAtoms::name(key));
+    return (i < d.size() && d[i].first.getAtom() == key) ? static_cast<int>(i) : -1;
+}
+
+int VSMap::indexOf(const char *key) const {
+    int atom = KeyAtoms::find(key);
+    if (atom >= 0)
+        return indexOf(atom);
+    // keys that never got an atom can only be stored by name
+    const std::vector<VSMapEntry> &d = data->data;
+    size_t i = lowerBound(key);
+    return (i < d.size() && d[i].first.getAtom() < 0 && d[i].first.name() == key) ? static_cast<int>(i) : -1;
+}
+
+void VSMap::insertEntry(int index, VSMapKey &&key, VSVariant &&v) {
+    detach();
+    if (index >= 0) {
+        data->data[index].second = std::move(v);
+    } else {
+        size_t i = lowerBound(key.name());
+        data->data.insert(data->data.begin() + i, VSMapEntry(std::move(key), std::move(v)));
+    }
+}
+
+bool VSMap::erase(int key) {
+    int index = indexOf(key);
+    if (index < 0)
+        return false;
+    detach();
+    data->data.erase(data->data.begin() + index);
+    return true;
+}
+
+bool VSMap::erase(const char *key) {
+    int index = indexOf(key);
+    if (index < 0)
+        return false;
+    detach();
+    data->data.erase(data->data.begin() + index);
+    return true;
+}
+
+bool VSMap::insert(int key, VSVariant &&v) {
+    if (key < 0)
+        return false;
+    insertEntry(indexOf(key), VSMapKey(key), std::move(v));
+    return true;
+}
+
+void VSMap::insert(const char *key, VSVariant &&v) {
+    int atom = KeyAtoms::intern(key);
+    if (atom >= 0)
+        insertEntry(indexOf(atom), VSMapKey(atom), std::move(v));
+    else
+        insertEntry(indexOf(key), VSMapKey(key), std::move(v));
 }
 
 ///////////////
@@ -276,6 +483,28 @@ static bool isWindowsLargePageBroken() {
     return broken;
 }
 
+#if !defined(VS_TARGET_OS_WINDOWS) && defined(MADV_HUGEPAGE)
+static bool transparentHugePagesAvailable() {
+    static const bool available = []() -> bool {
+        // The setting looks like "always [madvise] never" with the active mode in brackets
+        FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+        if (!f)
+            return false;
+        char buf[128] = {};
+        size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[len] = 0;
+        return !strstr(buf, "[never]");
+    }();
+    return available;
+}
+#endif
+
+#if !defined(VS_TARGET_OS_WINDOWS) && defined(MAP_HUGETLB)
+// Set once mapping from the hugetlbfs pool has failed, most systems have no pages reserved so there's no point in retrying
+static std::atomic<bool> hugeTlbFailed(false);
+#endif
+
 /* static */ bool MemoryUse::largePageSupported() {
     // Disable large pages on 32-bit to avoid memory fragmentation.
     if (sizeof(void *) < 8)
@@ -304,6 +533,8 @@ static bool isWindowsLargePageBroken() {
 
         CloseHandle(token);
         return true;
+#elif defined(MADV_HUGEPAGE) || defined(MAP_HUGETLB)
+        return true;
 #else
         return false;
 #endif // VS_TARGET_OS_WINDOWS
@@ -322,16 +553,22 @@ static bool isWindowsLargePageBroken() {
     return size;
 }
 
-void *MemoryUse::allocateLargePage(size_t bytes) const {
-    if (!largePageEnabled)
-        return nullptr;
-
+/* static */ size_t MemoryUse::largePageAllocationSize(size_t bytes) {
     size_t granularity = largePageSize();
     size_t allocBytes = VSFrame::alignment + bytes;
     allocBytes = (allocBytes + (granularity - 1)) & ~(granularity - 1);
     assert(allocBytes % granularity == 0);
+    return allocBytes;
+}
+
+void *MemoryUse::allocateLargePage(size_t bytes) const {
+    if (!largePageEnabled)
+        return nullptr;
+
+    size_t allocBytes = largePageAllocationSize(bytes);
 
-    // Don't allocate a large page if it would conflict with the buffer recycling logic.
+    // Don't allocate a large page if rounding up to whole pages wastes more than the buffer recycling logic allows.
+    // The header records the requested size so the buffer is recycled in the same size class.
     if (!isGoodFit(bytes, allocBytes - VSFrame::alignment))
         return nullptr;
 
@@ -339,13 +576,43 @@ void *MemoryUse::allocateLargePage(size_t bytes) const {
 #ifdef VS_TARGET_OS_WINDOWS
     ptr = VirtualAlloc(nullptr, allocBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
 #else
-    ptr = vs_aligned_malloc(allocBytes, VSFrame::alignment);
+#ifdef MADV_HUGEPAGE
+    if (transparentHugePagesAvailable()) {
+        // Transparent huge pages can only back aligned ranges so over-allocate and cut off the unaligned ends
+        size_t granularity = largePageSize();
+        size_t mapBytes = allocBytes + granularity;
+        uint8_t *map = static_cast<uint8_t *>(mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (map != MAP_FAILED) {
+            uint8_t *aligned = reinterpret_cast<uint8_t *>((reinterpret_cast<uintptr_t>(map) + (granularity - 1)) & ~static_cast<uintptr_t>(granularity - 1));
+            if (aligned != map)
+                munmap(map, aligned - map);
+            if (map + mapBytes != aligned + allocBytes)
+                munmap(aligned + allocBytes, (map + mapBytes) - (aligned + allocBytes));
+            madvise(aligned, allocBytes, MADV_HUGEPAGE);
+            ptr = aligned;
+        }
+    }
+#endif
+#ifdef MAP_HUGETLB
+    // Fall back to the pages explicitly reserved for hugetlbfs
+    if (!ptr && !hugeTlbFailed) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+        flags |= 21 << MAP_HUGE_SHIFT; // 2MB pages to match largePageSize()
+#endif
+        void *map = mmap(nullptr, allocBytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (map != MAP_FAILED)
+            ptr = map;
+        else
+            hugeTlbFailed = true;
+    }
+#endif
 #endif
     if (!ptr)
         return nullptr;
 
     BlockHeader *header = new (ptr) BlockHeader;
-    header->size = allocBytes - VSFrame::alignment;
+    header->size = bytes;
     header->large = true;
     return ptr;
 }
@@ -354,7 +621,7 @@ void MemoryUse::freeLargePage(void *ptr) const {
 #ifdef VS_TARGET_OS_WINDOWS
     VirtualFree(ptr, 0, MEM_RELEASE);
 #else
-    vs_aligned_free(ptr);
+    munmap(ptr, largePageAllocationSize(static_cast<const BlockHeader *>(ptr)->size));
 #endif
 }
 
@@ -381,12 +648,21 @@ void MemoryUse::freeMemory(void *ptr) const {
         vs_aligned_free(ptr);
 }
 
-bool MemoryUse::isGoodFit(size_t requested, size_t actual) const {
+/* static */ bool MemoryUse::isGoodFit(size_t requested, size_t actual) {
     return actual <= requested + requested / 8;
 }
 
+static void updatePeak(std::atomic<size_t> &peak, size_t value) {
+    size_t current = peak;
+    while (value > current && !peak.compare_exchange_weak(current, value));
+}
+
 void MemoryUse::add(size_t bytes) {
-    used.fetch_add(bytes);
+    size_t current = used.fetch_add(bytes) + bytes;
+    updatePeak(peakUsed, current);
+    size_t limit = maxMemoryUse;
+    if (current > limit)
+        updatePeak(peakOvershoot, current - limit);
 }
 
 void MemoryUse::subtract(size_t bytes) {
@@ -395,48 +671,135 @@ void MemoryUse::subtract(size_t bytes) {
         delete this;
 }
 
+void MemoryUse::addScratch(size_t bytes) {
+    scratchSize.fetch_add(bytes);
+    add(bytes);
+}
+
+void MemoryUse::subtractScratch(size_t bytes) {
+    scratchSize.fetch_sub(bytes);
+    subtract(bytes);
+}
+
+/* static */ size_t MemoryUse::sizeClass(size_t bytes) {
+    // Eight classes per power of two, rounding up never wastes more than isGoodFit() allows
+    if (bytes <= 64)
+        return 64;
+    size_t v = bytes - 1;
+    int msb = 0;
+    while (v >> (msb + 1))
+        msb++;
+    size_t step = static_cast<size_t>(1) << (msb - 3);
+    size_t size = ((v >> (msb - 3)) + 1) * step;
+    assert(size >= bytes && isGoodFit(bytes, size));
+    return size;
+}
+
+MemoryUse::BufferPool &MemoryUse::poolForThread() {
+    static std::atomic<unsigned> nextPool(0);
+    // thread_local may be __thread which only allows constant initialization
+    static thread_local int poolIndex = -1;
+    if (poolIndex < 0)
+        poolIndex = nextPool++ % numPools;
+    return pools[poolIndex];
+}
+
+uint8_t *MemoryUse::takeBuffer(BufferPool &pool, size_t size) {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    auto iter = pool.sizeClasses.find(size);
+    if (iter == pool.sizeClasses.end())
+        return nullptr;
+    // Reuse the most recently returned buffer since it's the most likely to still be in the cache
+    auto bufIter = iter->second.back();
+    iter->second.pop_back();
+    if (iter->second.empty())
+        pool.sizeClasses.erase(iter);
+    uint8_t *buf = bufIter->buf;
+    pool.buffers.erase(bufIter);
+    unusedBufferSize -= size;
+    return buf;
+}
+
 uint8_t *MemoryUse::allocBuffer(size_t bytes) {
-    std::lock_guard<std::mutex> lock(mutex);
-    auto iter = buffers.lower_bound(bytes);
-    if (iter != buffers.end()) {
-        if (isGoodFit(bytes, iter->first)) {
-            unusedBufferSize -= iter->first;
-            uint8_t *buf = iter->second;
-            buffers.erase(iter);
-            return buf + VSFrame::alignment;
-        }
+    size_t size = sizeClass(bytes);
+    BufferPool &ownPool = poolForThread();
+    uint8_t *buf = takeBuffer(ownPool, size);
+
+    // Look for a buffer returned by other threads before allocating a new one
+    for (size_t i = 0; !buf && i < numPools; i++) {
+        if (&pools[i] != &ownPool)
+            buf = takeBuffer(pools[i], size);
     }
 
-    uint8_t *buf = static_cast<uint8_t *>(allocateMemory(bytes));
+    VS_PROBE3(buffer__alloc, bytes, size, buf ? 1 : 0);
+    if (!buf)
+        buf = static_cast<uint8_t *>(allocateMemory(size));
     return buf + VSFrame::alignment;
 }
 
 void MemoryUse::freeBuffer(uint8_t *buf) {
     assert(buf);
 
-    std::lock_guard<std::mutex> lock(mutex);
     buf -= VSFrame::alignment;
 
     const BlockHeader *header = reinterpret_cast<const BlockHeader *>(buf);
     if (!header->size)
         vsFatal("Memory corruption detected. Windows bug?");
 
-    buffers.emplace(std::make_pair(header->size, buf));
-    unusedBufferSize += header->size;
+    VS_PROBE1(buffer__free, header->size);
 
-    size_t memoryUsed = used;
-    while (memoryUsed + unusedBufferSize > maxMemoryUse && !buffers.empty()) {
-        if (!memoryWarningIssued) {
+    {
+        BufferPool &pool = poolForThread();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        auto bufIter = pool.buffers.insert(pool.buffers.end(), FreeBuffer{ buf, ++freeTicks });
+        pool.sizeClasses[header->size].push_back(bufIter);
+        unusedBufferSize += header->size;
+    }
+
+    if (used + unusedBufferSize > maxMemoryUse)
+        trimBuffers();
+}
+
+void MemoryUse::trimBuffers() {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (used + unusedBufferSize > maxMemoryUse) {
+        if (!memoryWarningIssued && !limitEnforced) {
             vsWarning("Script exceeded memory limit. Consider raising cache size.");
             memoryWarningIssued = true;
         }
-        std::uniform_int_distribution<size_t> randSrc(0, buffers.size() - 1);
-        auto iter = buffers.begin();
-        std::advance(iter, randSrc(generator));
-        assert(unusedBufferSize >= iter->first);
-        unusedBufferSize -= iter->first;
-        freeMemory(iter->second);
-        buffers.erase(iter);
+
+        // Find the pool holding the least recently returned buffer
+        BufferPool *oldestPool = nullptr;
+        uint64_t oldestTick = UINT64_MAX;
+        for (auto &pool : pools) {
+            std::lock_guard<std::mutex> poolLock(pool.mutex);
+            if (!pool.buffers.empty() && pool.buffers.front().tick < oldestTick) {
+                oldestTick = pool.buffers.front().tick;
+                oldestPool = &pool;
+            }
+        }
+
+        if (!oldestPool)
+            break;
+
+        uint8_t *buf;
+        {
+            std::lock_guard<std::mutex> poolLock(oldestPool->mutex);
+            if (oldestPool->buffers.empty())
+                continue;
+            buf = oldestPool->buffers.front().buf;
+            size_t size = reinterpret_cast<const BlockHeader *>(buf)->size;
+            // The oldest buffer in a pool is always the first one in its size class
+            auto iter = oldestPool->sizeClasses.find(size);
+            assert(iter != oldestPool->sizeClasses.end() && iter->second.front() == oldestPool->buffers.begin());
+            iter->second.erase(iter->second.begin());
+            if (iter->second.empty())
+                oldestPool->sizeClasses.erase(iter);
+            oldestPool->buffers.pop_front();
+            assert(unusedBufferSize >= size);
+            unusedBufferSize -= size;
+        }
+        freeMemory(buf);
     }
 }
 
@@ -445,28 +808,70 @@ size_t MemoryUse::memoryUse() {
 }
 
 size_t MemoryUse::getLimit() {
-    std::lock_guard<std::mutex> lock(mutex);
     return maxMemoryUse;
 }
 
+size_t MemoryUse::getUnusedBufferSize() {
+    return unusedBufferSize;
+}
+
+size_t MemoryUse::getScratchSize() {
+    return scratchSize;
+}
+
+void MemoryUse::frameCreated() {
+    ++numFrames;
+}
+
+void MemoryUse::frameDestroyed() {
+    --numFrames;
+}
+
+int64_t MemoryUse::getNumFrames() {
+    return numFrames;
+}
+
 int64_t MemoryUse::setMaxMemoryUse(int64_t bytes) {
-    std::lock_guard<std::mutex> lock(mutex);
     if (bytes > 0 && static_cast<uint64_t>(bytes) <= SIZE_MAX)
         maxMemoryUse = static_cast<size_t>(bytes);
     return maxMemoryUse;
 }
 
+bool MemoryUse::setLargePageEnabled(int enable) {
+    // Large pages are never safe to use when the Windows VirtualAlloc bug is present
+    if (enable >= 0)
+        largePageEnabled = enable && largePageSupported() && !isWindowsLargePageBroken();
+    return largePageEnabled;
+}
+
+bool MemoryUse::setLimitEnforced(int enforce) {
+    if (enforce >= 0)
+        limitEnforced = !!enforce;
+    return limitEnforced;
+}
+
 bool MemoryUse::isOverLimit() {
     return used > maxMemoryUse;
 }
 
+bool MemoryUse::isThrottled() {
+    return limitEnforced && isOverLimit();
+}
+
+void MemoryUse::getLimitInfo(VSMemoryLimitInfo &info) {
+    info.usedBytes = used;
+    info.limitBytes = maxMemoryUse;
+    info.peakUsedBytes = peakUsed;
+    info.peakOvershootBytes = peakOvershoot;
+}
+
 void MemoryUse::signalFree() {
     freeOnZero = true;
     if (!used)
         delete this;
 }
 
-MemoryUse::MemoryUse() : used(0), freeOnZero(false), largePageEnabled(largePageSupported()), memoryWarningIssued(false), unusedBufferSize(0) {
+MemoryUse::MemoryUse() : used(0), peakUsed(0), peakOvershoot(0), freeOnZero(false), largePageEnabled(largePageSupported()), limitEnforced(false), memoryWarningIssued(false), unusedBufferSize(0), scratchSize(0), freeTicks(0), numFrames(0) {
     assert(VSFrame::alignment >= sizeof(BlockHeader));
 
     // If the Windows VirtualAlloc bug is present, it is not safe to use large pages by default,
@@ -474,8 +879,10 @@ MemoryUse::MemoryUse() : used(0), freeOnZero(false), largePageEnabled(largePageS
     //if (isWindowsLargePageBroken())
     //    largePageEnabled = false;
 
-    // Always disable large pages at the moment
+#ifdef VS_TARGET_OS_WINDOWS
+    // Always disable large pages by default on Windows at the moment
     largePageEnabled = false;
+#endif
 
     // 1GB
     setMaxMemoryUse(1024 * 1024 * 1024);
@@ -486,22 +893,103 @@ MemoryUse::MemoryUse() : used(0), freeOnZero(false), largePageEnabled(largePageS
 }
 
 MemoryUse::~MemoryUse() {
-    for (auto &iter : buffers)
-        freeMemory(iter.second);
+    for (auto &pool : pools)
+        for (auto &iter : pool.buffers)
+            freeMemory(iter.buf);
 }
 
 ///////////////
 
-VSPlaneData::VSPlaneData(size_t dataSize, MemoryUse &mem) : refCount(1), mem(mem), size(dataSize + 2 * VSFrame::guardSpace) {
-#ifdef VS_FRAME_POOL
+void NodeMemoryUse::updatePeaks() {
+    peakInFlight = std::max(peakInFlight, inFlight);
+    peakCached = std::max(peakCached, cached);
+    peakTotal = std::max(peakTotal, inFlight + cached);
+}
+
+void NodeMemoryUse::add(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    inFlight += bytes;
+    updatePeaks();
+}
+
+void NodeMemoryUse::subtract(size_t bytes, bool isCached) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (isCached)
+        cached -= bytes;
+    else
+        inFlight -= bytes;
+}
+
+void NodeMemoryUse::setCached(size_t bytes, bool isCached) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (isCached) {
+        cached += bytes;
+        inFlight -= bytes;
+    } else {
+        inFlight += bytes;
+        cached -= bytes;
+    }
+    updatePeaks();
+}
+
+void NodeMemoryUse::getInfo(VSNodeMemoryInfo &info) const {
+    std::lock_guard<std::mutex> guard(lock);
+    info.inFlightBytes = inFlight;
+    info.cachedBytes = cached;
+    info.peakInFlightBytes = peakInFlight;
+    info.peakCachedBytes = peakCached;
+    info.peakTotalBytes = peakTotal;
+}
+
+///////////////
+
+NodeProfile::NodeProfile(const std::string &name, int64_t id) : name(name), id(id), registered(false) {
+    reset();
+}
+
+void NodeProfile::add(int activationReason, int64_t time, bool producedFrame) {
+    calls[activationReason == arError ? 3 : activationReason]++;
+    if (producedFrame)
+        frames++;
+    totalTime += time;
+    int64_t current = maxTime;
+    while (time > current && !maxTime.compare_exchange_weak(current, time));
+    int bucket = 0;
+    for (int64_t us = time / 1000; us > 0 && bucket < histogramSize - 1; us >>= 1)
+        bucket++;
+    histogram[bucket]++;
+}
+
+void NodeProfile::merge(const NodeProfile &other) {
+    for (int i = 0; i < 4; i++)
+        calls[i] += other.calls[i];
+    frames += other.frames;
+    totalTime += other.totalTime;
+    maxTime = std::max<int64_t>(maxTime, other.maxTime);
+    for (int i = 0; i < histogramSize; i++)
+        histogram[i] += other.histogram[i];
+}
+
+void NodeProfile::reset() {
+    for (auto &iter : calls)
+        iter = 0;
+    frames = 0;
+    totalTime = 0;
+    maxTime = 0;
+    for (auto &iter : histogram)
+        iter = 0;
+}
+
+///////////////
+
+VSPlaneData::VSPlaneData(size_t dataSize, MemoryUse &mem) : refCount(1), cacheRefs(0), mem(mem), owner(VSNode::getCurrentMemoryUse()), size(dataSize + 2 * VSFrame::guardSpace) {
     data = mem.allocBuffer(size + 2 * VSFrame::guardSpace);
-#else
-    data = vs_aligned_malloc<uint8_t>(size + 2 * VSFrame::guardSpace, VSFrame::alignment);
-#endif
     assert(data);
     if (!data)
         vsFatal("Failed to allocate memory for planes. Out of memory.");
     mem.add(size);
+    if (owner)
+        owner->add(size);
 #ifdef VS_FRAME_GUARD
     for (size_t i = 0; i < VSFrame::guardSpace / sizeof(VS_FRAME_GUARD_PATTERN); i++) {
         reinterpret_cast<uint32_t *>(data)[i] = VS_FRAME_GUARD_PATTERN;
@@ -510,25 +998,31 @@ VSPlaneData::VSPlaneData(size_t dataSize, MemoryUse &mem) : refCount(1), mem(mem
 #endif
 }
 
-VSPlaneData::VSPlaneData(const VSPlaneData &d) : refCount(1), mem(d.mem), size(d.size) {
-#ifdef VS_FRAME_POOL
+VSPlaneData::VSPlaneData(const VSPlaneData &d) : refCount(1), cacheRefs(0), mem(d.mem), owner(VSNode::getCurrentMemoryUse()), size(d.size) {
     data = mem.allocBuffer(size);
-#else
-    data = vs_aligned_malloc<uint8_t>(size, VSFrame::alignment);
-#endif
     assert(data);
     if (!data)
         vsFatal("Failed to allocate memory for plane in copy constructor. Out of memory.");
     mem.add(size);
+    if (owner)
+        owner->add(size);
     memcpy(data, d.data, size);
 }
 
+VSPlaneData::VSPlaneData(const VSPlaneData &d, size_t offset, int srcStride, int dstStride, size_t rowSize, int height) : VSPlaneData(static_cast<size_t>(dstStride) * height, d.mem) {
+    const uint8_t *srcp = d.data + VSFrame::guardSpace + offset;
+    uint8_t *dstp = data + VSFrame::guardSpace;
+    for (int y = 0; y < height; y++) {
+        memcpy(dstp, srcp, rowSize);
+        srcp += srcStride;
+        dstp += dstStride;
+    }
+}
+
 VSPlaneData::~VSPlaneData() {
-#ifdef VS_FRAME_POOL
+    if (owner)
+        owner->subtract(size, cacheRefs > 0);
     mem.freeBuffer(data);
-#else
-    vs_aligned_free(data);
-#endif
     mem.subtract(size);
 }
 
@@ -545,9 +1039,30 @@ void VSPlaneData::release() {
         delete this;
 }
 
+void VSPlaneData::claim() {
+    const PNodeMemoryUse &current = VSNode::getCurrentMemoryUse();
+    if (!current || current == owner || cacheRefs > 0)
+        return;
+    if (owner)
+        owner->subtract(size, false);
+    current->add(size);
+    owner = current;
+}
+
+void VSPlaneData::cacheHold() {
+    if (!cacheRefs++ && owner)
+        owner->setCached(size, true);
+}
+
+void VSPlaneData::cacheRelease() {
+    assert(cacheRefs > 0);
+    if (!--cacheRefs && owner)
+        owner->setCached(size, false);
+}
+
 ///////////////
 
-VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame *propSrc, VSCore *core) : format(f), data(), width(width), height(height) {
+VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame *propSrc, VSCore *core) : format(f), data(), width(width), height(height), offset(), cacheEntries(0) {
     if (!f)
         vsFatal("Error in frame creation: null format");
 
@@ -574,9 +1089,11 @@ VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame *propSr
         data[1] = new VSPlaneData(size23, *core->memory);
         data[2] = new VSPlaneData(size23, *core->memory);
     }
+
+    core->memory->frameCreated();
 }
 
-VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame * const *planeSrc, const int *plane, const VSFrame *propSrc, VSCore *core) : format(f), data(), width(width), height(height) {
+VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame * const *planeSrc, const int *plane, const VSFrame *propSrc, VSCore *core) : format(f), data(), width(width), height(height), offset(), cacheEntries(0) {
     if (!f)
         vsFatal("Error in frame creation: null format");
 
@@ -603,8 +1120,14 @@ VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame * const
                 vsFatal("Error in frame creation: plane %d does not exist in the source frame", plane[i]);
             if (planeSrc[i]->getHeight(plane[i]) != getHeight(i) || planeSrc[i]->getWidth(plane[i]) != getWidth(i))
                 vsFatal("Error in frame creation: dimensions of plane %d do not match. Source: %dx%d; destination: %dx%d", plane[i], planeSrc[i]->getWidth(plane[i]), planeSrc[i]->getHeight(plane[i]), getWidth(i), getHeight(i));
-            data[i] = planeSrc[i]->data[plane[i]];
-            data[i]->addRef();
+            if (planeSrc[i]->stride[plane[i]] == stride[i]) {
+                data[i] = planeSrc[i]->data[plane[i]];
+                data[i]->addRef();
+                offset[i] = planeSrc[i]->offset[plane[i]];
+            } else {
+                // views can have a different stride, copy them so all planes get the usual layout
+                data[i] = new VSPlaneData(*planeSrc[i]->data[plane[i]], planeSrc[i]->offset[plane[i]], planeSrc[i]->stride[plane[i]], stride[i], getWidth(i) * f->bytesPerSample, getHeight(i));
+            }
         } else {
             if (i == 0) {
                 data[i] = new VSPlaneData(stride[i] * height, *core->memory);
@@ -613,9 +1136,11 @@ VSFrame::VSFrame(const VSFormat *f, int width, int height, const VSFrame * const
             }
         }
     }
+
+    core->memory->frameCreated();
 }
 
-VSFrame::VSFrame(const VSFrame &f) {
+VSFrame::VSFrame(const VSFrame &f) : cacheEntries(0) {
     data[0] = f.data[0];
     data[1] = f.data[1];
     data[2] = f.data[2];
@@ -630,10 +1155,16 @@ VSFrame::VSFrame(const VSFrame &f) {
     stride[0] = f.stride[0];
     stride[1] = f.stride[1];
     stride[2] = f.stride[2];
+    offset[0] = f.offset[0];
+    offset[1] = f.offset[1];
+    offset[2] = f.offset[2];
     properties = f.properties;
+    data[0]->getMemoryUse().frameCreated();
 }
 
 VSFrame::~VSFrame() {
+    // the memory use object may be freed together with the last plane
+    data[0]->getMemoryUse().frameDestroyed();
     data[0]->release();
     if (data[1]) {
         data[1]->release();
@@ -652,7 +1183,74 @@ const uint8_t *VSFrame::getReadPtr(int plane) const {
     if (plane < 0 || plane >= format->numPlanes)
         vsFatal("Requested read pointer for nonexistent plane %d", plane);
 
-    return data[plane]->data + guardSpace;
+    return data[plane]->data + guardSpace + offset[plane];
+}
+
+bool VSFrame::isView(int plane) const {
+    return offset[plane] != 0 || data[plane]->size != static_cast<size_t>(stride[plane]) * getHeight(plane) + 2 * guardSpace;
+}
+
+PVideoFrame VSFrame::cropView(const PVideoFrame &f, int left, int top, int width, int height) {
+    const VSFormat *fi = f->format;
+    assert(left >= 0 && top >= 0 && left + width <= f->width && top + height <= f->height);
+
+    // the planes have to stay aligned and keep the stride a new frame of this width gets, many filters
+    // allocate their output at the same size and step through it with the stride of the input
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        int planeWidth = width >> (plane ? fi->subSamplingW : 0);
+        int naturalStride = (planeWidth * fi->bytesPerSample + (alignment - 1)) & ~(alignment - 1);
+        if (((left >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample) % alignment || f->stride[plane] != naturalStride)
+            return PVideoFrame();
+    }
+
+    PVideoFrame view = std::make_shared<VSFrame>(*f);
+    view->width = width;
+    view->height = height;
+    for (int plane = 0; plane < fi->numPlanes; plane++)
+        view->offset[plane] += static_cast<size_t>(top >> (plane ? fi->subSamplingH : 0)) * view->stride[plane] + (left >> (plane ? fi->subSamplingW : 0)) * fi->bytesPerSample;
+    return view;
+}
+
+PVideoFrame VSFrame::fieldView(const PVideoFrame &f, int field) {
+    assert(field == 0 || field == 1);
+    assert(!(f->height % (2 << f->format->subSamplingH)));
+
+    PVideoFrame view = std::make_shared<VSFrame>(*f);
+    view->height /= 2;
+    for (int plane = 0; plane < f->format->numPlanes; plane++) {
+        view->offset[plane] += field * view->stride[plane];
+        view->stride[plane] *= 2;
+    }
+    return view;
+}
+
+PVideoFrame VSFrame::weaveViews(const PVideoFrame &top, const PVideoFrame &bottom) {
+    const VSFormat *fi = top->format;
+    if (fi != bottom->format || top->width != bottom->width || top->height != bottom->height || top->height % (1 << fi->subSamplingH))
+        return PVideoFrame();
+
+    // only possible when the fields are every other line of the same planes
+    for (int plane = 0; plane < fi->numPlanes; plane++) {
+        if (top->data[plane] != bottom->data[plane] || top->stride[plane] != bottom->stride[plane] || top->stride[plane] % (2 * alignment)
+            || bottom->offset[plane] != top->offset[plane] + top->stride[plane] / 2)
+            return PVideoFrame();
+    }
+
+    PVideoFrame view = std::make_shared<VSFrame>(*top);
+    view->height *= 2;
+    for (int plane = 0; plane < fi->numPlanes; plane++)
+        view->stride[plane] /= 2;
+    return view;
+}
+
+void VSFrame::cacheHold() {
+    for (int i = 0; i < format->numPlanes; i++)
+        data[i]->cacheHold();
+}
+
+void VSFrame::cacheRelease() {
+    for (int i = 0; i < format->numPlanes; i++)
+        data[i]->cacheRelease();
 }
 
 uint8_t *VSFrame::getWritePtr(int plane) {
@@ -662,11 +1260,18 @@ uint8_t *VSFrame::getWritePtr(int plane) {
     // copy the plane data if this isn't the only reference
     if (!data[plane]->unique()) {
         VSPlaneData *old = data[plane];
-        data[plane] = new VSPlaneData(*data[plane]);
+        if (isView(plane))
+            data[plane] = new VSPlaneData(*old, offset[plane], stride[plane], stride[plane], getWidth(plane) * format->bytesPerSample, getHeight(plane));
+        else
+            data[plane] = new VSPlaneData(*old);
+        offset[plane] = 0;
         old->release();
+    } else {
+        // a frame modified in place now belongs to the filter writing to it
+        data[plane]->claim();
     }
 
-    return data[plane]->data + guardSpace;
+    return data[plane]->data + guardSpace + offset[plane];
 }
 
 #ifdef VS_FRAME_GUARD
@@ -786,7 +1391,7 @@ VSFunction::VSFunction(const std::string &argString, VSPublicFunction func, void
 }
 
 VSNode::VSNode(const VSMap *in, VSMap *out, const std::string &name, VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree free, VSFilterMode filterMode, int flags, void *instanceData, int apiMajor, VSCore *core) :
-instanceData(instanceData), name(name), init(init), filterGetFrame(getFrame), free(free), filterMode(filterMode), apiMajor(apiMajor), core(core), flags(flags), hasVi(false), serialFrame(-1) {
+instanceData(instanceData), name(name), init(init), filterGetFrame(getFrame), free(free), filterMode(filterMode), apiMajor(apiMajor), core(core), flags(flags), hasVi(false), serialFrame(-1), memoryUse(std::make_shared<NodeMemoryUse>()), traceGeneration(0) {
 
     if (flags & ~(nfNoCache | nfIsCache | nfMakeLinear))
         throw VSException("Filter " + name  + " specified unknown flags");
@@ -795,6 +1400,24 @@ instanceData(instanceData), name(name), init(init), filterGetFrame(getFrame), fr
         throw VSException("Filter " + name + " specified an illegal combination of flags (nfNoCache must always be set with nfIsCache)");
 
     core->filterInstanceCreated();
+    id = core->createNodeId();
+    profile = std::make_shared<NodeProfile>(name, id);
+
+    hints.flags = 0;
+    hints.spatialRadius = -1;
+    hints.temporalRadius = -1;
+    hints.untouchedPlanes = 0;
+
+    for (const auto &iter : in->getStorage()) {
+        const VSVariant &v = iter.second;
+        if (v.getType() == VSVariant::vNode) {
+            for (size_t i = 0; i < v.size(); i++) {
+                const VSNodeRef &ref = v.getValue<VSNodeRef>(i);
+                inputs.push_back(std::make_pair(std::weak_ptr<VSNode>(ref.clip), ref.index));
+            }
+        }
+    }
+
     VSMap inval(*in);
     init(&inval, out, &this->instanceData, this, core, getVSAPIInternal(apiMajor));
 
@@ -817,13 +1440,84 @@ instanceData(instanceData), name(name), init(init), filterGetFrame(getFrame), fr
 }
 
 VSNode::~VSNode() {
+    if (profile->registered)
+        core->removeProfile(profile);
     core->destroyFilterInstance(this);
 }
 
+void VSNode::getNodeInfo(VSNodeInfo &info) const {
+    info.name = name.c_str();
+    info.id = id;
+    info.filterMode = filterMode;
+    info.flags = flags;
+    info.numOutputs = static_cast<int>(vi.size());
+    info.numInputs = static_cast<int>(inputs.size());
+    info.hints = hints;
+}
+
+void VSNode::setHints(const VSFilterHints &hints) {
+    const int knownFlags = fhPure | fhPointwise | fhCheap | fhPassThrough;
+    // filters built against a newer header may pass flags this version doesn't know about
+    if (hints.flags & ~knownFlags)
+        vsWarning("setFilterHints: Filter %s specified unknown hint flags %d, they're ignored", name.c_str(), hints.flags & ~knownFlags);
+    this->hints = hints;
+    this->hints.flags &= knownFlags;
+    if (flags & nfIsCache)
+        return;
+
+    // make room for the whole window of frames the filter requests at once in the caches it reads from
+    if (hints.temporalRadius > 0) {
+        int frames = 2 * hints.temporalRadius + 1 + core->threadPool->threadCount();
+        for (const auto &iter : inputs) {
+            PVideoNode input = iter.first.lock();
+            if (input)
+                input->reserveCache(frames);
+        }
+    }
+}
+
+VSNodeRef *VSNode::getInput(int index) const {
+    if (index < 0 || static_cast<size_t>(index) >= inputs.size())
+        return nullptr;
+    PVideoNode input = inputs[index].first.lock();
+    return input ? new VSNodeRef(input, inputs[index].second) : nullptr;
+}
+
+static std::mutex invocationLock;
+
+void VSNode::setInvocation(const PInvocation &invocation, int index, const std::string &key, int position) {
+    std::lock_guard<std::mutex> lock(invocationLock);
+    // nodes passed through by later calls keep the call that created them
+    if (this->invocation && this->invocation != invocation)
+        return;
+    this->invocation = invocation;
+    invocationOutputs.resize(vi.size());
+    if (invocationOutputs[index].first.empty())
+        invocationOutputs[index] = std::make_pair(key, position);
+}
+
+bool VSNode::getInvocation(int index, PInvocation &invocation, std::string &key, int &position) const {
+    std::lock_guard<std::mutex> lock(invocationLock);
+    if (!this->invocation || invocationOutputs[index].first.empty())
+        return false;
+    invocation = this->invocation;
+    key = invocationOutputs[index].first;
+    position = invocationOutputs[index].second;
+    return true;
+}
+
+void *getFilterInstanceData(VSNodeRef *node, VSFilterGetFrame getFrame) {
+    return node->clip->getInstanceData(getFrame);
+}
+
 void VSNode::getFrame(const PFrameContext &ct) {
     core->threadPool->start(ct);
 }
 
+void VSNode::prefetch(VSNodeRef *node, int first, int last, int priority) {
+    core->threadPool->prefetch(node, first, last, priority);
+}
+
 const VSVideoInfo &VSNode::getVideoInfo(int index) {
     if (index < 0 || index >= static_cast<int>(vi.size()))
         vsFatal("getVideoInfo: Out of bounds videoinfo index %d. Valid range: [0,%d].", index, static_cast<int>(vi.size() - 1));
@@ -850,8 +1544,142 @@ void VSNode::setVideoInfo(const VSVideoInfo *vi, int numOutputs) {
     hasVi = true;
 }
 
+// the node whose getframe function is running on this thread, frames allocated here are attributed to it
+static thread_local VSNode *currentNode = nullptr;
+
+struct ScratchArenaData {
+    uint8_t *buffer;
+    size_t size;
+    size_t used;
+    size_t wanted;
+    // the most wanted by a single getframe call since the last trim check
+    size_t recentPeak;
+    unsigned resets;
+    // charged for the arena and the overflow allocations, the worker threads only ever serve one core
+    MemoryUse *memory;
+    // allocations that didn't fit, only freed at the end of the getframe call
+    std::vector<std::pair<uint8_t *, size_t>> overflow;
+    ScratchArenaData() : buffer(nullptr), size(0), used(0), wanted(0), recentPeak(0), resets(0), memory(nullptr) {}
+};
+
+static thread_local ScratchArenaData *threadArena = nullptr;
+
+static void resizeArena(ScratchArenaData *a, size_t size) {
+    uint8_t *buffer = nullptr;
+    if (size) {
+        buffer = vs_aligned_malloc<uint8_t>(size, ScratchArena::alignment);
+        if (!buffer)
+            vsFatal("Failed to allocate %zu bytes of scratch memory. Out of memory.", size);
+    }
+    if (a->memory)
+        a->memory->addScratch(size);
+    vs_aligned_free(a->buffer);
+    if (a->memory)
+        a->memory->subtractScratch(a->size);
+    a->buffer = buffer;
+    a->size = size;
+}
+
+void *ScratchArena::alloc(size_t bytes) {
+    if (!threadArena)
+        threadArena = new ScratchArenaData();
+    ScratchArenaData *a = threadArena;
+    if (!a->memory && currentNode)
+        a->memory = currentNode->core->memory;
+
+    bytes = (std::max<size_t>(bytes, 1) + (alignment - 1)) & ~(alignment - 1);
+    a->wanted += bytes;
+
+    if (a->used + bytes <= a->size) {
+        uint8_t *ptr = a->buffer + a->used;
+        a->used += bytes;
+        return ptr;
+    }
+
+    uint8_t *ptr = vs_aligned_malloc<uint8_t>(bytes, alignment);
+    if (!ptr)
+        vsFatal("Failed to allocate %zu bytes of scratch memory. Out of memory.", bytes);
+    if (a->memory)
+        a->memory->addScratch(bytes);
+    a->overflow.push_back(std::make_pair(ptr, bytes));
+    return ptr;
+}
+
+void ScratchArena::reset() {
+    ScratchArenaData *a = threadArena;
+    if (!a)
+        return;
+
+    for (const auto &iter : a->overflow) {
+        vs_aligned_free(iter.first);
+        if (a->memory)
+            a->memory->subtractScratch(iter.second);
+    }
+    bool overflowed = !a->overflow.empty();
+    a->overflow.clear();
+
+    a->recentPeak = std::max(a->recentPeak, a->wanted);
+    size_t fits = a->wanted < maxArenaSize ? a->wanted : maxArenaSize;
+    if (overflowed && fits > a->size) {
+        // grow so everything up to the cap fits in the arena the next time, bigger requests keep going to plain allocations
+        resizeArena(a, fits);
+    } else if (++a->resets >= trimInterval) {
+        // give back what a burst of big requests left behind once the recent calls only need a fraction of it
+        if (a->recentPeak < a->size / 2)
+            resizeArena(a, a->recentPeak);
+        a->resets = 0;
+        a->recentPeak = 0;
+    }
+
+    a->used = 0;
+    a->wanted = 0;
+}
+
+void ScratchArena::freeThreadArena() {
+    ScratchArenaData *a = threadArena;
+    if (!a)
+        return;
+    reset();
+    resizeArena(a, 0);
+    delete a;
+    threadArena = nullptr;
+}
+
+const PNodeMemoryUse &VSNode::getCurrentMemoryUse() {
+    static const PNodeMemoryUse none;
+    return currentNode ? currentNode->memoryUse : none;
+}
+
+bool VSNode::isInGetFrame() {
+    return !!currentNode;
+}
+
+void VSNode::getMemoryInfo(VSNodeMemoryInfo &info) {
+    // caches never allocate frames themselves so report the node they're caching instead
+    if (flags & nfIsCache) {
+        static_cast<CacheInstance *>(instanceData)->clip->clip->getMemoryInfo(info);
+        return;
+    }
+    memoryUse->getInfo(info);
+}
+
 PVideoFrame VSNode::getFrameInternal(int n, int activationReason, VSFrameContext &frameCtx) {
-    const VSFrameRef *r = filterGetFrame(n, activationReason, &instanceData, &frameCtx.ctx->frameContext, &frameCtx, core, &vs_internal_vsapi);
+    VSNode *prevNode = currentNode;
+    currentNode = this;
+    const VSFrameRef *r;
+    if (core->profiling.load(std::memory_order_relaxed)) {
+        auto start = std::chrono::steady_clock::now();
+        r = filterGetFrame(n, activationReason, &instanceData, &frameCtx.ctx->frameContext, &frameCtx, core, &vs_internal_vsapi);
+        int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        profile->add(activationReason, time, !!r);
+        if (!profile->registered.exchange(true))
+            core->addProfile(profile);
+    } else {
+        r = filterGetFrame(n, activationReason, &instanceData, &frameCtx.ctx->frameContext, &frameCtx, core, &vs_internal_vsapi);
+    }
+    currentNode = prevNode;
+    if (!prevNode)
+        ScratchArena::reset();
 
 #ifdef VS_TARGET_OS_WINDOWS
     if (!vs_isSSEStateOk())
@@ -901,6 +1729,24 @@ void VSNode::notifyCache(bool needMemory) {
     cache->cache.adjustSize(needMemory);
 }
 
+void VSNode::reserveCache(int frames) {
+    if (!(flags & nfIsCache))
+        return;
+    std::lock_guard<std::mutex> lock(serialMutex);
+    CacheInstance *cache = (CacheInstance *)instanceData;
+    cache->cache.reserve(frames);
+}
+
+// returns true if f is the only remaining reference to the frame, a cache will let go of its reference when it's unlikely to be requested again
+bool VSNode::releaseFrameForModify(int n, const PVideoFrame &f) {
+    // frames passed through from a cache further up may still be brought back by it
+    if (!(flags & nfIsCache))
+        return f.use_count() == 1 && !f->getCacheEntries();
+    std::lock_guard<std::mutex> lock(serialMutex);
+    CacheInstance *cache = (CacheInstance *)instanceData;
+    return cache->cache.donate(n, f);
+}
+
 PVideoFrame VSCore::newVideoFrame(const VSFormat *f, int width, int height, const VSFrame *propSrc) {
     return std::make_shared<VSFrame>(f, width, height, propSrc, this);
 }
@@ -1047,6 +1893,142 @@ void VSCore::getCoreInfo2(VSCoreInfo &info) {
     info.usedFramebufferSize = memory->memoryUse();
 }
 
+static void insertInt(VSMap &map, const char *key, int64_t value) {
+    VSVariant v(VSVariant::vInt);
+    v.append(value);
+    map.insert(key, std::move(v));
+}
+
+void VSCore::getStats(VSMap &out) {
+    VSMemoryLimitInfo info;
+    getMemoryLimitInfo(info);
+    int active, idle, queued, contexts;
+    threadPool->getQueueInfo(active, idle, queued, contexts);
+
+    out.clear();
+    insertInt(out, "memory_used", info.usedBytes);
+    insertInt(out, "memory_limit", info.limitBytes);
+    insertInt(out, "memory_peak", info.peakUsedBytes);
+    insertInt(out, "buffer_pool", memory->getUnusedBufferSize());
+    insertInt(out, "scratch_memory", memory->getScratchSize());
+    insertInt(out, "threads", threadPool->threadCount());
+    insertInt(out, "active_threads", active);
+    insertInt(out, "idle_threads", idle);
+    insertInt(out, "queued_tasks", queued);
+    insertInt(out, "frame_contexts", contexts);
+    insertInt(out, "deferred_requests", info.waitingRequests);
+    insertInt(out, "frames", memory->getNumFrames());
+    insertInt(out, "nodes", numFilterInstances - 1);
+
+    VSVariant ids(VSVariant::vInt), names(VSVariant::vData), sizes(VSVariant::vInt), maxSizes(VSVariant::vInt), hits(VSVariant::vInt), nearMiss(VSVariant::vInt), farMiss(VSVariant::vInt);
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        for (VSNode *node : caches) {
+            CacheInstance *cache = static_cast<CacheInstance *>(node->instanceData);
+            VSCache::Stats stats;
+            {
+                std::lock_guard<std::mutex> nodeLock(node->serialMutex);
+                stats = cache->cache.getStats();
+            }
+            ids.append(node->id);
+            names.append(cache->clip->clip->getName());
+            sizes.append(static_cast<int64_t>(stats.size));
+            maxSizes.append(static_cast<int64_t>(stats.maxSize));
+            hits.append(stats.hits);
+            nearMiss.append(stats.nearMiss);
+            farMiss.append(stats.farMiss);
+        }
+    }
+
+    if (!ids.size())
+        return;
+    out.insert("cache_id", std::move(ids));
+    out.insert("cache_name", std::move(names));
+    out.insert("cache_size", std::move(sizes));
+    out.insert("cache_max_size", std::move(maxSizes));
+    out.insert("cache_hits", std::move(hits));
+    out.insert("cache_near_miss", std::move(nearMiss));
+    out.insert("cache_far_miss", std::move(farMiss));
+}
+
+void VSCore::getMemoryLimitInfo(VSMemoryLimitInfo &info) {
+    memory->getLimitInfo(info);
+    threadPool->getDeferredInfo(info.deferredRequests, info.waitingRequests);
+}
+
+bool VSCore::setGraphRecording(int enable) {
+    if (enable >= 0)
+        recordingGraph = !!enable;
+    return recordingGraph;
+}
+
+bool VSCore::setProfiling(int enable) {
+    if (enable >= 0)
+        profiling = !!enable;
+    return profiling;
+}
+
+void VSCore::addProfile(const PNodeProfile &profile) {
+    std::lock_guard<std::mutex> lock(profileLock);
+    profiles[profile->id] = profile;
+}
+
+void VSCore::removeProfile(const PNodeProfile &profile) {
+    std::lock_guard<std::mutex> lock(profileLock);
+    if (!profiles.erase(profile->id))
+        return;
+    PNodeProfile &freed = freedProfiles[profile->name];
+    if (!freed)
+        freed = std::make_shared<NodeProfile>(profile->name, -1);
+    freed->merge(*profile);
+}
+
+void VSCore::getProfile(VSMap &out, bool reset) {
+    std::vector<PNodeProfile> current;
+    {
+        std::lock_guard<std::mutex> lock(profileLock);
+        for (const auto &iter : freedProfiles)
+            current.push_back(iter.second);
+        for (const auto &iter : profiles)
+            current.push_back(iter.second);
+        if (reset) {
+            profiles.clear();
+            freedProfiles.clear();
+        }
+    }
+
+    const char *callKeys[] = { "calls_initial", "calls_frame_ready", "calls_all_frames_ready", "calls_error" };
+    VSVariant ids(VSVariant::vInt), names(VSVariant::vData), calls[4], frames(VSVariant::vInt), totalTime(VSVariant::vInt), maxTime(VSVariant::vInt), histogram(VSVariant::vInt);
+    for (auto &iter : calls)
+        iter = VSVariant(VSVariant::vInt);
+    for (const auto &p : current) {
+        ids.append(p->id);
+        names.append(p->name);
+        for (int i = 0; i < 4; i++)
+            calls[i].append(static_cast<int64_t>(p->calls[i]));
+        frames.append(static_cast<int64_t>(p->frames));
+        totalTime.append(static_cast<int64_t>(p->totalTime));
+        maxTime.append(static_cast<int64_t>(p->maxTime));
+        for (const auto &bucket : p->histogram)
+            histogram.append(static_cast<int64_t>(bucket));
+        if (reset) {
+            p->reset();
+            p->registered = false;
+        }
+    }
+
+    if (current.empty())
+        return;
+    out.insert("id", std::move(ids));
+    out.insert("name", std::move(names));
+    for (int i = 0; i < 4; i++)
+        out.insert(callKeys[i], std::move(calls[i]));
+    out.insert("frames", std::move(frames));
+    out.insert("total_time", std::move(totalTime));
+    out.insert("max_time", std::move(maxTime));
+    out.insert("histogram", std::move(histogram));
+}
+
 void VS_CC vs_internal_configPlugin(const char *identifier, const char *defaultNamespace, const char *name, int apiVersion, int readOnly, VSPlugin *plugin);
 void VS_CC vs_internal_registerFunction(const char *name, const char *args, VSPublicFunction argsFunc, void *functionData, VSPlugin *plugin);
 
@@ -1122,13 +2104,15 @@ void VSCore::registerFormats() {
 
 
 #ifdef VS_TARGET_OS_WINDOWS
-bool VSCore::loadAllPluginsInPath(const std::wstring &path, const std::wstring &filter) {
+bool VSCore::loadAllPluginsInPath(const std::wstring &path, const std::wstring &filter, PluginCache &cache) {
 #else
-bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &filter) {
+bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &filter, PluginCache &cache) {
 #endif
     if (path.empty())
         return false;
 
+    std::vector<std::string> files;
+
 #ifdef VS_TARGET_OS_WINDOWS
     std::wstring wPath = path + L"\\" + filter;
     WIN32_FIND_DATA findData;
@@ -1136,11 +2120,7 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
     if (findHandle == INVALID_HANDLE_VALUE)
         return false;
     do {
-        try {
-            loadPlugin(utf16_to_utf8(path + L"\\" + findData.cFileName));
-        } catch (VSException &) {
-            // Ignore any errors
-        }
+        files.push_back(utf16_to_utf8(path + L"\\" + findData.cFileName));
     } while (FindNextFile(findHandle, &findData));
     FindClose(findHandle);
 #else
@@ -1148,10 +2128,6 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
     if (!dir)
         return false;
 
-    int name_max = pathconf(path.c_str(), _PC_NAME_MAX);
-    if (name_max == -1)
-        name_max = 255;
-
     while (true) {
         struct dirent *result = readdir(dir);
         if (!result) {
@@ -1161,13 +2137,9 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
         std::string name(result->d_name);
         // If name ends with filter
         if (name.size() >= filter.size() && name.compare(name.size() - filter.size(), filter.size(), filter) == 0) {
-            try {
-                std::string fullname;
-                fullname.append(path).append("/").append(name);
-                loadPlugin(fullname);
-            } catch (VSException &) {
-                // Ignore any errors
-            }
+            std::string fullname;
+            fullname.append(path).append("/").append(name);
+            files.push_back(fullname);
         }
     }
 
@@ -1176,6 +2148,43 @@ bool VSCore::loadAllPluginsInPath(const std::string &path, const std::string &fi
     }
 #endif
 
+    // plugins that haven't changed since they were cached are registered without loading them, the rest are
+    // loaded one at a time since the dynamic loader holds a global lock while mapping a library anyway
+    for (const auto &file : files) {
+        int64_t mtime;
+        int64_t size;
+        bool hasInfo = PluginCache::getFileInfo(file, mtime, size);
+        const PluginCacheEntry *cached = hasInfo ? cache.find(file, mtime, size) : nullptr;
+
+        VSPlugin *plugin = nullptr;
+        if (cached) {
+            plugin = new VSPlugin(*cached, this);
+        } else {
+            try {
+                plugin = new VSPlugin(file, std::string(), std::string(), false, this);
+            } catch (VSException &) {
+                // Ignore any errors
+            }
+
+            if (plugin && hasInfo) {
+                PluginCacheEntry entry;
+                entry.path = file;
+                entry.mtime = mtime;
+                entry.size = size;
+                plugin->getCacheEntry(entry);
+                cache.insert(entry);
+            }
+        }
+
+        if (plugin) {
+            try {
+                addPlugin(plugin);
+            } catch (VSException &) {
+                // Ignore any errors
+            }
+        }
+    }
+
     return true;
 }
 
@@ -1191,6 +2200,14 @@ void VSCore::filterInstanceCreated() {
     ++numFilterInstances;
 }
 
+int64_t VSCore::createNodeId() {
+    return nodeIdCounter++;
+}
+
+int64_t VSCore::getNextNodeId() const {
+    return nodeIdCounter;
+}
+
 void VSCore::filterInstanceDestroyed() {
     if (!--numFilterInstances) {
         assert(coreFreed);
@@ -1235,7 +2252,11 @@ VSCore::VSCore(int threads) :
     numFunctionInstances(0),
     formatIdOffset(1000),
     cpuLevel(INT_MAX),
-    memory(new MemoryUse()) {
+    autotune(false),
+    nodeIdCounter(0),
+    memory(new MemoryUse()),
+    profiling(false),
+    recordingGraph(false) {
 #ifdef VS_TARGET_OS_WINDOWS
     if (!vs_isSSEStateOk())
         vsFatal("Bad SSE state detected when creating new core");
@@ -1299,18 +2320,24 @@ VSCore::VSCore(int threads) :
     if (portableFile)
         fclose(portableFile);
 
+    std::vector<wchar_t> localAppDataBuffer(MAX_PATH + 1);
+    if (SHGetFolderPath(nullptr, CSIDL_LOCAL_APPDATA, nullptr, SHGFP_TYPE_CURRENT, localAppDataBuffer.data()) != S_OK)
+        SHGetFolderPath(nullptr, CSIDL_LOCAL_APPDATA, nullptr, SHGFP_TYPE_DEFAULT, localAppDataBuffer.data());
+    std::wstring localAppDataPath = localAppDataBuffer.data();
+    PluginCache pluginCache(localAppDataPath.empty() ? std::string() : utf16_to_utf8(localAppDataPath + L"\\VapourSynth\\plugincache" + bits));
+
     if (isPortable) {
         // Use alternative search strategy relative to dll path
 
         // Autoload bundled plugins
         std::wstring corePluginPath = dllPath + L"vapoursynth" + bits + L"\\coreplugins";
-        if (!loadAllPluginsInPath(corePluginPath, filter))
+        if (!loadAllPluginsInPath(corePluginPath, filter, pluginCache))
             vsCritical("Core plugin autoloading failed. Installation is broken?");
 
         // Autoload global plugins last, this is so the bundled plugins cannot be overridden easily
         // and accidentally block updated bundled versions
         std::wstring globalPluginPath = dllPath + L"vapoursynth" + bits + L"\\plugins";
-        loadAllPluginsInPath(globalPluginPath, filter);
+        loadAllPluginsInPath(globalPluginPath, filter, pluginCache);
     } else {
         // Autoload user specific plugins first so a user can always override
         std::vector<wchar_t> appDataBuffer(MAX_PATH + 1);
@@ -1320,26 +2347,29 @@ VSCore::VSCore(int threads) :
         std::wstring appDataPath = std::wstring(appDataBuffer.data()) + L"\\VapourSynth\\plugins" + bits;
 
         // Autoload per user plugins
-        loadAllPluginsInPath(appDataPath, filter);
+        loadAllPluginsInPath(appDataPath, filter, pluginCache);
 
         // Autoload bundled plugins
         std::wstring corePluginPath = readRegistryValue(VS_INSTALL_REGKEY, L"CorePlugins");
-        if (!loadAllPluginsInPath(corePluginPath, filter))
+        if (!loadAllPluginsInPath(corePluginPath, filter, pluginCache))
             vsCritical("Core plugin autoloading failed. Installation is broken?");
 
         // Autoload global plugins last, this is so the bundled plugins cannot be overridden easily
         // and accidentally block updated bundled versions
         std::wstring globalPluginPath = readRegistryValue(VS_INSTALL_REGKEY, L"Plugins");
-        loadAllPluginsInPath(globalPluginPath, filter);
+        loadAllPluginsInPath(globalPluginPath, filter, pluginCache);
     }
 
+    pluginCache.save();
 #else
     std::string configFile;
+    std::string cacheFile;
     const char *home = getenv("HOME");
 #ifdef VS_TARGET_OS_DARWIN
     std::string filter = ".dylib";
     if (home) {
         configFile.append(home).append("/Library/Application Support/VapourSynth/vapoursynth.conf");
+        cacheFile.append(home).append("/Library/Caches/VapourSynth/plugincache");
     }
 #else
     std::string filter = ".so";
@@ -1349,6 +2379,12 @@ VSCore::VSCore(int threads) :
     } else if (home) {
         configFile.append(home).append("/.config/vapoursynth/vapoursynth.conf");
     } // If neither exists, an empty string will do.
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home) {
+        cacheFile.append(xdg_cache_home).append("/vapoursynth/plugincache");
+    } else if (home) {
+        cacheFile.append(home).append("/.cache/vapoursynth/plugincache");
+    } // No cache is used if neither exists
 #endif
 
     VSMap *settings = readSettings(configFile);
@@ -1371,17 +2407,28 @@ VSCore::VSCore(int threads) :
         tmp = vs_internal_vsapi.propGetData(settings, "AutoloadSystemPluginDir", 0, &err);
         bool autoloadSystemPluginDir = tmp ? std::string(tmp) == "true" : true;
 
+        tmp = vs_internal_vsapi.propGetData(settings, "PluginCacheFile", 0, &err);
+        if (tmp)
+            cacheFile = tmp;
+
+        tmp = vs_internal_vsapi.propGetData(settings, "UsePluginCache", 0, &err);
+        bool usePluginCache = tmp ? std::string(tmp) == "true" : true;
+
+        PluginCache pluginCache(usePluginCache ? cacheFile : std::string());
+
         if (autoloadUserPluginDir && !userPluginDir.empty()) {
-            if (!loadAllPluginsInPath(userPluginDir, filter)) {
+            if (!loadAllPluginsInPath(userPluginDir, filter, pluginCache)) {
                 vsWarning("Autoloading the user plugin dir '%s' failed. Directory doesn't exist?", userPluginDir.c_str());
             }
         }
 
         if (autoloadSystemPluginDir) {
-            if (!loadAllPluginsInPath(systemPluginDir, filter)) {
+            if (!loadAllPluginsInPath(systemPluginDir, filter, pluginCache)) {
                 vsCritical("Autoloading the system plugin dir '%s' failed. Directory doesn't exist?", systemPluginDir.c_str());
             }
         }
+
+        pluginCache.save();
     }
 
     vs_internal_vsapi.freeMap(settings);
@@ -1395,8 +2442,10 @@ void VSCore::freeCore() {
     threadPool->waitForDone();
     if (numFilterInstances > 1)
         vsWarning("Core freed but %d filter instance(s) still exist", numFilterInstances.load() - 1);
-    if (memory->memoryUse() > 0)
-        vsWarning("Core freed but %llu bytes still allocated in framebuffers", static_cast<unsigned long long>(memory->memoryUse()));
+    // the worker threads still hold their scratch arenas until the thread pool is deleted
+    size_t frameMemory = memory->memoryUse() - memory->getScratchSize();
+    if (frameMemory > 0)
+        vsWarning("Core freed but %llu bytes still allocated in framebuffers", static_cast<unsigned long long>(frameMemory));
     if (numFunctionInstances > 0)
         vsWarning("Core freed but %d function instance(s) still exist", numFunctionInstances.load());
     // Release the extra filter instance that always keeps the core alive
@@ -1443,10 +2492,14 @@ VSPlugin *VSCore::getPluginByNs(const std::string &ns) {
 }
 
 void VSCore::loadPlugin(const std::string &filename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath) {
-    VSPlugin *p = new VSPlugin(filename, forcedNamespace, forcedId, altSearchPath, this);
+    addPlugin(new VSPlugin(filename, forcedNamespace, forcedId, altSearchPath, this));
+}
 
+void VSCore::addPlugin(VSPlugin *p) {
     std::lock_guard<std::recursive_mutex> lock(pluginLock);
 
+    const std::string &filename = p->filename;
+
     VSPlugin *already_loaded_plugin = getPluginById(p->id);
     if (already_loaded_plugin) {
         std::string error = "Plugin " + filename + " already loaded (" + p->id + ")";
@@ -1494,12 +2547,22 @@ int VSCore::setCpuLevel(int cpu) {
     return cpuLevel.exchange(cpu);
 }
 
+bool VSCore::getAutotune() const {
+    return autotune;
+}
+
+bool VSCore::setAutotune(int enable) {
+    if (enable >= 0)
+        autotune = !!enable;
+    return autotune;
+}
+
 VSPlugin::VSPlugin(VSCore *core)
-    : apiMajor(0), apiMinor(0), hasConfig(false), readOnly(false), compat(false), libHandle(0), core(core) {
+    : apiMajor(0), apiMinor(0), hasConfig(false), readOnly(false), compat(false), libHandle(0), core(core), lazy(false) {
 }
 
 VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath, VSCore *core)
-    : apiMajor(0), apiMinor(0), hasConfig(false), readOnly(false), compat(false), libHandle(0), core(core), fnamespace(forcedNamespace), id(forcedId) {
+    : apiMajor(0), apiMinor(0), hasConfig(false), readOnly(false), compat(false), libHandle(0), core(core), lazy(false), fnamespace(forcedNamespace), id(forcedId) {
 #ifdef VS_TARGET_OS_WINDOWS
     std::wstring wPath = utf16_from_utf8(relFilename);
     std::vector<wchar_t> fullPathBuffer(32767 + 1); // add 1 since msdn sucks at mentioning whether or not it includes the final null
@@ -1513,6 +2576,30 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
     for (auto &iter : filename)
         if (iter == '\\')
             iter = '/';
+#else
+    std::vector<char> fullPathBuffer(PATH_MAX + 1);
+    if (realpath(relFilename.c_str(), fullPathBuffer.data()))
+        filename = fullPathBuffer.data();
+    else
+        filename = relFilename;
+#endif
+
+    loadLibrary(relFilename, altSearchPath);
+}
+
+VSPlugin::VSPlugin(const PluginCacheEntry &entry, VSCore *core)
+    : apiMajor(entry.apiVersion >> 16), apiMinor(entry.apiVersion & 0xFFFF), hasConfig(true), readOnly(entry.readOnly), readOnlySet(entry.readOnly), compat(false), libHandle(0), core(core), lazy(true),
+    filename(entry.filename), fullname(entry.fullname), fnamespace(entry.fnamespace), id(entry.id) {
+    for (const auto &iter : entry.functions)
+        funcs.insert(std::make_pair(iter.first, VSFunction(iter.second, nullptr, nullptr)));
+}
+
+void VSPlugin::loadLibrary(const std::string &relFilename, bool altSearchPath) {
+#ifdef VS_TARGET_OS_WINDOWS
+    std::wstring wPath = utf16_from_utf8(filename);
+    for (auto &iter : wPath)
+        if (iter == L'/')
+            iter = L'\\';
 
     libHandle = LoadLibraryEx(wPath.c_str(), nullptr, altSearchPath ? 0 : (LOAD_LIBRARY_SEARCH_DEFAULT_DIRS | LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR));
 
@@ -1534,12 +2621,6 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
         throw VSException("No entry point found in " + relFilename);
     }
 #else
-    std::vector<char> fullPathBuffer(PATH_MAX + 1);
-    if (realpath(relFilename.c_str(), fullPathBuffer.data()))
-        filename = fullPathBuffer.data();
-    else
-        filename = relFilename;
-
     libHandle = dlopen(filename.c_str(), RTLD_LAZY);
 
     if (!libHandle) {
@@ -1579,6 +2660,62 @@ VSPlugin::VSPlugin(const std::string &relFilename, const std::string &forcedName
     }
 }
 
+void VSPlugin::load() {
+    std::lock_guard<std::mutex> lock(loadLock);
+    if (!lazy)
+        return;
+
+    // the cached registration is kept if the library turns out to be broken or different
+    std::string cachedId, cachedNamespace;
+    std::map<std::string, VSFunction> cachedFuncs;
+    std::swap(cachedId, id);
+    std::swap(cachedNamespace, fnamespace);
+    std::swap(cachedFuncs, funcs);
+    int cachedApiMajor = apiMajor;
+    int cachedApiMinor = apiMinor;
+    bool cachedReadOnly = readOnly;
+    hasConfig = false;
+    readOnly = false;
+
+    try {
+        loadLibrary(filename, false);
+        if (id != cachedId || fnamespace != cachedNamespace) {
+#ifdef VS_TARGET_OS_WINDOWS
+            FreeLibrary(libHandle);
+#else
+            dlclose(libHandle);
+#endif
+            libHandle = 0;
+            throw VSException("Plugin " + filename + " no longer matches the plugin cache");
+        }
+    } catch (VSException &) {
+        libHandle = 0;
+        id = cachedId;
+        fnamespace = cachedNamespace;
+        funcs = std::move(cachedFuncs);
+        apiMajor = cachedApiMajor;
+        apiMinor = cachedApiMinor;
+        readOnly = cachedReadOnly;
+        hasConfig = true;
+        throw;
+    }
+
+    lazy = false;
+}
+
+void VSPlugin::getCacheEntry(PluginCacheEntry &entry) {
+    std::lock_guard<std::mutex> lock(loadLock);
+    entry.filename = filename;
+    entry.id = id;
+    entry.fnamespace = fnamespace;
+    entry.fullname = fullname;
+    entry.apiVersion = (apiMajor << 16) | apiMinor;
+    entry.readOnly = readOnlySet;
+    entry.functions.clear();
+    for (const auto &iter : funcs)
+        entry.functions.push_back(std::make_pair(iter.first, iter.second.argString));
+}
+
 VSPlugin::~VSPlugin() {
 #ifdef VS_TARGET_OS_WINDOWS
     if (libHandle)
@@ -1664,6 +2801,9 @@ VSMap VSPlugin::invoke(const std::string &funcName, const VSMap &args) {
     VSMap v;
 
     try {
+        if (lazy)
+            load();
+
         if (funcs.count(funcName)) {
             const VSFunction &f = funcs[funcName];
             if (!compat && hasCompatNodes(args))
@@ -1673,7 +2813,7 @@ VSMap VSPlugin::invoke(const std::string &funcName, const VSMap &args) {
 
             std::set<std::string> remainingArgs;
             for (const auto &key : args.getStorage())
-                remainingArgs.insert(key.first);
+                remainingArgs.insert(key.first.name());
 
             for (const FilterArgument &fa : f.args) {
                 char c = vs_internal_vsapi.propGetType(&args, fa.name.c_str());
@@ -1704,8 +2844,29 @@ VSMap VSPlugin::invoke(const std::string &funcName, const VSMap &args) {
                 throw VSException(funcName + ": no argument(s) named " + s);
             }
 
+            bool recording = core->recordingGraph;
+            int64_t firstNewNodeId = recording ? core->getNextNodeId() : 0;
+
             f.func(&args, &v, f.functionData, core, getVSAPIInternal(apiMajor));
 
+            if (recording && !v.hasError()) {
+                PInvocation invocation;
+                for (const auto &iter : v.getStorage()) {
+                    if (iter.second.getType() != VSVariant::vNode)
+                        continue;
+                    for (size_t i = 0; i < iter.second.size(); i++) {
+                        const VSNodeRef &ref = iter.second.getValue<VSNodeRef>(i);
+                        // only nodes created by this call, a node that's passed through may be one of the arguments
+                        // or one of their inputs and recording the call for it would make it keep itself alive
+                        if (ref.clip->getId() < firstNewNodeId)
+                            continue;
+                        if (!invocation)
+                            invocation = std::make_shared<VSInvocation>(id, fnamespace, funcName, args);
+                        ref.clip->setInvocation(invocation, ref.index, iter.first.name(), static_cast<int>(i));
+                    }
+                }
+            }
+
             if (!compat && hasCompatNodes(v))
                 vsFatal("%s: illegal filter node returning a compat format detected, DO NOT USE THE COMPAT FORMATS IN NEW FILTERS", funcName.c_str());
 
@@ -1721,6 +2882,7 @@ VSMap VSPlugin::invoke(const std::string &funcName, const VSMap &args) {
 }
 
 VSMap VSPlugin::getFunctions() {
+    std::lock_guard<std::mutex> lock(loadLock);
     VSMap m;
     for (const auto & f : funcs) {
         std::string b = f.first + ";" + f.second.argString;
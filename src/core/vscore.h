@@ -23,6 +23,7 @@
 
 #include "VapourSynth.h"
 #include "vslog.h"
+#include "frametrace.h"
 #include <cstdlib>
 #include <stdexcept>
 #include <string>
@@ -37,7 +38,6 @@
 #include <mutex>
 #include <thread>
 #include <condition_variable>
-#include <random>
 #include <algorithm>
 #ifdef VS_TARGET_OS_WINDOWS
 #    define WIN32_LEAN_AND_MEAN
@@ -45,7 +45,6 @@
 #        define NOMINMAX
 #    endif
 #    include <windows.h>
-#    define VS_FRAME_POOL
 #else
 #    include <dlfcn.h>
 #endif
@@ -61,6 +60,8 @@ class VSFrame;
 struct VSCore;
 class VSCache;
 struct VSNode;
+struct PluginCacheEntry;
+class PluginCache;
 class VSThreadPool;
 class FrameContext;
 class ExtFunction;
@@ -96,12 +97,6 @@ public:
 
 // variant types
 typedef std::shared_ptr<std::string> VSMapData;
-typedef std::vector<int64_t> IntList;
-typedef std::vector<double> FloatList;
-typedef std::vector<VSMapData> DataList;
-typedef std::vector<VSNodeRef> NodeList;
-typedef std::vector<PVideoFrame> FrameList;
-typedef std::vector<PExtFunction> FuncList;
 
 class ExtFunction {
 private:
@@ -116,13 +111,46 @@ public:
     void call(const VSMap *in, VSMap *out);
 };
 
+// Map keys are interned once and afterwards identified by a small integer (atom) so maps can compare them
+// without looking at the string. Atoms are never freed and looking up existing keys doesn't take a lock.
+// When the table is full maps store new keys by name instead.
+class KeyAtoms {
+public:
+    // returns -1 if the key has never been interned
+    static int find(const char *key);
+    // returns -1 if there's no room left for another key
+    static int intern(const char *key);
+    static bool isValid(int atom);
+    static const std::string &name(int atom);
+};
+
+// Lists of values are reference counted and shared between copies of a map, they're copied when appended to
+struct VSVariantListBase {
+    std::atomic<int> refCount;
+    VSVariantListBase() : refCount(1) {}
+    virtual ~VSVariantListBase() {}
+    virtual VSVariantListBase *clone() const = 0;
+};
+
+template<typename T>
+struct VSVariantList : public VSVariantListBase {
+    std::vector<T> values;
+    VSVariantListBase *clone() const override {
+        VSVariantList<T> *l = new VSVariantList<T>();
+        l->values = values;
+        return l;
+    }
+};
+
 class VSVariant {
 public:
     enum VSVType { vUnset, vInt, vFloat, vData, vNode, vFrame, vMethod };
     VSVariant(VSVType vtype = vUnset);
     VSVariant(const VSVariant &v);
-    VSVariant(VSVariant &&v);
+    VSVariant(VSVariant &&v) noexcept;
     ~VSVariant();
+    VSVariant &operator=(const VSVariant &v);
+    VSVariant &operator=(VSVariant &&v) noexcept;
 
     size_t size() const;
     VSVType getType() const;
@@ -136,37 +164,72 @@ public:
 
     template<typename T>
     const T &getValue(size_t index) const {
-        return reinterpret_cast<std::vector<T>*>(storage)->at(index);
+        assert(index < internalSize);
+        return getArray<T>()[index];
     }
 
     template<typename T>
     const T *getArray() const {
-        return reinterpret_cast<std::vector<T>*>(storage)->data();
+        return static_cast<const VSVariantList<T> *>(list)->values.data();
     }
 
-    template<typename T>
-    void setArray(const T *val, size_t size) {
-        assert(val && !storage);
-        std::vector<T> *vect = new std::vector<T>(size);
-        if (size)
-            memcpy(vect->data(), val, size * sizeof(T));
-        internalSize = size;
-        storage = vect;
-    }
+    void setArray(const int64_t *val, size_t size);
+    void setArray(const double *val, size_t size);
 
 private:
     VSVType vtype;
     size_t internalSize;
-    void *storage;
+    // a single int or float is stored inline, everything else in a list
+    union {
+        int64_t intValue;
+        double floatValue;
+        VSVariantListBase *list;
+    };
 
-    void initStorage(VSVType t);
+    bool hasList() const;
+    void releaseList();
+    template<typename T>
+    std::vector<T> &writableValues();
+    template<typename T>
+    void appendValue(VSVType t, const T &val);
 };
 
+template<>
+inline const int64_t *VSVariant::getArray<int64_t>() const {
+    return internalSize > 1 ? static_cast<const VSVariantList<int64_t> *>(list)->values.data() : &intValue;
+}
+
+template<>
+inline const double *VSVariant::getArray<double>() const {
+    return internalSize > 1 ? static_cast<const VSVariantList<double> *>(list)->values.data() : &floatValue;
+}
+
+// The atom of a map key, or the name itself if it couldn't be interned
+class VSMapKey {
+private:
+    int atom;
+    std::shared_ptr<const std::string> uninterned;
+public:
+    explicit VSMapKey(int atom) : atom(atom) {}
+    explicit VSMapKey(const char *key) : atom(-1), uninterned(std::make_shared<const std::string>(key)) {}
+
+    int getAtom() const {
+        return atom;
+    }
+
+    const std::string &name() const {
+        return uninterned ? *uninterned : KeyAtoms::name(atom);
+    }
+};
+
+typedef std::pair<VSMapKey, VSVariant> VSMapEntry;
+
 class VSMapStorage {
 private:
     std::atomic<int> refCount;
 public:
-    std::map<std::string, VSVariant> data;
+    // sorted by key name, the atoms are stored to make lookups cheap
+    std::vector<VSMapEntry> data;
     bool error;
 
     VSMapStorage() : refCount(1), error(false) {}
@@ -190,6 +253,13 @@ public:
 struct VSMap {
 private:
     VSMapStorage *data;
+
+    // small maps are searched linearly by atom, bigger ones with a binary search by name
+    static const size_t linearSearchSize = 16;
+    size_t lowerBound(const std::string &name) const;
+    int indexOf(int key) const;
+    int indexOf(const char *key) const;
+    void insertEntry(int index, VSMapKey &&key, VSVariant &&v);
 public:
     VSMap() : data(new VSMapStorage()) {}
 
@@ -206,9 +276,9 @@ public:
     }
 
     VSMap &operator=(const VSMap &map) {
+        map.data->addRef();
         data->release();
         data = map.data;
-        data->addRef();
         return *this;
     }
 
@@ -220,36 +290,50 @@ public:
         }
     }
 
-    bool contains(const std::string &key) const {
-        return !!data->data.count(key);
+    bool contains(int key) const {
+        return indexOf(key) >= 0;
     }
 
-    VSVariant &at(const std::string &key) const {
-        return data->data.at(key);
+    bool contains(const char *key) const {
+        return indexOf(key) >= 0;
     }
 
-    VSVariant &operator[](const std::string &key) const {
-        // implicit creation is unwanted so make sure it doesn't happen by wrapping at() instead
-        return data->data.at(key);
+    VSVariant &at(int key) const {
+        int index = indexOf(key);
+        if (index < 0)
+            throw std::out_of_range("key not in map");
+        return data->data[index].second;
+    }
+
+    VSVariant &at(const char *key) const {
+        int index = indexOf(key);
+        if (index < 0)
+            throw std::out_of_range("key not in map");
+        return data->data[index].second;
     }
 
-    VSVariant *find(const std::string &key) const {
-        auto it = data->data.find(key);
-        return it == data->data.end() ? nullptr : &it->second;
+    VSVariant &operator[](const char *key) const {
+        // implicit creation is unwanted so make sure it doesn't happen by wrapping at() instead
+        return at(key);
     }
 
-    bool erase(const std::string &key) {
-        detach();
-        return data->data.erase(key) > 0;
+    VSVariant *find(int key) const {
+        int index = indexOf(key);
+        return index < 0 ? nullptr : &data->data[index].second;
     }
 
-    bool insert(const std::string &key, VSVariant &&v) {
-        detach();
-        data->data.erase(key);
-        data->data.insert(std::make_pair(key, v));
-        return true;
+    VSVariant *find(const char *key) const {
+        int index = indexOf(key);
+        return index < 0 ? nullptr : &data->data[index].second;
     }
 
+    bool erase(int key);
+    bool erase(const char *key);
+
+    // returns false if the key is -1
+    bool insert(int key, VSVariant &&v);
+    void insert(const char *key, VSVariant &&v);
+
     size_t size() const {
         return data->data.size();
     }
@@ -262,12 +346,10 @@ public:
     const char *key(int n) const {
         if (n >= static_cast<int>(size()))
             return nullptr;
-        auto iter = data->data.cbegin();
-        std::advance(iter, n);
-        return iter->first.c_str();
+        return data->data[n].first.name().c_str();
     }
 
-    const std::map<std::string, VSVariant> &getStorage() const {
+    const std::vector<VSMapEntry> &getStorage() const {
         return data->data;
     }
 
@@ -293,7 +375,7 @@ public:
 struct VSFrameRef {
     PVideoFrame frame;
     VSFrameRef(const PVideoFrame &frame) : frame(frame) {}
-    VSFrameRef(PVideoFrame &&frame) : frame(frame) {}
+    VSFrameRef(PVideoFrame &&frame) : frame(std::move(frame)) {}
 };
 
 struct VSNodeRef {
@@ -333,57 +415,148 @@ public:
 class MemoryUse {
 private:
     struct BlockHeader {
-        size_t size; // Size of memory allocation, minus header and padding.
+        size_t size; // Size of memory allocation, minus header and padding. Large page mappings are rounded up further.
         bool large : 1; // Memory is allocated with large pages.
     };
     static_assert(sizeof(BlockHeader) <= 16, "block header too large");
 
+    struct FreeBuffer {
+        uint8_t *buf;
+        uint64_t tick; // When the buffer was returned, used to trim the oldest buffers first.
+    };
+
+    // Unused buffers are kept in several independently locked pools that threads are spread over to reduce contention.
+    // Each pool has a list of all its buffers in the order they were returned and a stack of them for every size class.
+    struct BufferPool {
+        std::mutex mutex;
+        std::list<FreeBuffer> buffers;
+        std::map<size_t, std::vector<std::list<FreeBuffer>::iterator>> sizeClasses;
+    };
+
+    static const size_t numPools = 16;
+
     std::atomic<size_t> used;
-    size_t maxMemoryUse;
+    std::atomic<size_t> maxMemoryUse;
+    std::atomic<size_t> peakUsed;
+    std::atomic<size_t> peakOvershoot;
     bool freeOnZero;
-    bool largePageEnabled;
+    std::atomic<bool> largePageEnabled;
+    std::atomic<bool> limitEnforced;
     bool memoryWarningIssued;
-    std::multimap<size_t, uint8_t *> buffers;
-    size_t unusedBufferSize;
-    std::minstd_rand generator;
+    BufferPool pools[numPools];
+    std::atomic<size_t> unusedBufferSize;
+    std::atomic<size_t> scratchSize;
+    std::atomic<uint64_t> freeTicks;
+    std::atomic<int64_t> numFrames;
     std::mutex mutex;
 
     static bool largePageSupported();
     static size_t largePageSize();
+    static size_t largePageAllocationSize(size_t bytes);
+    static size_t sizeClass(size_t bytes);
+    BufferPool &poolForThread();
 
     // May allocate more than the requested amount.
     void *allocateLargePage(size_t bytes) const;
     void freeLargePage(void *ptr) const;
     void *allocateMemory(size_t bytes) const;
     void freeMemory(void *ptr) const;
-    bool isGoodFit(size_t requested, size_t actual) const;
+    static bool isGoodFit(size_t requested, size_t actual);
+    uint8_t *takeBuffer(BufferPool &pool, size_t size);
+    void trimBuffers();
 public:
     void add(size_t bytes);
     void subtract(size_t bytes);
+    void addScratch(size_t bytes);
+    void subtractScratch(size_t bytes);
     uint8_t *allocBuffer(size_t bytes);
     void freeBuffer(uint8_t *buf);
     size_t memoryUse();
     size_t getLimit();
+    size_t getUnusedBufferSize();
+    size_t getScratchSize();
+    void frameCreated();
+    void frameDestroyed();
+    int64_t getNumFrames();
     int64_t setMaxMemoryUse(int64_t bytes);
+    bool setLargePageEnabled(int enable);
+    bool setLimitEnforced(int enforce);
     bool isOverLimit();
+    // Over the limit with enforcement enabled, no new requests should be started
+    bool isThrottled();
+    void getLimitInfo(VSMemoryLimitInfo &info);
     void signalFree();
     MemoryUse();
     ~MemoryUse();
 };
 
+// Frame memory attributed to the node whose getframe function allocated it. Planes keep a reference
+// so the numbers stay correct when frames outlive the node.
+// The counters are only changed together under the lock so a frame moving between in flight and
+// cached is never seen half done, which would wrap one of them below zero.
+class NodeMemoryUse {
+private:
+    mutable std::mutex lock;
+    size_t inFlight;
+    size_t cached;
+    size_t peakInFlight;
+    size_t peakCached;
+    size_t peakTotal;
+    void updatePeaks();
+public:
+    NodeMemoryUse() : inFlight(0), cached(0), peakInFlight(0), peakCached(0), peakTotal(0) {}
+    void add(size_t bytes);
+    void subtract(size_t bytes, bool isCached);
+    void setCached(size_t bytes, bool isCached);
+    void getInfo(VSNodeMemoryInfo &info) const;
+};
+
+typedef std::shared_ptr<NodeMemoryUse> PNodeMemoryUse;
+
+// Time spent in a node's getframe function, only collected while profiling is enabled in the core.
+// When the node is freed the numbers are added to a profile per filter name so temporary filters aren't lost.
+struct NodeProfile {
+    // bucket 0 holds calls shorter than 1us, bucket i calls from 2^(i-1) to 2^i us and the last everything longer
+    static const int histogramSize = 20;
+    std::string name;
+    int64_t id;
+    std::atomic<int64_t> calls[4]; // indexed by activation reason with arError last
+    std::atomic<int64_t> frames;
+    std::atomic<int64_t> totalTime; // in nanoseconds
+    std::atomic<int64_t> maxTime;
+    std::atomic<int64_t> histogram[histogramSize];
+    std::atomic<bool> registered;
+    NodeProfile(const std::string &name, int64_t id);
+    void add(int activationReason, int64_t time, bool producedFrame);
+    void merge(const NodeProfile &other);
+    void reset();
+};
+
+typedef std::shared_ptr<NodeProfile> PNodeProfile;
+
 class VSPlaneData {
 private:
     std::atomic<int> refCount;
+    std::atomic<int> cacheRefs;
     MemoryUse &mem;
+    PNodeMemoryUse owner;
 public:
     uint8_t *data;
     const size_t size;
+    MemoryUse &getMemoryUse() const {
+        return mem;
+    }
     VSPlaneData(size_t dataSize, MemoryUse &mem);
     VSPlaneData(const VSPlaneData &d);
+    // copies height lines of rowSize bytes starting at offset in d into a new plane
+    VSPlaneData(const VSPlaneData &d, size_t offset, int srcStride, int dstStride, size_t rowSize, int height);
     ~VSPlaneData();
     bool unique();
     void addRef();
     void release();
+    void claim();
+    void cacheHold();
+    void cacheRelease();
 };
 
 class VSFrame {
@@ -393,7 +566,13 @@ private:
     int width;
     int height;
     int stride[3];
+    // frames can be views into other frames' planes so the data doesn't always start at the beginning
+    size_t offset[3];
     VSMap properties;
+    // the number of cache entries that can hand out the frame again, even if they only hold a weak reference
+    std::atomic<int> cacheEntries;
+
+    bool isView(int plane) const;
 public:
     static int alignment;
 
@@ -408,6 +587,11 @@ public:
     VSFrame(const VSFrame &f);
     ~VSFrame();
 
+    // views share the planes of the source frame, the plane data is copied when written to
+    static PVideoFrame cropView(const PVideoFrame &f, int left, int top, int width, int height);
+    static PVideoFrame fieldView(const PVideoFrame &f, int field);
+    static PVideoFrame weaveViews(const PVideoFrame &top, const PVideoFrame &bottom);
+
     VSMap &getProperties() {
         return properties;
     }
@@ -430,6 +614,19 @@ public:
     const uint8_t *getReadPtr(int plane) const;
     uint8_t *getWritePtr(int plane);
 
+    // used by caches to mark the planes as held so memory use can be split into cached and in-flight
+    void cacheHold();
+    void cacheRelease();
+    void addCacheEntry() {
+        cacheEntries++;
+    }
+    void removeCacheEntry() {
+        cacheEntries--;
+    }
+    int getCacheEntries() const {
+        return cacheEntries;
+    }
+
 #ifdef VS_FRAME_GUARD
     bool verifyGuardPattern();
 #endif
@@ -469,9 +666,23 @@ public:
     FrameContext(int n, int index, VSNodeRef *node, VSFrameDoneCallback frameDone, void *userData, bool lockOnOutput = true);
 };
 
+// The plugin function call that returned a node, kept while graph recording is enabled so the graph can be saved and
+// created again without the script
+struct VSInvocation {
+    std::string pluginId;
+    std::string pluginNamespace;
+    std::string funcName;
+    VSMap args;
+    VSInvocation(const std::string &pluginId, const std::string &pluginNamespace, const std::string &funcName, const VSMap &args) : pluginId(pluginId), pluginNamespace(pluginNamespace), funcName(funcName), args(args) {}
+};
+
+typedef std::shared_ptr<VSInvocation> PInvocation;
+
 struct VSNode {
     friend class VSThreadPool;
     friend struct VSCore;
+    friend class FrameTracer;
+    friend class ScratchArena;
 private:
     void *instanceData;
     std::string name;
@@ -496,6 +707,21 @@ private:
     std::mutex concurrentFramesMutex;
     std::set<int> concurrentFrames;
 
+    PNodeMemoryUse memoryUse;
+    PNodeProfile profile;
+    // the last trace the name was recorded in
+    std::atomic<unsigned> traceGeneration;
+
+    int64_t id;
+    // the clips passed as arguments when the filter was created, they aren't kept alive by this
+    std::vector<std::pair<std::weak_ptr<VSNode>, int>> inputs;
+
+    VSFilterHints hints;
+
+    // the first plugin function call that returned the node and the key and position each output was returned at
+    PInvocation invocation;
+    std::vector<std::pair<std::string, int>> invocationOutputs;
+
     PVideoFrame getFrameInternal(int n, int activationReason, VSFrameContext &frameCtx);
 public:
     VSNode(const VSMap *in, VSMap *out, const std::string &name, VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree free, VSFilterMode filterMode, int flags, void *instanceData, int apiMajor, VSCore *core);
@@ -507,6 +733,7 @@ public:
     }
 
     void getFrame(const PFrameContext &ct);
+    void prefetch(VSNodeRef *node, int first, int last, int priority);
 
     const VSVideoInfo &getVideoInfo(int index);
 
@@ -520,12 +747,33 @@ public:
         return name;
     }
 
+    int64_t getId() const {
+        return id;
+    }
+
     // to get around encapsulation a bit, more elegant than making everything friends in this case
     void reserveThread();
     void releaseThread();
     bool isWorkerThread();
 
     void notifyCache(bool needMemory);
+    void reserveCache(int frames);
+    bool releaseFrameForModify(int n, const PVideoFrame &f);
+
+    void getMemoryInfo(VSNodeMemoryInfo &info);
+    void getNodeInfo(VSNodeInfo &info) const;
+    void setHints(const VSFilterHints &hints);
+    // returns nullptr if the input has already been freed
+    VSNodeRef *getInput(int index) const;
+    void setInvocation(const PInvocation &invocation, int index, const std::string &key, int position);
+    // returns false if the output wasn't returned by a plugin function
+    bool getInvocation(int index, PInvocation &invocation, std::string &key, int &position) const;
+    // returns nullptr unless the filter uses getFrame, lets internal filters recognize each other
+    void *getInstanceData(VSFilterGetFrame getFrame) const {
+        return filterGetFrame == getFrame ? instanceData : nullptr;
+    }
+    static const PNodeMemoryUse &getCurrentMemoryUse();
+    static bool isInGetFrame();
 };
 
 struct VSFrameContext {
@@ -534,6 +782,20 @@ struct VSFrameContext {
     VSFrameContext(PFrameContext &ctx) : ctx(ctx) {}
 };
 
+// Per thread memory for temporary buffers in getframe functions. Everything is released at once when the
+// getframe call returns. The arena grows to fit the biggest call seen so far up to maxArenaSize, anything past
+// that is allocated separately for the call, and it shrinks again when the recent calls need much less.
+// All of it is counted as used memory of the core.
+class ScratchArena {
+public:
+    static const size_t alignment = 64;
+    static const size_t maxArenaSize = 8 * 1024 * 1024;
+    static const unsigned trimInterval = 64;
+    static void *alloc(size_t bytes);
+    static void reset();
+    static void freeThreadArena();
+};
+
 class VSThreadPool {
     friend struct VSCore;
 private:
@@ -542,6 +804,8 @@ private:
     std::mutex callbackLock;
     std::map<std::thread::id, std::thread *> allThreads;
     std::list<PFrameContext> tasks;
+    // top level requests held back while the enforced memory limit is exceeded, started in request order
+    std::list<PFrameContext> deferred;
     std::map<NodeOutputKey, PFrameContext> allContexts;
     std::condition_variable newWork;
     std::condition_variable allIdle;
@@ -551,13 +815,17 @@ private:
     unsigned maxThreads;
     std::atomic<bool> stopThreads;
     std::atomic<unsigned> ticks;
+    std::atomic<int64_t> numDeferred;
     int getNumAvailableThreads();
     void wakeThread();
     void notifyCaches(bool needMemory);
     void startInternal(const PFrameContext &context);
+    void startDeferred();
     void spawnThread();
     static void runTasks(VSThreadPool *owner, std::atomic<bool> &stop);
     static bool taskCmp(const PFrameContext &a, const PFrameContext &b);
+    static bool throttledTaskCmp(const PFrameContext &a, const PFrameContext &b);
+    static void VS_CC prefetchFrameDone(void *userData, const VSFrameRef *f, int n, VSNodeRef *node, const char *errorMsg);
 public:
     VSThreadPool(VSCore *core, int threads);
     ~VSThreadPool();
@@ -566,6 +834,9 @@ public:
     int threadCount();
     int setThreadCount(int threads);
     void start(const PFrameContext &context);
+    void prefetch(VSNodeRef *node, int first, int last, int priority);
+    void getDeferredInfo(int64_t &total, int64_t &waiting);
+    void getQueueInfo(int &active, int &idle, int &queued, int &contexts);
     void releaseThread();
     void reserveThread();
     bool isWorkerThread();
@@ -599,6 +870,11 @@ private:
     std::map<std::string, VSFunction> funcs;
     std::mutex registerFunctionLock;
     VSCore *core;
+    // registered from the plugin cache, the library is only loaded when a function is invoked
+    std::atomic<bool> lazy;
+    std::mutex loadLock;
+    void loadLibrary(const std::string &relFilename, bool altSearchPath);
+    void load();
 public:
     std::string filename;
     std::string fullname;
@@ -606,6 +882,7 @@ public:
     std::string id;
     explicit VSPlugin(VSCore *core);
     VSPlugin(const std::string &relFilename, const std::string &forcedNamespace, const std::string &forcedId, bool altSearchPath, VSCore *core);
+    VSPlugin(const PluginCacheEntry &entry, VSCore *core);
     ~VSPlugin();
     void lock() {
         readOnly = true;
@@ -617,6 +894,7 @@ public:
     void registerFunction(const std::string &name, const std::string &args, VSPublicFunction argsFunc, void *functionData);
     VSMap invoke(const std::string &funcName, const VSMap &args);
     VSMap getFunctions();
+    void getCacheEntry(PluginCacheEntry &entry);
 };
 
 struct VSCore {
@@ -640,18 +918,30 @@ private:
     std::mutex cacheLock;
 
     std::atomic_int cpuLevel;
+    std::atomic<bool> autotune;
+    std::atomic<int64_t> nodeIdCounter;
+
+    std::mutex profileLock;
+    // by node id, freed nodes are combined by name with an id of -1
+    std::map<int64_t, PNodeProfile> profiles;
+    std::map<std::string, PNodeProfile> freedProfiles;
 
     ~VSCore();
 
     void registerFormats();
 #ifdef VS_TARGET_OS_WINDOWS
-    bool loadAllPluginsInPath(const std::wstring &path, const std::wstring &filter);
+    bool loadAllPluginsInPath(const std::wstring &path, const std::wstring &filter, PluginCache &cache);
 #else
-    bool loadAllPluginsInPath(const std::string &path, const std::string &filter);
+    bool loadAllPluginsInPath(const std::string &path, const std::string &filter, PluginCache &cache);
 #endif
+    void addPlugin(VSPlugin *p);
 public:
     VSThreadPool *threadPool;
     MemoryUse *memory;
+    std::atomic<bool> profiling;
+    // plugin function calls are only recorded for saveGraph() when enabled, the arguments keep their clips alive
+    std::atomic<bool> recordingGraph;
+    FrameTracer tracer;
 
     PVideoFrame newVideoFrame(const VSFormat *f, int width, int height, const VSFrame *propSrc);
     PVideoFrame newVideoFrame(const VSFormat *f, int width, int height, const VSFrame * const *planeSrc, const int *planes, const VSFrame *propSrc);
@@ -667,6 +957,8 @@ public:
 
     int getCpuLevel() const;
     int setCpuLevel(int cpu);
+    bool getAutotune() const;
+    bool setAutotune(int enable);
 
     VSMap getPlugins();
     VSPlugin *getPluginById(const std::string &identifier);
@@ -674,10 +966,20 @@ public:
 
     const VSCoreInfo &getCoreInfo();
     void getCoreInfo2(VSCoreInfo &info);
+    void getMemoryLimitInfo(VSMemoryLimitInfo &info);
+    void getStats(VSMap &out);
+
+    bool setGraphRecording(int enable);
+    bool setProfiling(int enable);
+    void addProfile(const PNodeProfile &profile);
+    void removeProfile(const PNodeProfile &profile);
+    void getProfile(VSMap &out, bool reset);
 
     void functionInstanceCreated();
     void functionInstanceDestroyed();
     void filterInstanceCreated();
+    int64_t createNodeId();
+    int64_t getNextNodeId() const;
     void filterInstanceDestroyed();
     void destroyFilterInstance(VSNode *node);
 
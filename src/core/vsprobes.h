@@ -0,0 +1,49 @@
+/*
+* Copyright (c) 2012-2020 Fredrik Mellbin
+*
+* This file is part of VapourSynth.
+*
+* VapourSynth is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public
+* License as published by the Free Software Foundation; either
+* version 2.1 of the License, or (at your option) any later version.
+*
+* VapourSynth is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with VapourSynth; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef VSPROBES_H
+#define VSPROBES_H
+
+// USDT probes in the provider "vapoursynth" for attaching bpftrace, perf or systemtap to a running process.
+// A probe is a single nop until something attaches to it. Without --enable-usdt the arguments aren't even
+// evaluated. Double underscores in the names become dashes, for example task__start is task-start.
+//
+//   task__start, task__end        (const char *filter, int n, int activation reason)
+//   request__enqueue              (const char *filter, int n) a new frame request was queued
+//   request__dedupe               (const char *filter, int n) a request was merged with one already in progress
+//   frame__return                 (const char *filter, int n, const char *error message or null)
+//   buffer__alloc                 (size_t requested bytes, size_t allocated bytes, int reused from the pool)
+//   buffer__free                  (size_t allocated bytes)
+//   cache__hit                    (const char *cached filter, int n, int frame was brought back from the history)
+//   cache__miss                   (const char *cached filter, int n)
+//   cache__resize                 (const char *cached filter, int old size, int new size) in frames
+
+#ifdef VS_USDT_PROBES
+#include <sys/sdt.h>
+#define VS_PROBE1(name, a) DTRACE_PROBE1(vapoursynth, name, a)
+#define VS_PROBE2(name, a, b) DTRACE_PROBE2(vapoursynth, name, a, b)
+#define VS_PROBE3(name, a, b, c) DTRACE_PROBE3(vapoursynth, name, a, b, c)
+#else
+#define VS_PROBE1(name, a) do {} while (0)
+#define VS_PROBE2(name, a, b) do {} while (0)
+#define VS_PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif // VSPROBES_H
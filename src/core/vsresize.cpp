@@ -805,7 +805,7 @@ class vszimg {
         propagate_if_present(m_frame_params.chromaloc, &dst_format->chroma_location);
     }
 
-    const VSFrameRef *real_get_frame(const VSFrameRef *src_frame, VSCore *core, const VSAPI *vsapi) {
+    const VSFrameRef *real_get_frame(const VSFrameRef *src_frame, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
         VSFrameRef *dst_frame = nullptr;
         vszimgxx::zimage_format src_format, dst_format;
 
@@ -865,34 +865,24 @@ class vszimg {
                 dst_format_b.field_parity = ZIMG_FIELD_BOTTOM;
                 std::shared_ptr<graph_data> graph_b = get_graph_data(src_format_b, dst_format_b);
 
-                std::unique_ptr<void, decltype(&vs_aligned_free)> tmp{
-                    vs_aligned_malloc(std::max(graph_t->graph.get_tmp_size(), graph_b->graph.get_tmp_size()), 64),
-                    vs_aligned_free
-                };
-                if (!tmp)
-                    throw std::bad_alloc{};
+                void *tmp = vsapi->allocScratch(std::max(graph_t->graph.get_tmp_size(), graph_b->graph.get_tmp_size()), frameCtx);
 
                 unpack_callback unpack_cb_t(graph_t->graph, src_frame, src_format_t, src_vsformat, true, core, vsapi);
                 unpack_callback unpack_cb_b(graph_b->graph, src_frame, src_format_b, src_vsformat, true, core, vsapi);
                 pack_callback pack_cb_t(graph_t->graph, dst_frame, dst_format_t, dst_vsformat, true, core, vsapi);
                 pack_callback pack_cb_b(graph_b->graph, dst_frame, dst_format_b, dst_vsformat, true, core, vsapi);
 
-                graph_t->graph.process(unpack_cb_t.buffer(), pack_cb_t.buffer(), tmp.get(), unpack_cb_t.callback(), &unpack_cb_t, pack_cb_t.callback(), &pack_cb_t);
-                graph_b->graph.process(unpack_cb_b.buffer(), pack_cb_b.buffer(), tmp.get(), unpack_cb_b.callback(), &unpack_cb_b, pack_cb_b.callback(), &pack_cb_b);
+                graph_t->graph.process(unpack_cb_t.buffer(), pack_cb_t.buffer(), tmp, unpack_cb_t.callback(), &unpack_cb_t, pack_cb_t.callback(), &pack_cb_t);
+                graph_b->graph.process(unpack_cb_b.buffer(), pack_cb_b.buffer(), tmp, unpack_cb_b.callback(), &unpack_cb_b, pack_cb_b.callback(), &pack_cb_b);
             } else {
                 std::shared_ptr<graph_data> graph = get_graph_data(src_format, dst_format);
 
                 unpack_callback unpack_cb{ graph->graph, src_frame, src_format, src_vsformat, false, core, vsapi };
                 pack_callback pack_cb{ graph->graph, dst_frame, dst_format, dst_vsformat, false, core, vsapi };
 
-                std::unique_ptr<void, decltype(&vs_aligned_free)> tmp{
-                    vs_aligned_malloc(graph->graph.get_tmp_size(), 64),
-                    vs_aligned_free
-                };
-                if (!tmp)
-                    throw std::bad_alloc{};
+                void *tmp = vsapi->allocScratch(graph->graph.get_tmp_size(), frameCtx);
 
-                graph->graph.process(unpack_cb.buffer(), pack_cb.buffer(), tmp.get(), unpack_cb.callback(), &unpack_cb, pack_cb.callback(), &pack_cb);
+                graph->graph.process(unpack_cb.buffer(), pack_cb.buffer(), tmp, unpack_cb.callback(), &unpack_cb, pack_cb.callback(), &pack_cb);
             }
 
             VSMap *dst_props = vsapi->getFramePropsRW(dst_frame);
@@ -941,7 +931,7 @@ public:
                 vsapi->requestFrameFilter(n, m_node, frameCtx);
             } else if (activationReason == arAllFramesReady) {
                 src_frame = vsapi->getFrameFilter(n, m_node, frameCtx);
-                ret = real_get_frame(src_frame, core, vsapi);
+                ret = real_get_frame(src_frame, frameCtx, core, vsapi);
             }
         } catch (const vszimgxx::zerror &e) {
             std::string errmsg = "Resize error " + std::to_string(e.code) + ": " + e.msg;
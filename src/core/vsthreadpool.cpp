@@ -19,6 +19,7 @@
 */
 
 #include "vscore.h"
+#include "vsprobes.h"
 #include <cassert>
 #include <bitset>
 #ifdef VS_TARGET_CPU_X86
@@ -58,24 +59,45 @@ int VSThreadPool::getNumAvailableThreads() {
     return nthreads;
 }
 
+static void traceInstant(VSCore *core, TraceEventType type, VSNode *node, int n) {
+    if (core->tracer.isEnabled()) {
+        int64_t now = core->tracer.now();
+        core->tracer.add(type, node, n, 0, now, now);
+    }
+}
+
 bool VSThreadPool::taskCmp(const PFrameContext &a, const PFrameContext &b) {
     return (a->reqOrder < b->reqOrder) || (a->reqOrder == b->reqOrder && a->n < b->n);
 }
 
+bool VSThreadPool::throttledTaskCmp(const PFrameContext &a, const PFrameContext &b) {
+    // tasks delivering a finished frame or error let contexts complete and release memory so they go first
+    bool aCompletes = a->returnedFrame || a->hasError();
+    bool bCompletes = b->returnedFrame || b->hasError();
+    if (aCompletes != bCompletes)
+        return aCompletes;
+    return taskCmp(a, b);
+}
+
 void VSThreadPool::runTasks(VSThreadPool *owner, std::atomic<bool> &stop) {
 #ifdef VS_TARGET_OS_WINDOWS
     if (!vs_isSSEStateOk())
         vsFatal("Bad SSE state detected after creating new thread");
 #endif
 
+    FrameTracer::setWorkerThread();
+    FrameTracer &tracer = owner->core->tracer;
     std::unique_lock<std::mutex> lock(owner->lock);
 
     while (true) {
         bool ranTask = false;
 
+        if (!owner->deferred.empty())
+            owner->startDeferred();
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 // Go through all tasks from the top (oldest) and process the first one possible
-        owner->tasks.sort(taskCmp);
+        owner->tasks.sort(owner->core->memory->isThrottled() ? throttledTaskCmp : taskCmp);
 
         for (auto iter = owner->tasks.begin(); iter != owner->tasks.end(); ++iter) {
             FrameContext *mainContext = iter->get();
@@ -114,38 +136,49 @@ void VSThreadPool::runTasks(VSThreadPool *owner, std::atomic<bool> &stop) {
             bool parallelRequestsNeedsUnlock = false;
             if (filterMode == fmUnordered || filterMode == fmUnorderedLinear) {
                 // already busy?
-                if (!clip->serialMutex.try_lock())
+                if (!clip->serialMutex.try_lock()) {
+                    traceInstant(owner->core, teBusy, clip, mainContext->n);
                     continue;
+                }
             } else if (filterMode == fmSerial) {
                 // already busy?
-                if (!clip->serialMutex.try_lock())
+                if (!clip->serialMutex.try_lock()) {
+                    traceInstant(owner->core, teBusy, clip, mainContext->n);
                     continue;
+                }
                 // no frame in progress?
                 if (clip->serialFrame == -1) {
                     clip->serialFrame = mainContext->n;
                 // another frame already in progress?
                 } else if (clip->serialFrame != mainContext->n) {
                     clip->serialMutex.unlock();
+                    traceInstant(owner->core, teBusy, clip, mainContext->n);
                     continue;
                 }
                 // continue processing the already started frame
             } else if (filterMode == fmParallel) {
                 std::lock_guard<std::mutex> lock(clip->concurrentFramesMutex);
                 // is the filter already processing another call for this frame? if so move along
-                if (!clip->concurrentFrames.insert(mainContext->n).second)
+                if (!clip->concurrentFrames.insert(mainContext->n).second) {
+                    traceInstant(owner->core, teBusy, clip, mainContext->n);
                     continue;
+                }
             } else if (filterMode == fmParallelRequests) {
                 std::lock_guard<std::mutex> lock(clip->concurrentFramesMutex);
                 // do we need the serial lock since all frames will be ready this time?
                 // check if we're in the arAllFramesReady state so we need additional locking
                 if (mainContext->numFrameRequests == 1) {
-                    if (!clip->serialMutex.try_lock())
+                    if (!clip->serialMutex.try_lock()) {
+                        traceInstant(owner->core, teBusy, clip, mainContext->n);
                         continue;
+                    }
                     parallelRequestsNeedsUnlock = true;
                 } else {
                     // is the filter already processing another call for this frame? if so move along
-                    if (!clip->concurrentFrames.insert(mainContext->n).second)
+                    if (!clip->concurrentFrames.insert(mainContext->n).second) {
+                        traceInstant(owner->core, teBusy, clip, mainContext->n);
                         continue;
+                    }
                 }
             }
 
@@ -178,9 +211,12 @@ void VSThreadPool::runTasks(VSThreadPool *owner, std::atomic<bool> &stop) {
                 else
                     ar = arAllFramesReady;
 
-                mainContext->availableFrames.insert(std::make_pair(NodeOutputKey(leafContext->clip, leafContext->n, leafContext->index), leafContext->returnedFrame));
+                mainContext->availableFrames.insert(std::make_pair(NodeOutputKey(leafContext->clip, leafContext->n, leafContext->index), std::move(leafContext->returnedFrame)));
                 mainContext->lastCompletedN = leafContext->n;
                 mainContext->lastCompletedNode = leafContext->node;
+                // the finished context can still hold references to the frame which would prevent getFrameFilterForModify from working in place
+                leafContextRef.reset();
+                leafContext = nullptr;
             }
 
             bool hasExistingRequests = !!mainContext->numFrameRequests;
@@ -198,8 +234,15 @@ void VSThreadPool::runTasks(VSThreadPool *owner, std::atomic<bool> &stop) {
             vsWarning("Entering: %s Frame: %d Index: %d AR: %d Req: %d", mainContext->clip->name.c_str(), mainContext->n, mainContext->index, (int)ar, (int)mainContext->reqOrder);
 #endif
             PVideoFrame f;
-            if (!skipCall)
+            if (!skipCall) {
+                bool tracing = tracer.isEnabled();
+                int64_t start = tracing ? tracer.now() : 0;
+                VS_PROBE3(task__start, clip->name.c_str(), mainContext->n, static_cast<int>(ar));
                 f = clip->getFrameInternal(mainContext->n, ar, externalFrameCtx);
+                VS_PROBE3(task__end, clip->name.c_str(), mainContext->n, static_cast<int>(ar));
+                if (tracing)
+                    tracer.add(teRun, clip, mainContext->n, ar, start, tracer.now());
+            }
             ranTask = true;
 #ifdef VS_FRAME_REQ_DEBUG
             vsWarning("Exiting: %s Frame: %d Index: %d AR: %d Req: %d", mainContext->clip->name.c_str(), mainContext->n, mainContext->index, (int)ar, (int)mainContext->reqOrder);
@@ -302,14 +345,20 @@ void VSThreadPool::runTasks(VSThreadPool *owner, std::atomic<bool> &stop) {
             if (owner->idleThreads == owner->allThreads.size())
                 owner->allIdle.notify_one();
 
+            bool tracing = tracer.isEnabled();
+            int64_t start = tracing ? tracer.now() : 0;
             owner->newWork.wait(lock);
+            if (tracing)
+                tracer.add(teIdle, nullptr, -1, 0, start, tracer.now());
             --owner->idleThreads;
             ++owner->activeThreads;
         }
     }
+
+    ScratchArena::freeThreadArena();
 }
 
-VSThreadPool::VSThreadPool(VSCore *core, int threads) : core(core), activeThreads(0), idleThreads(0), reqCounter(0), stopThreads(false), ticks(0) {
+VSThreadPool::VSThreadPool(VSCore *core, int threads) : core(core), activeThreads(0), idleThreads(0), reqCounter(0), stopThreads(false), ticks(0), numDeferred(0) {
     setThreadCount(threads);
 }
 
@@ -361,7 +410,103 @@ void VSThreadPool::start(const PFrameContext &context) {
     assert(context);
     std::lock_guard<std::mutex> l(lock);
     context->reqOrder = ++reqCounter;
-    startInternal(context);
+    // hold back new work while over the enforced limit, unless nothing is running that could free memory,
+    // requests made from inside a getframe function may be waited on by a running context so they're never held back
+    if (VSNode::isInGetFrame() || (deferred.empty() && (allContexts.empty() || !core->memory->isThrottled()))) {
+        startInternal(context);
+    } else {
+        deferred.push_back(context);
+        startDeferred();
+        if (!deferred.empty() && deferred.back() == context)
+            ++numDeferred;
+    }
+}
+
+void VSThreadPool::startDeferred() {
+    while (!deferred.empty() && (allContexts.empty() || !core->memory->isThrottled())) {
+        PFrameContext context = std::move(deferred.front());
+        deferred.pop_front();
+        startInternal(context);
+    }
+}
+
+void VSThreadPool::getDeferredInfo(int64_t &total, int64_t &waiting) {
+    std::lock_guard<std::mutex> l(lock);
+    total = numDeferred;
+    waiting = deferred.size();
+}
+
+void VSThreadPool::getQueueInfo(int &active, int &idle, int &queued, int &contexts) {
+    std::lock_guard<std::mutex> l(lock);
+    active = activeThreads;
+    idle = idleThreads;
+    queued = static_cast<int>(tasks.size());
+    contexts = static_cast<int>(allContexts.size());
+}
+
+// prefetch requests are queued after everything else so they only use otherwise idle threads
+static const uintptr_t prefetchReqOrderBase = UINTPTR_MAX - 255;
+
+struct PrefetchWindow {
+    VSNodeRef node;
+    std::atomic<int> pending;
+    PrefetchWindow(const VSNodeRef &node, int pending) : node(node), pending(pending) {}
+};
+
+void VS_CC VSThreadPool::prefetchFrameDone(void *userData, const VSFrameRef *f, int n, VSNodeRef *node, const char *errorMsg) {
+    PrefetchWindow *window = static_cast<PrefetchWindow *>(userData);
+    // the frame itself is only wanted for its side effect of ending up in the caches
+    delete f;
+    if (--window->pending == 0)
+        delete window;
+}
+
+void VSThreadPool::prefetch(VSNodeRef *node, int first, int last, int priority) {
+    int numFrames = node->clip->getVideoInfo(node->index).numFrames;
+    first = std::max(first, 0);
+    last = std::min(last, numFrames - 1);
+    priority = std::min(std::max(priority, 0), 255);
+
+    // make sure the whole window fits if the node is an automatically sized cache
+    if (first <= last)
+        node->clip->reserveCache(last - first + 1);
+
+    std::vector<PrefetchWindow *> cancelled;
+
+    {
+        std::lock_guard<std::mutex> l(lock);
+
+        // cancel the requests of the previous window for the same output that haven't been started yet,
+        // requests already being processed or that other requests are waiting on are left alone
+        for (auto iter = tasks.begin(); iter != tasks.end();) {
+            FrameContext *ctx = iter->get();
+            if (ctx->frameDone == prefetchFrameDone && ctx->clip == node->clip.get() && ctx->index == node->index
+                && !ctx->returnedFrame && !ctx->hasError() && !ctx->numFrameRequests && !ctx->notificationChain) {
+                auto ctxIter = allContexts.find(NodeOutputKey(ctx->clip, ctx->n, ctx->index));
+                if (ctxIter != allContexts.end() && ctxIter->second.get() == ctx)
+                    allContexts.erase(ctxIter);
+                PrefetchWindow *window = static_cast<PrefetchWindow *>(ctx->userData);
+                if (--window->pending == 0)
+                    cancelled.push_back(window);
+                iter = tasks.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+
+        // prefetching is speculative so don't add to the memory use when it's already too high
+        if (first <= last && !core->memory->isThrottled()) {
+            PrefetchWindow *window = new PrefetchWindow(*node, last - first + 1);
+            for (int i = first; i <= last; i++) {
+                PFrameContext ctx(std::make_shared<FrameContext>(i, node->index, &window->node, prefetchFrameDone, window, false));
+                ctx->reqOrder = prefetchReqOrderBase + (255 - priority);
+                startInternal(ctx);
+            }
+        }
+    }
+
+    for (auto window : cancelled)
+        delete window;
 }
 
 void VSThreadPool::returnFrame(const PFrameContext &rCtx, const PVideoFrame &f) {
@@ -371,11 +516,18 @@ void VSThreadPool::returnFrame(const PFrameContext &rCtx, const PVideoFrame &f)
     // AND so that slow callbacks will only block operations in this thread, not all the others
     lock.unlock();
     VSFrameRef *ref = new VSFrameRef(f);
+    VS_PROBE3(frame__return, rCtx->clip->getName().c_str(), rCtx->n, static_cast<const char *>(nullptr));
+    bool tracing = core->tracer.isEnabled();
+    // the callback may free the last reference to the node so it has to be registered before it runs
+    int64_t nodeId = tracing ? core->tracer.registerNode(rCtx->clip) : -1;
+    int64_t start = tracing ? core->tracer.now() : 0;
     if (outputLock)
         callbackLock.lock();
     rCtx->frameDone(rCtx->userData, ref, rCtx->n, rCtx->node, nullptr);
     if (outputLock)
         callbackLock.unlock();
+    if (tracing)
+        core->tracer.add(teOutput, nodeId, rCtx->n, 0, start, core->tracer.now());
     lock.lock();
 }
 
@@ -385,11 +537,18 @@ void VSThreadPool::returnFrame(const PFrameContext &rCtx, const std::string &err
     // we need to unlock here so the callback may request more frames without causing a deadlock
     // AND so that slow callbacks will only block operations in this thread, not all the others
     lock.unlock();
+    VS_PROBE3(frame__return, rCtx->clip->getName().c_str(), rCtx->n, errMsg.c_str());
+    bool tracing = core->tracer.isEnabled();
+    // the callback may free the last reference to the node so it has to be registered before it runs
+    int64_t nodeId = tracing ? core->tracer.registerNode(rCtx->clip) : -1;
+    int64_t start = tracing ? core->tracer.now() : 0;
     if (outputLock)
         callbackLock.lock();
     rCtx->frameDone(rCtx->userData, nullptr, rCtx->n, rCtx->node, errMsg.c_str());
     if (outputLock)
         callbackLock.unlock();
+    if (tracing)
+        core->tracer.add(teOutput, nodeId, rCtx->n, 0, start, core->tracer.now());
     lock.lock();
 }
 
@@ -419,12 +578,15 @@ void VSThreadPool::startInternal(const PFrameContext &context) {
         if (context->upstreamContext)
             ++context->upstreamContext->numFrameRequests;
 
+        traceInstant(core, teRequest, context->clip, context->n);
+
         NodeOutputKey p(context->clip, context->n, context->index);
 
         if (allContexts.count(p)) {
             PFrameContext &ctx = allContexts[p];
             assert(context->clip == ctx->clip && context->n == ctx->n && context->index == ctx->index);
 
+            VS_PROBE2(request__dedupe, context->clip->getName().c_str(), context->n);
             if (ctx->returnedFrame) {
                 // special case where the requested frame is encountered "by accident"
                 context->returnedFrame = ctx->returnedFrame;
@@ -437,6 +599,7 @@ void VSThreadPool::startInternal(const PFrameContext &context) {
             }
         } else {
             // create a new context and append it to the tasks
+            VS_PROBE2(request__enqueue, context->clip->getName().c_str(), context->n);
             allContexts[p] = context;
             tasks.push_back(context);
         }
@@ -126,6 +126,12 @@ cdef extern from "include/VapourSynth.h" nogil:
         nfIsCache
         nfMakeLinear
 
+    enum VSFilterHintFlags:
+        fhPure
+        fhPointwise
+        fhCheap
+        fhPassThrough
+
     enum VSGetPropErrors:
         peUnset
         peType
@@ -144,6 +150,36 @@ cdef extern from "include/VapourSynth.h" nogil:
         int64_t maxFramebufferSize
         int64_t usedFramebufferSize
 
+    struct VSNodeMemoryInfo:
+        int64_t inFlightBytes
+        int64_t cachedBytes
+        int64_t peakInFlightBytes
+        int64_t peakCachedBytes
+        int64_t peakTotalBytes
+
+    struct VSFilterHints:
+        int flags
+        int spatialRadius
+        int temporalRadius
+        int untouchedPlanes
+
+    struct VSNodeInfo:
+        const char *name
+        int64_t id
+        int filterMode
+        int flags
+        int numOutputs
+        int numInputs
+        VSFilterHints hints
+
+    struct VSMemoryLimitInfo:
+        int64_t usedBytes
+        int64_t limitBytes
+        int64_t peakUsedBytes
+        int64_t peakOvershootBytes
+        int64_t deferredRequests
+        int64_t waitingRequests
+
     struct VSVideoInfo:
         VSFormat *format
         int width
@@ -264,4 +300,37 @@ cdef extern from "include/VapourSynth.h" nogil:
         int removeMessageHandler(int id) nogil
         void getCoreInfo2(VSCore *core, VSCoreInfo *info) nogil
 
+        void prefetch(VSNodeRef *node, int first, int last, int priority) nogil
+        int setLargePages(int enable, VSCore *core) nogil
+        void getNodeMemoryInfo(VSNodeRef *node, VSNodeMemoryInfo *info) nogil
+        void *allocScratch(size_t bytes, VSFrameContext *frameCtx) nogil
+        VSFrameRef *getFrameFilterForModify(int n, VSNodeRef *node, VSFrameContext *frameCtx) nogil
+        VSFrameRef *cropFrameView(const VSFrameRef *f, int left, int top, int width, int height, VSCore *core) nogil
+        VSFrameRef *fieldFrameView(const VSFrameRef *f, int field, VSCore *core) nogil
+        VSFrameRef *weaveFrameViews(const VSFrameRef *top, const VSFrameRef *bottom, VSCore *core) nogil
+        int setMemoryLimitEnforced(int enforce, VSCore *core) nogil
+        void getMemoryLimitInfo(VSCore *core, VSMemoryLimitInfo *info) nogil
+        int propGetAtom(const char *key) nogil
+        int propNumElementsAtom(const VSMap *map, int atom) nogil
+        int64_t propGetIntAtom(const VSMap *map, int atom, int index, int *error) nogil
+        double propGetFloatAtom(const VSMap *map, int atom, int index, int *error) nogil
+        const char *propGetDataAtom(const VSMap *map, int atom, int index, int *error) nogil
+        int propGetDataSizeAtom(const VSMap *map, int atom, int index, int *error) nogil
+        int propSetIntAtom(VSMap *map, int atom, int64_t i, int append) nogil
+        int propSetFloatAtom(VSMap *map, int atom, double d, int append) nogil
+        int propSetDataAtom(VSMap *map, int atom, const char *data, int size, int append) nogil
+        int propDeleteKeyAtom(VSMap *map, int atom) nogil
+        void getNodeInfo(VSNodeRef *node, VSNodeInfo *info) nogil
+        VSNodeRef *getNodeInput(VSNodeRef *node, int index) nogil
+        VSMap *getNodeGraph(VSNodeRef *node) nogil
+        void setFilterHints(VSNodeRef *node, const VSFilterHints *hints) nogil
+        VSMap *saveGraph(const VSMap *clips, const char *filename) nogil
+        VSMap *loadGraph(const char *filename, VSCore *core) nogil
+        int setProfiling(int enable, VSCore *core) nogil
+        VSMap *getProfile(VSCore *core, int reset) nogil
+        void startTrace(VSCore *core) nogil
+        int stopTrace(VSCore *core, const char *filename) nogil
+        void getCoreStats(VSCore *core, VSMap *stats) nogil
+        int setGraphRecording(int enable, VSCore *core) nogil
+
     const VSAPI *getVapourSynthAPI(int version) nogil
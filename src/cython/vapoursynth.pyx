@@ -381,6 +381,11 @@ def get_current_environment():
 _EMPTY = []
 
 AlphaOutputTuple = namedtuple("AlphaOutputTuple", "clip alpha")
+NodeMemoryInfo = namedtuple("NodeMemoryInfo", "in_flight cached peak_in_flight peak_cached peak_total")
+NodeInfo = namedtuple("NodeInfo", "name id filter_mode flags num_outputs inputs")
+FilterHints = namedtuple("FilterHints", "pure pointwise cheap pass_through spatial_radius temporal_radius untouched_planes")
+MemoryLimitInfo = namedtuple("MemoryLimitInfo", "used limit peak_used peak_overshoot deferred_requests waiting_requests")
+NodeProfile = namedtuple("NodeProfile", "id name calls_initial calls_frame_ready calls_all_frames_ready calls_error frames total_time max_time histogram")
 
 def _construct_parameter(signature):
     name,type,*opt = signature.split(":")
@@ -736,6 +741,14 @@ cdef void __stdcall frameDoneCallbackOutput(void *data, const VSFrameRef *f, int
     d.condition.release()
 
 
+# the same rule std.Cache follows for passing clips through
+cdef bint needsCache(VideoNode node):
+    cdef VSNodeInfo info
+    if node.flags & vapoursynth.nfNoCache:
+        return False
+    node.funcs.getNodeInfo(node.node, &info)
+    return not (info.hints.flags & (vapoursynth.fhCheap | vapoursynth.fhPassThrough)) or (info.flags & vapoursynth.nfMakeLinear)
+
 cdef object mapToDict(const VSMap *map, bint flatten, bint add_cache, VSCore *core, const VSAPI *funcs):
     cdef int numKeys = funcs.propNumKeys(map)
     retdict = {}
@@ -757,7 +770,7 @@ cdef object mapToDict(const VSMap *map, bint flatten, bint add_cache, VSCore *co
                 c = _get_core()
                 newval = createVideoNode(funcs.propGetNode(map, retkey, y, NULL), funcs, c)
 
-                if add_cache and not (newval.flags & vapoursynth.nfNoCache):
+                if add_cache and needsCache(newval):
                     newval = c.std.Cache(clip=newval)
 
                     if isinstance(newval, dict):
@@ -1482,6 +1495,39 @@ cdef class VideoNode(object):
 
         return fut
 
+    def get_memory_info(self):
+        cdef VSNodeMemoryInfo info
+        self.funcs.getNodeMemoryInfo(self.node, &info)
+        return NodeMemoryInfo(info.inFlightBytes, info.cachedBytes, info.peakInFlightBytes, info.peakCachedBytes, info.peakTotalBytes)
+
+    def get_node_info(self):
+        cdef VSNodeInfo info
+        cdef VSNodeRef *ref
+        self.funcs.getNodeInfo(self.node, &info)
+        inputs = []
+        for i in range(info.numInputs):
+            ref = self.funcs.getNodeInput(self.node, i)
+            inputs.append(createVideoNode(ref, self.funcs, self.core) if ref else None)
+        return NodeInfo(info.name.decode('utf-8'), info.id, info.filterMode, info.flags, info.numOutputs, inputs)
+
+    def get_filter_hints(self):
+        cdef VSNodeInfo info
+        self.funcs.getNodeInfo(self.node, &info)
+        untouched = [plane for plane in range(3) if info.hints.untouchedPlanes & (1 << plane)]
+        return FilterHints(bool(info.hints.flags & vapoursynth.fhPure), bool(info.hints.flags & vapoursynth.fhPointwise), bool(info.hints.flags & vapoursynth.fhCheap), bool(info.hints.flags & vapoursynth.fhPassThrough),
+            info.hints.spatialRadius, info.hints.temporalRadius, untouched)
+
+    def get_graph(self):
+        cdef VSMap *m = self.funcs.getNodeGraph(self.node)
+        cdef int numNodes = self.funcs.propNumElements(m, 'nodes')
+        nodes = [createVideoNode(self.funcs.propGetNode(m, 'nodes', i, NULL), self.funcs, self.core) for i in range(numNodes)]
+        self.funcs.freeMap(m)
+        return nodes
+
+    def prefetch(self, int first, int last, int priority = 0):
+        with nogil:
+            self.funcs.prefetch(self.node, first, last, priority)
+
     def set_output(self, int index = 0, VideoNode alpha = None):
         cdef const VSFormat *aformat = NULL
         clip = self
@@ -1742,6 +1788,80 @@ cdef class Core(object):
             new_size = new_size * 1024 * 1024
             self.funcs.setMaxCacheSize(new_size, self.core)
 
+    property large_pages:
+        def __get__(self):
+            return bool(self.funcs.setLargePages(-1, self.core))
+
+        def __set__(self, bint value):
+            self.funcs.setLargePages(value, self.core)
+
+    property enforce_memory_limit:
+        def __get__(self):
+            return bool(self.funcs.setMemoryLimitEnforced(-1, self.core))
+
+        def __set__(self, bint value):
+            self.funcs.setMemoryLimitEnforced(value, self.core)
+
+    def get_memory_limit_info(self):
+        cdef VSMemoryLimitInfo info
+        self.funcs.getMemoryLimitInfo(self.core, &info)
+        return MemoryLimitInfo(info.usedBytes, info.limitBytes, info.peakUsedBytes, info.peakOvershootBytes, info.deferredRequests, info.waitingRequests)
+
+    property profiling:
+        def __get__(self):
+            return bool(self.funcs.setProfiling(-1, self.core))
+
+        def __set__(self, bint value):
+            self.funcs.setProfiling(value, self.core)
+
+    def get_profile(self, bint reset=False):
+        cdef VSMap *m = self.funcs.getProfile(self.core, reset)
+        cdef int numNodes = max(self.funcs.propNumElements(m, 'id'), 0)
+        cdef list profile = []
+        for i in range(numNodes):
+            histogram = [self.funcs.propGetInt(m, 'histogram', i * 20 + j, NULL) for j in range(20)]
+            profile.append(NodeProfile(self.funcs.propGetInt(m, 'id', i, NULL), self.funcs.propGetData(m, 'name', i, NULL).decode('utf-8'),
+                self.funcs.propGetInt(m, 'calls_initial', i, NULL), self.funcs.propGetInt(m, 'calls_frame_ready', i, NULL),
+                self.funcs.propGetInt(m, 'calls_all_frames_ready', i, NULL), self.funcs.propGetInt(m, 'calls_error', i, NULL),
+                self.funcs.propGetInt(m, 'frames', i, NULL), self.funcs.propGetInt(m, 'total_time', i, NULL), self.funcs.propGetInt(m, 'max_time', i, NULL), histogram))
+        self.funcs.freeMap(m)
+        return profile
+
+    def get_stats(self):
+        cdef VSMap *m = self.funcs.createMap()
+        self.funcs.getCoreStats(self.core, m)
+        cdef dict stats = {}
+        cdef list caches = []
+        cache_keys = ('id', 'name', 'size', 'max_size', 'hits', 'near_miss', 'far_miss')
+        for i in range(self.funcs.propNumKeys(m)):
+            key = self.funcs.propGetKey(m, i).decode('utf-8')
+            if not key.startswith('cache_'):
+                stats[key] = self.funcs.propGetInt(m, self.funcs.propGetKey(m, i), 0, NULL)
+        for i in range(max(self.funcs.propNumElements(m, 'cache_id'), 0)):
+            cache = {}
+            for key in cache_keys:
+                ckey = ('cache_' + key).encode('utf-8')
+                if key == 'name':
+                    cache[key] = self.funcs.propGetData(m, ckey, i, NULL).decode('utf-8')
+                else:
+                    cache[key] = self.funcs.propGetInt(m, ckey, i, NULL)
+            caches.append(cache)
+        stats['caches'] = caches
+        self.funcs.freeMap(m)
+        return stats
+
+    def start_trace(self):
+        self.funcs.startTrace(self.core)
+
+    def stop_trace(self, str filename):
+        fn = filename.encode('utf-8')
+        cdef const char *cfn = fn
+        cdef int ok
+        with nogil:
+            ok = self.funcs.stopTrace(self.core, cfn)
+        if not ok:
+            raise Error('Couldn\'t write the trace to ' + filename)
+
     def __getattr__(self, name):
         cdef VSPlugin *plugin
         tname = name.encode('utf-8')
@@ -1791,6 +1911,53 @@ cdef class Core(object):
         self.funcs.freeMap(m)
         return sout
 
+    property graph_recording:
+        def __get__(self):
+            return bool(self.funcs.setGraphRecording(-1, self.core))
+
+        def __set__(self, bint value):
+            self.funcs.setGraphRecording(value, self.core)
+
+    def save_graph(self, str filename, clips):
+        cdef VSMap *m = self.funcs.createMap()
+        cdef VSMap *ret
+        if isinstance(clips, VideoNode):
+            clips = [clips]
+        try:
+            for clip in clips:
+                if not isinstance(clip, VideoNode):
+                    raise Error('Only clips can be saved')
+                self.funcs.propSetNode(m, 'clip', (<VideoNode>clip).node, paAppend)
+        except:
+            self.funcs.freeMap(m)
+            raise
+        fn = filename.encode('utf-8')
+        cdef const char *cfn = fn
+        with nogil:
+            ret = self.funcs.saveGraph(m, cfn)
+        self.funcs.freeMap(m)
+        err = self.funcs.getError(ret)
+        if err:
+            emsg = err.decode('utf-8')
+            self.funcs.freeMap(ret)
+            raise Error(emsg)
+        self.funcs.freeMap(ret)
+
+    def load_graph(self, str filename):
+        cdef VSMap *m
+        fn = filename.encode('utf-8')
+        cdef const char *cfn = fn
+        with nogil:
+            m = self.funcs.loadGraph(cfn, self.core)
+        err = self.funcs.getError(m)
+        if err:
+            emsg = err.decode('utf-8')
+            self.funcs.freeMap(m)
+            raise Error(emsg)
+        clips = [createVideoNode(self.funcs.propGetNode(m, 'clip', i, NULL), self.funcs, self) for i in range(self.funcs.propNumElements(m, 'clip'))]
+        self.funcs.freeMap(m)
+        return clips
+
     def list_functions(self):
         sout = ""
         plugins = self.get_plugins()
@@ -1838,12 +2005,13 @@ cdef class Core(object):
         s += '\tAdd Cache: ' + str(self.add_cache) + '\n'
         return s
 
-cdef Core createCore():
+cdef Core createCore(VSCore *core = NULL):
     cdef Core instance = Core.__new__(Core)
     instance.funcs = getVapourSynthAPI(VAPOURSYNTH_API_VERSION)
     if instance.funcs == NULL:
         raise Error('Failed to obtain VapourSynth API pointer. System does not support SSE2 or is the Python module and loaded core library mismatched?')
-    instance.core = instance.funcs.createCore(0)
+    # an already created core is taken over and freed with the instance
+    instance.core = core if core != NULL else instance.funcs.createCore(0)
     instance.add_cache = True
     return instance
 
@@ -2186,6 +2354,13 @@ cdef public struct VPYScriptExport:
     void *pyenvdict
     void *errstr
     int id
+    # a pooled core for vpy_createScript() to use instead of creating one, ownership is taken when set
+    VSCore *core
+
+# compiled code of the scripts evaluated with vpy_evaluateFile() by absolute path,
+# reused as long as the modification time and size of the file stay the same
+cdef dict _script_code_cache = {}
+cdef int _script_code_cache_size = 64
 
 
 cdef public api int vpy_createScript(VPYScriptExport *se) nogil:
@@ -2195,7 +2370,10 @@ cdef public api int vpy_createScript(VPYScriptExport *se) nogil:
             Py_INCREF(evaldict)
             se.pyenvdict = <void *>evaldict
 
-            _get_vsscript_policy()._make_environment(<int>se.id)
+            env = _get_vsscript_policy()._make_environment(<int>se.id)
+            if se.core != NULL:
+                env.core = createCore(se.core)
+                se.core = NULL
 
         except:
             errstr = 'Unspecified Python exception' + '\n\n' + traceback.format_exc()
@@ -2207,57 +2385,69 @@ cdef public api int vpy_createScript(VPYScriptExport *se) nogil:
     
 cdef public api int vpy_evaluateScript(VPYScriptExport *se, const char *script, const char *scriptFilename, int flags) nogil:
     with gil:
-        orig_path = None
-        try:
-            evaldict = {}
-            if se.pyenvdict:
-                evaldict = <dict>se.pyenvdict
-            else:
-                Py_INCREF(evaldict)
-                se.pyenvdict = <void *>evaldict
+        return _vpy_evaluateScript(se, script, scriptFilename, flags, None)
 
-                _get_vsscript_policy().get_environment(se.id).outputs.clear()
-
-            fn = scriptFilename.decode('utf-8')
+# script is either the source or an already compiled code object, the compiled source is
+# added to the code cache when file_key is set
+cdef int _vpy_evaluateScript(VPYScriptExport *se, object script, const char *scriptFilename, int flags, object file_key):
+    orig_path = None
+    try:
+        evaldict = {}
+        if se.pyenvdict:
+            evaldict = <dict>se.pyenvdict
+        else:
+            Py_INCREF(evaldict)
+            se.pyenvdict = <void *>evaldict
 
-            # don't set a filename if NULL is passed
-            if fn != '<string>':
-                abspath = os.path.abspath(fn)
-                evaldict['__file__'] = abspath
-                if flags & 1:
-                    orig_path = os.getcwd()
-                    os.chdir(os.path.dirname(abspath))
+            _get_vsscript_policy().get_environment(se.id).outputs.clear()
 
-            evaldict['__name__'] = "__vapoursynth__"
-            
-            if se.errstr:
-                errstr = <bytes>se.errstr
-                se.errstr = NULL
-                Py_DECREF(errstr)
-                errstr = None
+        fn = scriptFilename.decode('utf-8')
 
-            comp = compile(script.decode('utf-8-sig'), fn, 'exec')
+        # don't set a filename if NULL is passed
+        if fn != '<string>':
+            abspath = os.path.abspath(fn)
+            evaldict['__file__'] = abspath
+            if flags & 1:
+                orig_path = os.getcwd()
+                os.chdir(os.path.dirname(abspath))
 
-            # Change the environment now.
-            with _vsscript_use_or_create_environment(se.id).use():
-                exec(comp) in evaldict
+        evaldict['__name__'] = "__vapoursynth__"
+        
+        if se.errstr:
+            errstr = <bytes>se.errstr
+            se.errstr = NULL
+            Py_DECREF(errstr)
+            errstr = None
 
-        except BaseException, e:
-            errstr = 'Python exception: ' + str(e) + '\n\n' + traceback.format_exc()
-            errstr = errstr.encode('utf-8')
-            Py_INCREF(errstr)
-            se.errstr = <void *>errstr
-            return 2
-        except:
-            errstr = 'Unspecified Python exception' + '\n\n' + traceback.format_exc()
-            errstr = errstr.encode('utf-8')
-            Py_INCREF(errstr)
-            se.errstr = <void *>errstr
-            return 1
-        finally:
-            if orig_path is not None:
-                os.chdir(orig_path)
-        return 0
+        if isinstance(script, bytes):
+            comp = compile(script.decode('utf-8-sig'), fn, 'exec')
+            if file_key is not None:
+                if len(_script_code_cache) >= _script_code_cache_size:
+                    del _script_code_cache[next(iter(_script_code_cache))]
+                _script_code_cache[file_key[0]] = (file_key[1], comp)
+        else:
+            comp = script
+
+        # Change the environment now.
+        with _vsscript_use_or_create_environment(se.id).use():
+            exec(comp) in evaldict
+
+    except BaseException, e:
+        errstr = 'Python exception: ' + str(e) + '\n\n' + traceback.format_exc()
+        errstr = errstr.encode('utf-8')
+        Py_INCREF(errstr)
+        se.errstr = <void *>errstr
+        return 2
+    except:
+        errstr = 'Unspecified Python exception' + '\n\n' + traceback.format_exc()
+        errstr = errstr.encode('utf-8')
+        Py_INCREF(errstr)
+        se.errstr = <void *>errstr
+        return 1
+    finally:
+        if orig_path is not None:
+            os.chdir(orig_path)
+    return 0
 
 cdef public api int vpy_evaluateFile(VPYScriptExport *se, const char *scriptFilename, int flags) nogil:
     with gil:
@@ -2267,9 +2457,16 @@ cdef public api int vpy_evaluateFile(VPYScriptExport *se, const char *scriptFile
             se.pyenvdict = <void *>evaldict
             _get_vsscript_policy().get_environment(se.id).outputs.clear()
         try:
-            with open(scriptFilename.decode('utf-8'), 'rb') as f:
-                script = f.read(1024*1024*16)
-            return vpy_evaluateScript(se, script, scriptFilename, flags)
+            fn = scriptFilename.decode('utf-8')
+            st = os.stat(fn)
+            file_key = (os.path.abspath(fn), (st.st_mtime_ns, st.st_size))
+            cached = _script_code_cache.get(file_key[0])
+            if cached is not None and cached[0] == file_key[1]:
+                script = cached[1]
+            else:
+                with open(fn, 'rb') as f:
+                    script = f.read(1024*1024*16)
+            return _vpy_evaluateScript(se, script, scriptFilename, flags, file_key)
         except BaseException, e:
             errstr = 'File reading exception:\n' + str(e)
             errstr = errstr.encode('utf-8')
@@ -494,26 +494,8 @@ static const VSFrameRef *VS_CC eedi3GetFrame(int n, int activationReason, void *
         VSFrameRef *dst = vsapi->newVideoFrame(d->vi.format, d->vi.width, d->vi.height, src, core);
         vsapi->freeFrame(src);
 
-        float *workspace = NULL;
-        VS_ALIGNED_MALLOC((void **)&workspace, d->vi.width * VSMAX(d->mdis * 4 + 1, 16) * 4 * sizeof(float), 16);
-        if (!workspace){
-            vsapi->setFilterError("EEDI3: Memory allocation failed", frameCtx);
-            vsapi->freeFrame(scpPF);
-            vsapi->freeFrame(srcPF);
-            vsapi->freeFrame(dst);
-            return 0;
-        }
-
-        int *dmapa = NULL;
-        VS_ALIGNED_MALLOC((void **)&dmapa, vsapi->getStride(dst, 0)*vsapi->getFrameHeight(dst, 0)*sizeof(int), 16);
-        if (!dmapa) {
-            VS_ALIGNED_FREE(workspace);
-            vsapi->setFilterError("EEDI3: Memory allocation failed", frameCtx);
-            vsapi->freeFrame(scpPF);
-            vsapi->freeFrame(srcPF);
-            vsapi->freeFrame(dst);
-            return 0;
-        }
+        float *workspace = (float *)vsapi->allocScratch(d->vi.width * VSMAX(d->mdis * 4 + 1, 16) * 4 * sizeof(float), frameCtx);
+        int *dmapa = (int *)vsapi->allocScratch(vsapi->getStride(dst, 0) * vsapi->getFrameHeight(dst, 0) * sizeof(int), frameCtx);
 
         int b, x, y;
 
@@ -651,8 +633,6 @@ static const VSFrameRef *VS_CC eedi3GetFrame(int n, int activationReason, void *
             }
         }
 
-        VS_ALIGNED_FREE(dmapa);
-        VS_ALIGNED_FREE(workspace);
         vsapi->freeFrame(srcPF);
         vsapi->freeFrame(scpPF);
 
@@ -23,6 +23,8 @@
 #include <cmath>
 #include <cfloat>
 #include <cstddef>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <vector>
@@ -726,13 +728,18 @@ struct HysteresisData {
 };
 
 template<typename T>
-static void process_frame_hysteresis(const VSFrameRef * src1, const VSFrameRef * src2, VSFrameRef * dst, const VSFormat *fi, const HysteresisData * d, const VSAPI * vsapi) VS_NOEXCEPT {
+static void process_frame_hysteresis(const VSFrameRef * src1, const VSFrameRef * src2, VSFrameRef * dst, const VSFormat *fi, const HysteresisData * d, VSFrameContext *frameCtx, const VSAPI * vsapi) VS_NOEXCEPT {
     uint8_t * VS_RESTRICT label = nullptr;
+    // pixels still to visit stored as y * width + x, each pixel is labelled before it's pushed so it can never hold more than the plane size
+    int * VS_RESTRICT coordinates = nullptr;
 
     for (int plane = 0; plane < fi->numPlanes; plane++) {
         if (d->process[plane]) {
-            if (!label)
-                label = new uint8_t[d->labelSize]();
+            if (!label) {
+                label = static_cast<uint8_t *>(vsapi->allocScratch(d->labelSize, frameCtx));
+                memset(label, 0, d->labelSize);
+                coordinates = static_cast<int *>(vsapi->allocScratch(d->labelSize * sizeof(int), frameCtx));
+            }
             const int width = vsapi->getFrameWidth(src1, plane);
             const int height = vsapi->getFrameHeight(src1, plane);
             const int stride = vsapi->getStride(src1, plane) / sizeof(T);
@@ -751,27 +758,27 @@ static void process_frame_hysteresis(const VSFrameRef * src1, const VSFrameRef *
 
             std::fill_n(dstp, stride * height, lower);
 
-            std::vector<std::pair<int, int>> coordinates;
-
             for (int y = 0; y < height; y++) {
                 for (int x = 0; x < width; x++) {
                     if (!label[width * y + x] && srcp1[stride * y + x] > lower && srcp2[stride * y + x] > lower) {
                         label[width * y + x] = std::numeric_limits<uint8_t>::max();
                         dstp[stride * y + x] = upper;
 
-                        coordinates.emplace_back(std::make_pair(x, y));
+                        size_t numCoordinates = 0;
+                        coordinates[numCoordinates++] = width * y + x;
 
-                        while (!coordinates.empty()) {
-                            const auto pos = coordinates.back();
-                            coordinates.pop_back();
+                        while (numCoordinates) {
+                            const int pos = coordinates[--numCoordinates];
+                            const int posx = pos % width;
+                            const int posy = pos / width;
 
-                            for (int yy = std::max(pos.second - 1, 0); yy <= std::min(pos.second + 1, height - 1); yy++) {
-                                for (int xx = std::max(pos.first - 1, 0); xx <= std::min(pos.first + 1, width - 1); xx++) {
+                            for (int yy = std::max(posy - 1, 0); yy <= std::min(posy + 1, height - 1); yy++) {
+                                for (int xx = std::max(posx - 1, 0); xx <= std::min(posx + 1, width - 1); xx++) {
                                     if (!label[width * yy + xx] && srcp2[stride * yy + xx] > lower) {
                                         label[width * yy + xx] = std::numeric_limits<uint8_t>::max();
                                         dstp[stride * yy + xx] = upper;
 
-                                        coordinates.emplace_back(std::make_pair(xx, yy));
+                                        coordinates[numCoordinates++] = width * yy + xx;
                                     }
                                 }
                             }
@@ -781,8 +788,6 @@ static void process_frame_hysteresis(const VSFrameRef * src1, const VSFrameRef *
             }
         }
     }
-
-    delete[] label;
 }
 
 static void VS_CC hysteresisInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
@@ -805,11 +810,11 @@ static const VSFrameRef *VS_CC hysteresisGetFrame(int n, int activationReason, v
         VSFrameRef * dst = vsapi->newVideoFrame2(fi, vsapi->getFrameWidth(src1, 0), vsapi->getFrameHeight(src1, 0), fr, pl, src1, core);
 
         if (fi->bytesPerSample == 1)
-            process_frame_hysteresis<uint8_t>(src1, src2, dst, fi, d, vsapi);
+            process_frame_hysteresis<uint8_t>(src1, src2, dst, fi, d, frameCtx, vsapi);
         else if (fi->bytesPerSample == 2)
-            process_frame_hysteresis<uint16_t>(src1, src2, dst, fi, d, vsapi);
+            process_frame_hysteresis<uint16_t>(src1, src2, dst, fi, d, frameCtx, vsapi);
         else
-            process_frame_hysteresis<float>(src1, src2, dst, fi, d, vsapi);
+            process_frame_hysteresis<float>(src1, src2, dst, fi, d, frameCtx, vsapi);
 
         vsapi->freeFrame(src1);
         vsapi->freeFrame(src2);
@@ -121,9 +121,14 @@ static const VSFrameRef *VS_CC MorphoGetFrame(int n, int activationReason,
         const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
         VSFrameRef *dst = vsapi->newVideoFrame(d->vi.format, d->vi.width,
                                                d->vi.height, src, core);
+        uint8_t *tmp = NULL;
 
         int i;
 
+        /* only the combined filters need an intermediate plane, the first plane is always the largest */
+        if (FilterFuncs[d->filter] != MorphoDilate && FilterFuncs[d->filter] != MorphoErode)
+            tmp = vsapi->allocScratch(vsapi->getStride(src, 0) * vsapi->getFrameHeight(src, 0), frameCtx);
+
         for (i = 0; i < d->vi.format->numPlanes; i++) {
             const uint8_t *srcp = vsapi->getReadPtr(src, i);
             uint8_t *dstp = vsapi->getWritePtr(dst, i);
@@ -131,7 +136,7 @@ static const VSFrameRef *VS_CC MorphoGetFrame(int n, int activationReason,
             int height = vsapi->getFrameHeight(src, i);
             int stride = vsapi->getStride(src, i);
 
-            FilterFuncs[d->filter](srcp, dstp, width, height, stride, d);
+            FilterFuncs[d->filter](srcp, dstp, tmp, width, height, stride, d);
         }
 
         vsapi->freeFrame(src);
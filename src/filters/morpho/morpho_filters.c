@@ -82,7 +82,7 @@ static inline int Border(int v, int max) {
         dst += stride;                                                         \
     }
 
-void MorphoDilate(const uint8_t *src, uint8_t *dst,
+void MorphoDilate(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                   int width, int height, int stride, MorphoData *d)
 {
     if (d->vi.format->bytesPerSample == 1) {
@@ -92,7 +92,7 @@ void MorphoDilate(const uint8_t *src, uint8_t *dst,
     }
 }
 
-void MorphoErode(const uint8_t *src, uint8_t *dst,
+void MorphoErode(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                  int width, int height, int stride, MorphoData *d)
 {
     int sval = (1 << d->vi.format->bitsPerSample) - 1;
@@ -104,30 +104,26 @@ void MorphoErode(const uint8_t *src, uint8_t *dst,
     }
 }
 
-void MorphoOpen(const uint8_t *src, uint8_t *dst,
+void MorphoOpen(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                 int width, int height, int stride, MorphoData *d)
 {
-    uint8_t *tmp = malloc(sizeof(uint8_t) * stride * height);
-    MorphoErode(src, tmp, width, height, stride, d);
-    MorphoDilate((const uint8_t*)tmp, dst, width, height, stride, d);
-    free(tmp);
+    MorphoErode(src, tmp, NULL, width, height, stride, d);
+    MorphoDilate((const uint8_t*)tmp, dst, NULL, width, height, stride, d);
 }
 
-void MorphoClose(const uint8_t *src, uint8_t *dst,
+void MorphoClose(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                  int width, int height, int stride, MorphoData *d)
 {
-    uint8_t *tmp = malloc(sizeof(uint8_t) * stride * height);
-    MorphoDilate(src, tmp, width, height, stride, d);
-    MorphoErode((const uint8_t*)tmp, dst, width, height, stride, d);
-    free(tmp);
+    MorphoDilate(src, tmp, NULL, width, height, stride, d);
+    MorphoErode((const uint8_t*)tmp, dst, NULL, width, height, stride, d);
 }
 
-void MorphoTopHat(const uint8_t *src, uint8_t *dst,
+void MorphoTopHat(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                   int width, int height, int stride, MorphoData *d)
 {
     int x, y;
 
-    MorphoOpen(src, dst, width, height, stride, d);
+    MorphoOpen(src, dst, tmp, width, height, stride, d);
 
     for (y = 0; y < height; y++) {
         if (d->vi.format->bytesPerSample == 1) {
@@ -148,12 +144,12 @@ void MorphoTopHat(const uint8_t *src, uint8_t *dst,
     }
 }
 
-void MorphoBottomHat(const uint8_t *src, uint8_t *dst,
+void MorphoBottomHat(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                      int width, int height, int stride, MorphoData *d)
 {
     int x, y;
 
-    MorphoClose(src, dst, width, height, stride, d);
+    MorphoClose(src, dst, tmp, width, height, stride, d);
 
     for (y = 0; y < height; y++) {
         if (d->vi.format->bytesPerSample == 1) {
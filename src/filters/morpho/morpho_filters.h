@@ -16,19 +16,20 @@
  * PERFORMANCE OF THIS SOFTWARE.
  */
 
-typedef void (*MorphoFilter)(const uint8_t*, uint8_t*, int, int, int, MorphoData*);
+/* tmp must hold at least stride * height bytes, only Open/Close and the hat filters use it */
+typedef void (*MorphoFilter)(const uint8_t*, uint8_t*, uint8_t*, int, int, int, MorphoData*);
 
-void MorphoDilate(const uint8_t *src, uint8_t *dst,
+void MorphoDilate(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                   int width, int height, int stride, MorphoData *d);
-void MorphoErode(const uint8_t *src, uint8_t *dst,
+void MorphoErode(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                  int width, int height, int stride, MorphoData *d);
-void MorphoOpen(const uint8_t *src, uint8_t *dst,
+void MorphoOpen(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                 int width, int height, int stride, MorphoData *d);
-void MorphoClose(const uint8_t *src, uint8_t *dst,
+void MorphoClose(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                  int width, int height, int stride, MorphoData *d);
-void MorphoTopHat(const uint8_t *src, uint8_t *dst,
+void MorphoTopHat(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                   int width, int height, int stride, MorphoData *d);
-void MorphoBottomHat(const uint8_t *src, uint8_t *dst,
+void MorphoBottomHat(const uint8_t *src, uint8_t *dst, uint8_t *tmp,
                      int width, int height, int stride, MorphoData *d);
 
 extern const char *FilterNames[];
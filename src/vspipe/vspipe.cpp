@@ -95,6 +95,7 @@ static bool showInfo = false;
 static bool preserveCwd = false;
 static bool showVersion = false;
 static bool printFrameNumber = false;
+static bool printProfile = false;
 static double fps = 0;
 static bool hasMeaningfulFps = false;
 static std::map<int, std::pair<const VSFrameRef *, const VSFrameRef *>> reorderMap;
@@ -400,6 +401,34 @@ static const char *colorFamilyToString(int colorFamily) {
     return "";
 }
 
+// filters sorted by the time spent in them, times include filters called directly from their getframe function
+static void printProfileReport(VSCore *core) {
+    VSMap *profile = vsapi->getProfile(core, 0);
+    int numNodes = std::max(vsapi->propNumElements(profile, "id"), 0);
+    std::vector<int> order;
+    int64_t totalTime = 0;
+    for (int i = 0; i < numNodes; i++) {
+        order.push_back(i);
+        totalTime += vsapi->propGetInt(profile, "total_time", i, nullptr);
+    }
+    std::sort(order.begin(), order.end(), [profile](int a, int b) {
+        return vsapi->propGetInt(profile, "total_time", a, nullptr) > vsapi->propGetInt(profile, "total_time", b, nullptr);
+    });
+
+    fprintf(stderr, "%12s %7s %10s %10s %10s %10s  %s\n", "Total ms", "%", "Calls", "Frames", "Max ms", "Avg us", "Filter");
+    for (int i : order) {
+        int64_t time = vsapi->propGetInt(profile, "total_time", i, nullptr);
+        int64_t calls = 0;
+        for (const char *key : { "calls_initial", "calls_frame_ready", "calls_all_frames_ready", "calls_error" })
+            calls += vsapi->propGetInt(profile, key, i, nullptr);
+        int64_t id = vsapi->propGetInt(profile, "id", i, nullptr);
+        fprintf(stderr, "%12.2f %7.2f %10" PRId64 " %10" PRId64 " %10.2f %10.2f  %s (%s)\n", time / 1e6, totalTime ? 100.0 * time / totalTime : 0.0,
+            calls, vsapi->propGetInt(profile, "frames", i, nullptr), vsapi->propGetInt(profile, "max_time", i, nullptr) / 1e6, calls ? time / 1e3 / calls : 0.0,
+            vsapi->propGetData(profile, "name", i, nullptr), id < 0 ? "freed" : std::to_string(id).c_str());
+    }
+    vsapi->freeMap(profile);
+}
+
 static bool nstringToInt(const nstring &ns, int &result) {
     size_t pos = 0;
     std::string s = nstringToUtf8(ns);
@@ -454,8 +483,12 @@ static void printHelp() {
         "  -r, --requests N      Set number of concurrent frame requests\n"
         "  -y, --y4m             Add YUV4MPEG headers to output\n"
         "  -t, --timecodes FILE  Write timecodes v2 file\n"
+        "  -g, --save-graph FILE Save the output's filter graph so it can be passed instead of the script,\n"
+        "                        only the graph is saved when no outfile is given\n"
         "  -c  --preserve-cwd    Don't temporarily change the working directory the script path\n"
         "  -p, --progress        Print progress to stderr\n"
+        "      --profile         Print the time spent in each filter to stderr when done\n"
+        "      --trace FILE      Write a timeline of the frame processing in Chrome trace format\n"
         "  -i, --info            Show video info and exit\n"
         "  -v, --version         Show version info and exit\n"
         "\n"
@@ -470,6 +503,9 @@ static void printHelp() {
         "    vspipe --start 5 --end 100 script.vpy output.raw\n"
         "  Pass values to a script:\n"
         "    vspipe --arg deinterlace=yes --arg \"message=fluffy kittens\" script.vpy output.raw\n"
+        "  Save the filter graph and use it in place of the script later:\n"
+        "    vspipe --save-graph script.vsgraph script.vpy\n"
+        "    vspipe --start 1000 --end 1999 script.vsgraph chunk.raw\n"
         "  Pipe to x264 and write timecodes file:\n"
         "    vspipe script.vpy - --y4m --timecodes timecodes.txt | x264 --demuxer y4m -o script.mkv -\n"
         );
@@ -484,7 +520,7 @@ int wmain(int argc, wchar_t **argv) {
 #else
 int main(int argc, char **argv) {
 #endif
-    nstring outputFilename, scriptFilename, timecodesFilename;
+    nstring outputFilename, scriptFilename, timecodesFilename, graphFilename, traceFilename;
     bool showHelp = false;
     std::map<std::string, std::string> scriptArgs;
 
@@ -496,6 +532,8 @@ int main(int argc, char **argv) {
             y4m = true;
         } else if (argString == NSTRING("-p") || argString == NSTRING("--progress")) {
             printFrameNumber = true;
+        } else if (argString == NSTRING("--profile")) {
+            printProfile = true;
         } else if (argString == NSTRING("-i") || argString == NSTRING("--info")) {
             showInfo = true;
         } else if (argString == NSTRING("-h") || argString == NSTRING("--help")) {
@@ -588,6 +626,24 @@ int main(int argc, char **argv) {
 
             timecodesFilename = argv[arg + 1];
 
+            arg++;
+        } else if (argString == NSTRING("-g") || argString == NSTRING("--save-graph")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No graph file specified\n");
+                return 1;
+            }
+
+            graphFilename = argv[arg + 1];
+
+            arg++;
+        } else if (argString == NSTRING("--trace")) {
+            if (argc <= arg + 1) {
+                fprintf(stderr, "No trace file specified\n");
+                return 1;
+            }
+
+            traceFilename = argv[arg + 1];
+
             arg++;
         } else if (scriptFilename.empty() && !argString.empty() && argString.substr(0, 1) != NSTRING("-")) {
             scriptFilename = argString;
@@ -610,14 +666,14 @@ int main(int argc, char **argv) {
     } else if (scriptFilename.empty()) {
         fprintf(stderr, "No script file specified\n");
         return 1;
-    } else if (outputFilename.empty()) {
+    } else if (outputFilename.empty() && graphFilename.empty()) {
         fprintf(stderr, "No output file specified\n");
         return 1;
     }
 
     if (outputFilename == NSTRING("-")) {
         outFile = stdout;
-    } else if (outputFilename == NSTRING(".")) {
+    } else if (outputFilename.empty() || outputFilename == NSTRING(".")) {
         // do nothing
     } else {
 #ifdef VS_TARGET_OS_WINDOWS
@@ -671,20 +727,71 @@ int main(int argc, char **argv) {
         vsapi->freeMap(foldedArgs);
     }
 
+    // the calls that build the graph are only recorded when asked for since their arguments keep every clip alive
+    if (!graphFilename.empty())
+        vsapi->setGraphRecording(1, vsscript_getCore(se));
+
     start = std::chrono::high_resolution_clock::now();
-    if (vsscript_evaluateFile(&se, nstringToUtf8(scriptFilename).c_str(), preserveCwd ? 0 : efSetWorkingDir)) {
-        fprintf(stderr, "Script evaluation failed:\n%s\n", vsscript_getError(se));
-        vsscript_freeScript(se);
-        vsscript_finalize();
-        return 1;
+    const nstring graphExtension = NSTRING(".vsgraph");
+    if (scriptFilename.size() > graphExtension.size() && scriptFilename.compare(scriptFilename.size() - graphExtension.size(), graphExtension.size(), graphExtension) == 0) {
+        // saved graphs are recreated directly by the core without evaluating any python
+        VSMap *graph = vsapi->loadGraph(nstringToUtf8(scriptFilename).c_str(), vsscript_getCore(se));
+        if (vsapi->getError(graph)) {
+            fprintf(stderr, "Graph loading failed:\n%s\n", vsapi->getError(graph));
+            vsapi->freeMap(graph);
+            vsscript_freeScript(se);
+            vsscript_finalize();
+            return 1;
+        }
+        node = vsapi->propGetNode(graph, "clip", 0, nullptr);
+        if (vsapi->propNumElements(graph, "clip") > 1)
+            alphaNode = vsapi->propGetNode(graph, "clip", 1, nullptr);
+        vsapi->freeMap(graph);
+    } else {
+        if (vsscript_evaluateFile(&se, nstringToUtf8(scriptFilename).c_str(), preserveCwd ? 0 : efSetWorkingDir)) {
+            fprintf(stderr, "Script evaluation failed:\n%s\n", vsscript_getError(se));
+            vsscript_freeScript(se);
+            vsscript_finalize();
+            return 1;
+        }
+
+        node = vsscript_getOutput2(se, outputIndex, &alphaNode);
+        if (!node) {
+           fprintf(stderr, "Failed to retrieve output node. Invalid index specified?\n");
+           vsscript_freeScript(se);
+           vsscript_finalize();
+           return 1;
+        }
     }
 
-    node = vsscript_getOutput2(se, outputIndex, &alphaNode);
-    if (!node) {
-       fprintf(stderr, "Failed to retrieve output node. Invalid index specified?\n");
-       vsscript_freeScript(se);
-       vsscript_finalize();
-       return 1;
+    if (!graphFilename.empty()) {
+        VSMap *clips = vsapi->createMap();
+        vsapi->propSetNode(clips, "clip", node, paAppend);
+        if (alphaNode)
+            vsapi->propSetNode(clips, "clip", alphaNode, paAppend);
+        VSMap *result = vsapi->saveGraph(clips, nstringToUtf8(graphFilename).c_str());
+        vsapi->freeMap(clips);
+        if (vsapi->getError(result)) {
+            fprintf(stderr, "Saving the graph failed:\n%s\n", vsapi->getError(result));
+            vsapi->freeMap(result);
+            vsapi->freeNode(node);
+            vsapi->freeNode(alphaNode);
+            vsscript_freeScript(se);
+            vsscript_finalize();
+            return 1;
+        }
+        vsapi->freeMap(result);
+
+        // nothing else to do when only the graph was asked for
+        if (outputFilename.empty()) {
+            if (timecodesFile)
+                fclose(timecodesFile);
+            vsapi->freeNode(node);
+            vsapi->freeNode(alphaNode);
+            vsscript_freeScript(se);
+            vsscript_finalize();
+            return 0;
+        }
     }
 
     bool error = false;
@@ -739,8 +846,16 @@ int main(int argc, char **argv) {
             return 1;
         }
 
+        if (printProfile)
+            vsapi->setProfiling(1, vsscript_getCore(se));
+        if (!traceFilename.empty())
+            vsapi->startTrace(vsscript_getCore(se));
         lastFpsReportTime = std::chrono::high_resolution_clock::now();
         error = outputNode();
+        if (!traceFilename.empty() && !vsapi->stopTrace(vsscript_getCore(se), nstringToUtf8(traceFilename).c_str())) {
+            fprintf(stderr, "Couldn't write the trace to %s\n", nstringToUtf8(traceFilename).c_str());
+            error = true;
+        }
     }
 
     if (outFile)
@@ -752,6 +867,8 @@ int main(int argc, char **argv) {
         int totalFrames = outputFrames - startFrame;
         std::chrono::duration<double> elapsedSeconds = std::chrono::high_resolution_clock::now() - start;
         fprintf(stderr, "Output %d frames in %.2f seconds (%.2f fps)\n", totalFrames, elapsedSeconds.count(), totalFrames / elapsedSeconds.count());
+        if (printProfile)
+            printProfileReport(vsscript_getCore(se));
     }
     vsapi->freeNode(node);
     vsapi->freeNode(alphaNode);
@@ -23,6 +23,8 @@
 #include "cython/vapoursynth_api.h"
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <thread>
 #include <vector>
 
 #ifdef VS_TARGET_OS_WINDOWS
@@ -43,6 +45,65 @@ static bool initialized = false;
 static PyThreadState *ts = nullptr;
 static PyGILState_STATE s;
 
+// Cores are created ahead of time by a background thread so new scripts don't have to wait for
+// the core to be created and the plugins to be registered. Only unused cores are ever pooled.
+static std::mutex poolLock;
+static std::condition_variable poolCondition;
+static std::vector<VSCore *> corePool;
+static size_t corePoolSize = 0;
+static bool poolThreadRunning = false;
+static const VSAPI *poolVSAPI = nullptr;
+
+static void fillCorePool() {
+    std::unique_lock<std::mutex> lock(poolLock);
+    while (corePoolSize > 0) {
+        if (corePool.size() < corePoolSize) {
+            lock.unlock();
+            VSCore *core = poolVSAPI->createCore(0);
+            lock.lock();
+            corePool.push_back(core);
+        } else {
+            poolCondition.wait(lock);
+        }
+    }
+    poolThreadRunning = false;
+    poolCondition.notify_all();
+}
+
+static VSCore *takePooledCore() {
+    std::lock_guard<std::mutex> lock(poolLock);
+    if (corePool.empty())
+        return nullptr;
+    VSCore *core = corePool.back();
+    corePool.pop_back();
+    poolCondition.notify_all();
+    return core;
+}
+
+static void setCorePoolSizeInternal(size_t size) {
+    std::vector<VSCore *> unused;
+    {
+        std::unique_lock<std::mutex> lock(poolLock);
+        corePoolSize = size;
+        poolCondition.notify_all();
+        if (size > 0 && !poolThreadRunning) {
+            // detached so an application that never finalizes vsscript can still exit
+            poolThreadRunning = true;
+            std::thread(fillCorePool).detach();
+        } else if (size == 0) {
+            poolCondition.wait(lock, [] { return !poolThreadRunning; });
+        }
+
+        while (corePool.size() > corePoolSize) {
+            unused.push_back(corePool.back());
+            corePool.pop_back();
+        }
+    }
+
+    for (VSCore *core : unused)
+        poolVSAPI->freeCore(core);
+}
+
 static void real_init(void) {
 #ifdef VS_TARGET_OS_WINDOWS
 #ifdef _WIN64
@@ -102,6 +163,7 @@ static void real_init(void) {
         return;
     if (vpy_initVSScript())
         return;
+    poolVSAPI = vpy_getVSApi2(VAPOURSYNTH_API_VERSION);
     ts = PyEval_SaveThread();
     initialized = true;
 }
@@ -123,6 +185,8 @@ VS_API(int) vsscript_finalize(void) {
     std::lock_guard<std::mutex> lock(vsscriptlock);
     int count = --initializationCount;
     assert(count >= 0);
+    if (count == 0 && initialized)
+        setCorePoolSizeInternal(0);
     return count;
 }
 
@@ -132,7 +196,13 @@ static int vsscript_createScriptInternal(VSScript **handle) {
         (*handle)->pyenvdict = nullptr;
         (*handle)->errstr = nullptr;
         (*handle)->id = ++scriptId;
-        return vpy_createScript(*handle);
+        (*handle)->core = takePooledCore();
+        int result = vpy_createScript(*handle);
+        if ((*handle)->core) {
+            poolVSAPI->freeCore((*handle)->core);
+            (*handle)->core = nullptr;
+        }
+        return result;
     } else {
         return 1;
     }
@@ -162,6 +232,14 @@ VS_API(int) vsscript_evaluateFile(VSScript **handle, const char *scriptFilename,
     return vpy_evaluateFile(*handle, scriptFilename, flags);
 }
 
+VS_API(int) vsscript_setCorePoolSize(int size) {
+    std::lock_guard<std::mutex> lock(vsscriptlock);
+    if (!initialized || size < 0)
+        return 1;
+    setCorePoolSizeInternal(size);
+    return 0;
+}
+
 VS_API(void) vsscript_freeScript(VSScript *handle) {
     std::lock_guard<std::mutex> lock(vsscriptlock);
     if (handle) {
@@ -102,5 +102,32 @@ class FilterTestSequence(unittest.TestCase):
         with self.assertRaisesRegex(vs.Error, "Fail"):
             fut.result(2)
 
+    def test_prefetch(self):
+        evaluated = []
+        lock = threading.Lock()
+
+        def counting_fe(n):
+            with lock:
+                evaluated.append(n)
+            return self.filter
+
+        counting_filter = self.filter.std.FrameEval(counting_fe)
+        counting_filter.prefetch(-5, 9)
+
+        deadline = time.time() + 5
+        while len(evaluated) < 10 and time.time() < deadline:
+            time.sleep(0.01)
+        self.assertEqual(sorted(evaluated), list(range(10)))
+
+        # the prefetched frames are served from the cache
+        for n in range(10):
+            counting_filter.get_frame(n)
+        self.assertEqual(len(evaluated), 10)
+
+    def test_prefetch_cancel(self):
+        self.slow_filter.prefetch(0, 19, 10)
+        self.slow_filter.prefetch(1, 0)
+        self.assertIsInstance(self.slow_filter.get_frame_async(5).result(3), vs.VideoFrame)
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,57 @@
+#
+# Measures the per frame cost of cache hops in long chains of trivial filters.
+#
+# Trivial reorder and metadata filters are created with nfNoCache so no cache
+# is inserted after them, this compares that against the same chain with a
+# cache after every filter and against stacked caches.
+#
+# Usage: python cache_hop_bench.py [chain length] [frames]
+#
+
+import sys
+import time
+import vapoursynth as vs
+
+core = vs.core
+
+chain_length = int(sys.argv[1]) if len(sys.argv) > 1 else 50
+num_frames = int(sys.argv[2]) if len(sys.argv) > 2 else 2000
+
+
+def source():
+    return core.std.BlankClip(width=64, height=64, format=vs.GRAY8, length=num_frames, keep=True)
+
+
+def trivial_chain(cache_every_step):
+    clip = source()
+    for i in range(chain_length):
+        if i % 3 == 0:
+            clip = core.std.SetFrameProp(clip, prop='Step', intval=i)
+        elif i % 3 == 1:
+            clip = core.std.AssumeFPS(clip, fpsnum=24000, fpsden=1001)
+        else:
+            clip = core.std.SetFieldBased(clip, value=0)
+        if cache_every_step:
+            clip = core.std.Cache(clip, fixed=False)
+    return clip
+
+
+def stacked_caches():
+    clip = core.std.Cache(source(), fixed=False)
+    for i in range(chain_length):
+        clip = core.std.Cache(clip)
+    return clip
+
+
+def run(name, clip):
+    start = time.perf_counter()
+    for n in range(clip.num_frames):
+        clip.get_frame(n)
+    elapsed = time.perf_counter() - start
+    print('{:<28} {:>10.1f} fps {:>10.2f} us/frame/filter'.format(name, clip.num_frames / elapsed, elapsed * 1e6 / (clip.num_frames * chain_length)))
+
+
+print('chain length: {}, frames: {}, threads: {}'.format(chain_length, num_frames, core.num_threads))
+run('no caches (nfNoCache)', trivial_chain(False))
+run('cache after every filter', trivial_chain(True))
+run('stacked caches (elided)', stacked_caches())
@@ -1,3 +1,5 @@
+import os
+import tempfile
 import unittest
 import vapoursynth as vs
 
@@ -20,5 +22,298 @@ class FilterTestSequence(unittest.TestCase):
         clip = self.BlankClip(format=vs.YUV444PS, color=[0, 0, 0], width=1156, height=752)
         self.Transpose(clip).get_frame(0)
 
+    def test_modify_in_place_linear(self):
+        src = self.BlankClip(format=vs.GRAY8, color=[10], length=100)
+        inv = self.core.std.Invert(src)
+        for n in range(inv.num_frames):
+            self.assertEqual(inv.get_frame(n).get_read_array(0)[0,0], 245)
+        for n in range(src.num_frames):
+            self.assertEqual(src.get_frame(n).get_read_array(0)[0,0], 10)
+
+    def test_modify_in_place_shared(self):
+        src = self.BlankClip(format=vs.GRAY8, color=[10], length=100)
+        kept = self.BlankClip(format=vs.GRAY8, color=[10], length=100, keep=True)
+        stacked = self.core.std.StackHorizontal([self.core.std.Invert(src), src, self.core.std.Lut(kept, lut=[min(x + 1, 255) for x in range(256)])])
+        for n in range(stacked.num_frames):
+            arr = stacked.get_frame(n).get_read_array(0)
+            self.assertEqual((arr[0,0], arr[0,640], arr[0,1280]), (245, 10, 11))
+        self.assertEqual(kept.get_frame(0).get_read_array(0)[0,0], 10)
+
+    def test_modify_in_place_expr_same_input(self):
+        src = self.core.std.Expr([self.BlankClip(format=vs.GRAY8, color=[10], length=10)], 'x')
+        clip = self.core.std.Expr([src, src], 'x y +')
+        for n in range(clip.num_frames):
+            self.assertEqual(clip.get_frame(n).get_read_array(0)[0,0], 20)
+
+    def test_modify_in_place_behind_trim(self):
+        # the cache only holds one frame so the other requests push the trimmed one into its history before Expr writes to it,
+        # the cache must not be able to hand out the modified frame again
+        src = self.core.std.Cache(self.BlankClip(format=vs.GRAY8, color=[10], length=100), size=1, fixed=True)
+        clip = self.core.std.Expr([self.core.std.Trim(src, first=1), self.core.std.Trim(src, first=2), self.core.std.Trim(src, first=3)], 'x y + z - 1 +')
+        for n in range(clip.num_frames):
+            frame = clip.get_frame(n)
+            self.assertEqual(frame.get_read_array(0)[0,0], 11)
+            self.assertEqual(src.get_frame(n + 1).get_read_array(0)[0,0], 10)
+            self.assertEqual(src.get_frame(n).get_read_array(0)[0,0], 10)
+
+    def source(self, format=vs.YUV420P8, width=256, height=96, dx=0, dy=0, sy=1):
+        # neighbouring pixels are different so misplaced lines or columns are noticed
+        # dx, dy and sy give the pattern of a cropped or separated gray source
+        def pattern(n, f):
+            fout = f.copy()
+            for plane in range(fout.format.num_planes):
+                arr = fout.get_write_array(plane)
+                for y in range(fout.height >> (fout.format.subsampling_h if plane else 0)):
+                    for x in range(fout.width >> (fout.format.subsampling_w if plane else 0)):
+                        arr[y,x] = (x + dx + (y * sy + dy) * 7 + n) % 256
+            return fout
+        blank = self.BlankClip(format=format, width=width, height=height, length=4)
+        return self.core.std.ModifyFrame(blank, blank, pattern)
+
+    def assertFramesEqual(self, a, b):
+        self.assertEqual(a.format.id, b.format.id)
+        self.assertEqual((a.width, a.height), (b.width, b.height))
+        for plane in range(a.format.num_planes):
+            ra = a.get_read_array(plane)
+            rb = b.get_read_array(plane)
+            for y in range(a.height >> (a.format.subsampling_h if plane else 0)):
+                self.assertEqual(list(ra[y]), list(rb[y]))
+
+    def test_crop_view(self):
+        src = self.source()
+        for left in (0, 2, 64):
+            cropped = self.core.std.CropRel(src, left=left, top=6, right=64, bottom=10)
+            frame = cropped.get_frame(0)
+            self.assertEqual((frame.width, frame.height), (256 - 64 - left, 96 - 16))
+            self.assertEqual(frame.get_read_array(0)[5,3], (left + 3 + (6 + 5) * 7) % 256)
+            self.assertEqual(frame.get_read_array(1)[5,3], (left // 2 + 3 + (3 + 5) * 7) % 256)
+
+    def test_crop_view_write(self):
+        src = self.source()
+        cropped = self.core.std.Invert(self.core.std.CropRel(src, left=64, top=2, right=64))
+        combined = self.core.std.StackVertical([cropped, self.core.std.CropRel(src, left=64, top=2, right=64)])
+        frame = combined.get_frame(0)
+        self.assertEqual(frame.get_read_array(0)[0,0], 255 - (64 + 2 * 7) % 256)
+        self.assertEqual(frame.get_read_array(0)[94,0], (64 + 2 * 7) % 256)
+
+    def test_views_before_filters(self):
+        # the output of Crop and SeparateFields must have the stride of a new frame, filters allocate their
+        # output at the same size and step through it with the stride of the input
+        src = self.source(format=vs.GRAY8)
+        fields = self.core.std.SeparateFields(src, tff=True)
+        cases = [
+            (self.core.std.CropRel(src, top=6, bottom=10), self.source(format=vs.GRAY8, height=80, dy=6)),
+            (self.core.std.CropRel(src, right=128), self.source(format=vs.GRAY8, width=128)),
+            (self.core.std.CropRel(src, left=64, top=6, right=64, bottom=10), self.source(format=vs.GRAY8, width=128, height=80, dx=64, dy=6)),
+            (fields[::2], self.source(format=vs.GRAY8, height=48, sy=2)),
+            (fields[1::2], self.source(format=vs.GRAY8, height=48, dy=1, sy=2)),
+        ]
+        filters = [
+            lambda c: self.core.std.BoxBlur(c, hradius=2, vradius=2),
+            lambda c: self.core.std.Merge(c, self.BlankClip(c), 0.5),
+            lambda c: self.core.std.MaskedMerge(c, self.BlankClip(c), c),
+        ]
+        for clip, ref in cases:
+            self.assertEqual(clip.get_frame(0).get_stride(0), ref.get_frame(0).get_stride(0))
+            for f in filters:
+                self.assertFramesEqual(f(clip).get_frame(1), f(ref).get_frame(1))
+
+    def test_separate_fields_weave(self):
+        for format in (vs.YUV420P8, vs.YUV444P16, vs.GRAYS):
+            src = self.source(format=format)
+            fields = self.core.std.SeparateFields(src, tff=True)
+            self.assertEqual(fields.get_frame(1).get_read_array(0)[0,0], 7)
+            woven = self.core.std.DoubleWeave(fields)[::2]
+            for n in range(src.num_frames):
+                self.assertFramesEqual(woven.get_frame(n), src.get_frame(n))
+
+    def test_weave_copied_fields(self):
+        src = self.source()
+        fields = self.core.std.SeparateFields(src, tff=True)
+        # Invert twice forces the fields to be copied so they can't be woven as views
+        fields = self.core.std.Invert(self.core.std.Invert(fields))
+        woven = self.core.std.DoubleWeave(fields)[::2]
+        self.assertFramesEqual(woven.get_frame(0), src.get_frame(0))
+
+    def test_shuffle_field_view(self):
+        src = self.source(format=vs.YUV444P8)
+        fields = self.core.std.SeparateFields(src, tff=True)
+        shuffled = self.core.std.ShufflePlanes([fields, self.BlankClip(fields)], planes=[0, 1, 2], colorfamily=vs.YUV)
+        self.assertFramesEqual(self.core.std.ShufflePlanes(shuffled, 0, vs.GRAY).get_frame(1), self.core.std.ShufflePlanes(fields, 0, vs.GRAY).get_frame(1))
+
+    def test_plane_stats_prop(self):
+        clip = self.BlankClip(format=vs.GRAY8, color=[51], length=2)
+        props = self.core.std.PlaneStats(clip, prop='Stats').get_frame(1).props
+        self.assertEqual(props['StatsMin'], 51)
+        self.assertEqual(props['StatsMax'], 51)
+        self.assertAlmostEqual(props['StatsAverage'], 0.2)
+        self.assertEqual(props['_DurationNum'], 1)
+        with self.assertRaises(vs.Error):
+            self.core.std.PlaneStats(clip, prop='1Stats')
+
+    def test_assume_fps_props(self):
+        props = self.core.std.AssumeFPS(self.BlankClip(length=2), fpsnum=30000, fpsden=1001).get_frame(1).props
+        self.assertEqual(props['_DurationNum'], 1001)
+        self.assertEqual(props['_DurationDen'], 30000)
+
+    def test_merge_point_filters(self):
+        src = self.source()
+        filters = [
+            lambda c: self.core.std.Levels(c, min_in=16, max_in=235, gamma=1.3),
+            lambda c: self.core.std.Limiter(c, 20, 230),
+            lambda c: self.core.std.Invert(c, planes=[0, 1]),
+            lambda c: self.core.std.Lut(c, function=lambda x: x * x // 255),
+            lambda c: self.core.std.Expr(c, ['x 3 * 100 -', '']),
+            lambda c: self.core.std.Binarize(c, 128, planes=[0]),
+        ]
+        merged = src
+        separate = src
+        for f in filters:
+            merged = f(merged)
+            # SetFrameProp isn't pointwise so it keeps the filters apart
+            separate = self.core.std.SetFrameProp(f(separate), prop='Separate', intval=1)
+        names = [node.get_node_info().name for node in merged.get_graph()]
+        self.assertEqual([name for name in names if not name.startswith('Cache')], ['BlankClip', 'ModifyFrame', 'Expr'])
+        self.assertFramesEqual(merged.get_frame(1), separate.get_frame(1))
+
+    def test_merge_point_filters_format(self):
+        src = self.source(format=vs.GRAY8)
+        clip = self.core.std.Expr(src, 'x 4 *', format=vs.GRAY16)
+        clip = self.core.std.Invert(clip)
+        clip = self.core.std.Lut(clip, bits=8, function=lambda x: x >> 8)
+        expected = self.core.std.Lut(src, function=lambda x: (65535 - x * 4) >> 8)
+        self.assertFramesEqual(clip.get_frame(0), expected.get_frame(0))
+
+    def test_strip_chain(self):
+        filters = [
+            lambda c: self.core.std.Convolution(c, [1, 2, 1, 2, 4, 2, 1, 2, 1]),
+            lambda c: self.core.std.Sobel(c),
+            lambda c: self.core.std.Maximum(c),
+            lambda c: self.core.std.Binarize(c, 40, planes=[0]),
+            lambda c: self.core.std.Convolution(c, [1] * 25, planes=[1, 2]),
+            lambda c: self.core.std.Convolution(c, [1, 2, 3, 2, 1], mode='v'),
+        ]
+        # the wide clip is split into several strips
+        for src in (self.source(format=vs.GRAY8, width=2048, height=150), self.source(format=vs.YUV420P16)):
+            chained = src
+            separate = src
+            for f in filters:
+                chained = f(chained)
+                separate = self.core.std.SetFrameProp(f(separate), prop='Separate', intval=1)
+            names = [node.get_node_info().name for node in chained.get_graph()]
+            self.assertEqual([name for name in names if not name.startswith('Cache')], ['BlankClip', 'ModifyFrame', 'Convolution'])
+            self.assertFramesEqual(chained.get_frame(1), separate.get_frame(1))
+        # planes the filters reject on their own are rejected by the chain too, the size has to vary to get past filter creation
+        varsize = self.core.std.Splice([self.source(width=6, height=6), self.source()], mismatch=True)
+        tiny = self.core.std.Maximum(self.core.std.Minimum(varsize))
+        with self.assertRaises(vs.Error):
+            tiny.get_frame(0)
+
+    def numbered(self, name, length):
+        clip = self.BlankClip(format=vs.GRAY8, width=16, height=16, length=length)
+        def number(n, f):
+            fout = f.copy()
+            fout.props['Src'] = name + str(n)
+            return fout
+        return self.core.std.ModifyFrame(clip, clip, number)
+
+    def test_remap_reorder_chain(self):
+        a = self.numbered('a', 50)
+        b = self.numbered('b', 30)
+        expected_a = ['a' + str(n) for n in range(50)]
+        expected_b = ['b' + str(n) for n in range(30)]
+        clip = (a[10:40][::-1] + b[3:9] * 3)[::3][1:]
+        clip = self.core.std.DeleteFrames(self.core.std.DuplicateFrames(clip, [0, 2]), [1])
+        clip = self.core.std.Interleave([clip, clip[::-1]], modify_duration=False)
+        expected = (expected_a[10:40][::-1] + expected_b[3:9] * 3)[::3][1:]
+        expected = expected[:3] + expected[2:]
+        expected = [x for pair in zip(expected, expected[::-1]) for x in pair]
+        self.assertEqual([clip.get_frame(n).props['Src'].decode() for n in range(clip.num_frames)], expected)
+        # the whole chain reads straight from the two sources
+        names = [node.get_node_info().name for node in clip.get_graph()]
+        self.assertEqual([name for name in names if name not in ('BlankClip', 'ModifyFrame') and not name.startswith('Cache')], ['Interleave'])
+        self.assertEqual(a[::-1][::-1].get_node_info().id, a.get_node_info().id)
+
+    def test_splice_many_segments(self):
+        src = self.numbered('a', 3000)
+        nested = src[0:1]
+        for n in range(1, 1000):
+            nested = nested + src[n * 3:n * 3 + 2]
+        flat = self.core.std.Splice([src[n * 3:n * 3 + 2] for n in range(1000)])
+        expected_nested = [0] + [m for n in range(1, 1000) for m in (n * 3, n * 3 + 1)]
+        expected_flat = [m for n in range(1000) for m in (n * 3, n * 3 + 1)]
+        self.assertEqual((nested.num_frames, flat.num_frames), (1999, 2000))
+        for n in (0, 1, 2, 1000, 1998):
+            self.assertEqual(nested.get_frame(n).props['Src'], b'a%d' % expected_nested[n])
+            self.assertEqual(flat.get_frame(n).props['Src'], b'a%d' % expected_flat[n])
+
+    def test_loop_single_frame(self):
+        for src in (self.numbered('a', 1), self.core.std.Loop(self.numbered('a', 1), 3)):
+            looped = self.core.std.Loop(src)
+            self.assertEqual(looped.num_frames, 2**31 - 1)
+            for n in (0, 1, 5, looped.num_frames - 1):
+                self.assertEqual(looped.get_frame(n).props['Src'], b'a0')
+        looped = self.core.std.Loop(self.numbered('a', 3))
+        self.assertEqual(looped.num_frames, 2**31 - 1)
+        self.assertEqual(looped.get_frame(looped.num_frames - 1).props['Src'], b'a%d' % ((2**31 - 2) % 3))
+
+    def test_remap_endless_clip(self):
+        # creating these has to stay fast, the frames are picked by the filters themselves then
+        looped = self.core.std.Loop(self.numbered('a', 3))
+        selected = self.core.std.SelectEvery(looped, cycle=2, offsets=[0, 1])
+        self.assertEqual(selected.num_frames, 2**31 - 1)
+        swapped = self.core.std.SelectEvery(looped, cycle=4, offsets=[1, 0, 2, 3])
+        interleaved = self.core.std.Interleave([looped[:2**30 - 1], looped[1:2**30]])
+        self.assertEqual(interleaved.num_frames, 2**31 - 2)
+        for n in (0, 1, 5, 2**31 - 3):
+            self.assertEqual(selected.get_frame(n).props['Src'], b'a%d' % (n % 3))
+            self.assertEqual(interleaved.get_frame(n).props['Src'], b'a%d' % ((n // 2 + n % 2) % 3))
+        self.assertEqual([swapped.get_frame(n).props['Src'] for n in range(4)], [b'a1', b'a0', b'a2', b'a0'])
+
+    def test_remap_durations(self):
+        clip = self.numbered('a', 50)[::2][::3]
+        props = clip.get_frame(1).props
+        self.assertEqual((props['_DurationNum'], props['_DurationDen'], props['Src']), (1, 4, b'a6'))
+
+    def test_autotune(self):
+        def clips(src):
+            other = self.core.std.Invert(src)
+            return [
+                self.core.std.Convolution(src, [1, 2, 1, 2, 4, 2, 1, 2, 1]),
+                self.core.std.Median(src),
+                self.core.std.Merge(src, other, 0.3),
+                self.core.std.MaskedMerge(src, other, src),
+                self.core.std.MakeDiff(src, other),
+                self.core.std.PlaneStats(src, other),
+            ]
+        src = self.source(format=vs.YUV420P16)
+        expected = [clip.get_frame(0) for clip in clips(src)]
+        with tempfile.TemporaryDirectory() as tmp:
+            profile = os.path.join(tmp, 'autotune')
+            self.assertEqual(self.core.std.SetAutotune(True, profile=profile), 1)
+            try:
+                tuned = [clip.get_frame(0) for clip in clips(src)]
+                for f1, f2 in zip(tuned, expected):
+                    self.assertFramesEqual(f1, f2)
+                self.assertEqual(tuned[-1].props['PlaneStatsDiff'], expected[-1].props['PlaneStatsDiff'])
+                with open(profile) as f:
+                    lines = f.read().splitlines()
+                self.assertEqual(lines[0], 'VapourSynthAutotune 1')
+                self.assertIn('Merge', [line.split()[0] for line in lines[1:]])
+                # a rejected file is never overwritten, not even when new kernels are timed afterwards
+                other = os.path.join(tmp, 'other')
+                with open(other, 'w') as f:
+                    f.write('not a profile\n')
+                with self.assertRaises(vs.Error):
+                    self.core.std.SetAutotune(profile=other)
+                self.core.std.Merge(self.source(width=1000), self.source(width=1000), 0.3).get_frame(0)
+                with open(other) as f:
+                    self.assertEqual(f.read(), 'not a profile\n')
+                with open(profile) as f:
+                    self.assertIn('Merge', f.read())
+            finally:
+                self.core.std.SetAutotune(False, profile='')
+        self.assertEqual(self.core.std.SetAutotune(), 0)
+
 if __name__ == '__main__':
     unittest.main()
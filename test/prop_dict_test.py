@@ -49,6 +49,29 @@ class PropDictTest(unittest.TestCase):
         self.assertEqual(dict(self.props), dict(self.props_rw))
         self.assertEqual(dict(self.props), {'_DurationDen': 24, '_DurationNum': 1})
 
+    def test_many_keys(self):
+        # enough keys that lookups use a binary search
+        names = ['Key%02d' % i for i in range(40)]
+        for i, name in enumerate(reversed(names)):
+            self.props_rw[name] = i
+        self.assertEqual(len(self.props_rw), 42)
+        for i, name in enumerate(reversed(names)):
+            self.assertEqual(self.props_rw[name], i)
+        del self.props_rw['Key05']
+        self.assertFalse('Key05' in self.props_rw)
+        self.assertEqual(self.props_rw['Key06'], 33)
+
+    def test_arrays(self):
+        self.props_rw['IntArray'] = [1, 2, 3]
+        self.props_rw['FloatArray'] = [0.5]
+        self.props_rw['Single'] = 5
+        copy = self.frame_copy.copy()
+        self.props_rw['IntArray'] = 7
+        self.assertEqual(copy.props['IntArray'], [1, 2, 3])
+        self.assertEqual(copy.props['FloatArray'], 0.5)
+        self.assertEqual(copy.props['Single'], 5)
+        self.assertEqual(self.props_rw['IntArray'], 7)
+
     def test_get_pop(self):
         self.assertEqual(self.props.get('_DurationDen'), 24)
         self.assertEqual(self.props.get('_NonExistent'), None)
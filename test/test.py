@@ -1,3 +1,9 @@
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import threading
 import unittest
 import vapoursynth as vs
 
@@ -17,6 +23,218 @@ class CoreTestSequence(unittest.TestCase):
     def test_num_threads(self):
         self.assertEqual(self.core.num_threads, 10)
 
+    def test_large_pages(self):
+        enabled = self.core.large_pages
+        self.core.large_pages = False
+        self.assertFalse(self.core.large_pages)
+        self.core.large_pages = True
+        # big enough to be allocated with large pages where supported
+        clip = self.core.std.BlankClip(width=4096, height=2160, format=vs.GRAY16, color=1000, length=4)
+        for frame in clip.frames():
+            self.assertEqual(frame.get_read_array(0)[2159, 4095], 1000)
+        self.core.large_pages = enabled
+
+    def test_memory_info(self):
+        clip = self.core.std.BlankClip(width=64, height=64, format=vs.GRAY8, length=10).std.Expr('x 1 +')
+        self.assertEqual(clip.get_memory_info().peak_total, 0)
+        frames = [clip.get_frame(n) for n in range(5)]
+        info = clip.get_memory_info()
+        self.assertEqual(info.cached, 5 * 64 * 64)
+        self.assertEqual(info.in_flight, 0)
+        self.assertGreaterEqual(info.peak_total, info.cached)
+
+    def test_node_graph(self):
+        src = self.core.std.BlankClip(length=5)
+        inv = self.core.std.Invert(src)
+        clip = self.core.std.Interleave([src, inv])
+        graph = clip.get_graph()
+        infos = [node.get_node_info() for node in graph]
+        self.assertEqual([info.name.rstrip('0123456789') for info in infos], ['BlankClip', 'Invert', 'Cache', 'Interleave'])
+        ids = [info.id for info in infos]
+        self.assertEqual(ids, sorted(ids))
+        self.assertEqual(infos[-1].id, clip.get_node_info().id)
+        self.assertTrue(infos[2].flags & 2) # nfIsCache
+        self.assertEqual([node.get_node_info().id for node in infos[3].inputs], [ids[0], ids[2]])
+        self.assertEqual(infos[0].inputs, [])
+        self.assertEqual(infos[0].num_outputs, 1)
+
+    def test_filter_hints(self):
+        src = self.core.std.BlankClip(format=vs.YUV420P8, length=5)
+        conv = self.core.std.Convolution(src, [1, 2, 1, 2, 4, 2, 1, 2, 1], planes=[0])
+        cache = conv.get_node_info()
+        self.assertTrue(cache.flags & 2) # nfIsCache
+        self.assertEqual(conv.get_filter_hints(), (True, False, False, True, 0, 0, [0, 1, 2]))
+        self.assertEqual(cache.inputs[0].get_filter_hints(), (True, False, False, False, 1, 0, [1, 2]))
+        self.assertEqual(self.core.std.Merge(src, src, [0.5, 0]).get_node_info().inputs[0].get_filter_hints().untouched_planes, [1, 2])
+        self.assertEqual(src.get_filter_hints().spatial_radius, 0)
+        self.assertEqual(self.core.std.FrameEval(src, lambda n: src).get_node_info().inputs[0].get_filter_hints(), (False, False, False, False, -1, -1, []))
+        # cheap filters don't get a cache
+        crop = self.core.std.Crop(conv, 2, 2)
+        self.assertTrue(crop.get_filter_hints().cheap)
+        self.assertEqual([node.get_node_info().name.rstrip('0123456789') for node in crop.get_graph()], ['BlankClip', 'Convolution', 'Cache', 'Crop'])
+
+    def test_plugin_cache(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            plugin_dir = os.path.join(tmp, 'plugins')
+            os.makedirs(os.path.join(tmp, 'vapoursynth'))
+            os.makedirs(plugin_dir)
+            plugin = os.path.join(plugin_dir, 'fake.so')
+            cache_file = os.path.join(tmp, 'plugincache')
+            with open(os.path.join(tmp, 'vapoursynth', 'vapoursynth.conf'), 'w') as f:
+                f.write('SystemPluginDir=' + plugin_dir + '\nPluginCacheFile=' + cache_file + '\n')
+            with open(plugin, 'wb') as f:
+                f.write(b'not a library')
+            # another program autoloading from elsewhere shares the cache file
+            other = os.path.join(tmp, 'other.so')
+            with open(other, 'wb') as f:
+                f.write(b'not a library either')
+            missing = os.path.join(tmp, 'missing.so')
+            api = (vs.__api_version__.api_major << 16) | vs.__api_version__.api_minor
+            with open(cache_file, 'w') as f:
+                f.write('VapourSynthPluginCache {} {}\n'.format(api, self.core.version_number()))
+                for path, id in ((plugin, 'fake'), (other, 'other'), (missing, 'missing')):
+                    st = os.stat(path) if path != missing else os.stat(other)
+                    f.write('P\t{0}\t{1}\t{2}\t{0}\tcom.example.{3}\t{3}\tFake\t{4}\t0\n'.format(path, st.st_mtime_ns, st.st_size, id, api))
+                    f.write('F\tDummy\tclip:clip;\n')
+            script = ('import vapoursynth as vs\n'
+                      'plugins = vs.core.get_plugins()\n'
+                      'print("com.example.fake" in plugins)\n'
+                      'if "com.example.fake" in plugins:\n'
+                      '    print(plugins["com.example.fake"]["functions"]["Dummy"] == "clip:clip;")\n'
+                      '    try:\n'
+                      '        vs.core.fake.Dummy(vs.core.std.BlankClip())\n'
+                      '    except vs.Error as e:\n'
+                      '        print("Failed to load" in str(e))\n')
+            env = dict(os.environ, XDG_CONFIG_HOME=tmp)
+            # registered from the cache without loading the library until it's used
+            out = subprocess.run([sys.executable, '-c', script], env=env, stdout=subprocess.PIPE, check=True).stdout.split()
+            self.assertEqual(out, [b'True', b'True', b'True'])
+            # only the entry of the file that no longer exists is dropped when the cache is saved
+            with open(cache_file) as f:
+                cached = [line.split('\t')[1] for line in f if line.startswith('P\t')]
+            self.assertEqual(sorted(cached), sorted([plugin, other]))
+            # a changed file invalidates the entry and the broken library is then ignored
+            with open(plugin, 'ab') as f:
+                f.write(b'!')
+            out = subprocess.run([sys.executable, '-c', script], env=env, stdout=subprocess.PIPE, check=True).stdout.split()
+            self.assertEqual(out, [b'False'])
+
+    def test_save_graph(self):
+        unrecorded = self.core.std.BlankClip(format=vs.GRAY8)
+        self.core.graph_recording = True
+        self.addCleanup(setattr, self.core, 'graph_recording', False)
+        src = self.core.std.BlankClip(format=vs.YUV420P8, length=10, color=[30, 100, 200])
+        clip = self.core.std.Interleave([src.std.Convolution([1, 2, 1, 2, 4, 2, 1, 2, 1]), src.std.Invert()])
+        clip = self.core.std.SetFrameProp(clip.std.Levels(min_in=10, max_in=200.5), 'Text', data='a b\n:c')
+        with tempfile.TemporaryDirectory() as tmp:
+            filename = os.path.join(tmp, 'test.vsgraph')
+            self.core.save_graph(filename, [clip, src])
+            loaded, loaded_src = self.core.load_graph(filename)
+            self.assertEqual(loaded_src.num_frames, 10)
+            for n in range(4):
+                f1, f2 = clip.get_frame(n), loaded.get_frame(n)
+                self.assertEqual(f2.props.Text, b'a b\n:c')
+                for p in range(3):
+                    self.assertEqual(bytes(f1.get_read_array(p)), bytes(f2.get_read_array(p)))
+            with self.assertRaisesRegex(vs.Error, "'eval' of std.FrameEval is a function"):
+                self.core.save_graph(filename, self.core.std.FrameEval(src, lambda n: src))
+            # calls made before recording was enabled aren't known, not even when a later call passes the clip through
+            with self.assertRaisesRegex(vs.Error, "graph recording"):
+                self.core.save_graph(filename, self.core.std.Trim(unrecorded, 0))
+
+    def test_profile(self):
+        clip = self.core.std.BlankClip(format=vs.GRAY8, length=10).std.Invert()
+        self.core.get_profile(reset=True)
+        self.core.profiling = True
+        try:
+            self.assertTrue(self.core.profiling)
+            for n in range(5):
+                clip.get_frame(n)
+        finally:
+            self.core.profiling = False
+        profile = [p for p in self.core.get_profile(reset=True) if p.name == 'Invert']
+        self.assertEqual(len(profile), 1)
+        self.assertEqual(profile[0].calls_initial, 5)
+        self.assertEqual(profile[0].calls_all_frames_ready, 5)
+        self.assertEqual(profile[0].frames, 5)
+        self.assertEqual(sum(profile[0].histogram), 10)
+        self.assertGreaterEqual(profile[0].total_time, profile[0].max_time)
+        self.assertEqual(self.core.get_profile(), [])
+
+    def test_trace(self):
+        clip = self.core.std.BlankClip(format=vs.GRAY8, length=10).std.Invert()
+        with tempfile.TemporaryDirectory() as tmp:
+            filename = os.path.join(tmp, 'trace.json')
+            self.core.start_trace()
+            for n in range(3):
+                clip.get_frame(n)
+            # the only references to the requested nodes are dropped by the callbacks
+            done = threading.Semaphore(0)
+            for n in range(3):
+                self.core.std.Invert(clip).get_frame_async_raw(n, lambda node, n, result: done.release())
+            for n in range(3):
+                done.acquire()
+            self.core.stop_trace(filename)
+            with open(filename) as f:
+                events = json.load(f)['traceEvents']
+        calls = [e for e in events if e.get('cat') == 'getframe' and e['name'] == 'Invert']
+        self.assertEqual(sorted(e['args']['frame'] for e in calls if e['args']['reason'] == 'initial'), [0, 1, 2])
+        self.assertTrue(all(e['ph'] == 'X' and e['dur'] >= 0 for e in calls))
+        self.assertTrue(any(e.get('cat') == 'request' for e in events))
+        outputs = [e for e in events if e.get('cat') == 'output']
+        self.assertEqual(len(outputs), 6)
+        self.assertNotIn('unknown', [e['name'] for e in outputs])
+        with self.assertRaises(vs.Error):
+            self.core.stop_trace(os.path.join(tmp, 'trace.json'))
+
+    def test_stats(self):
+        clip = self.core.std.BlankClip(format=vs.GRAY8, length=10).std.Invert()
+        frames = [clip.get_frame(n) for n in range(3)]
+        clip.get_frame(1)
+        stats = self.core.get_stats()
+        self.assertGreaterEqual(stats['frames'], 3)
+        self.assertGreaterEqual(stats['nodes'], 2)
+        self.assertGreaterEqual(stats['memory_used'], 3 * 640 * 480)
+        self.assertEqual(stats['threads'], self.core.num_threads)
+        caches = [c for c in stats['caches'] if c['name'] == 'Invert' and c['id'] == clip.get_node_info().id]
+        self.assertEqual(len(caches), 1)
+        self.assertEqual(caches[0]['size'], 3)
+        self.assertEqual(caches[0]['far_miss'], 3)
+        self.assertEqual(caches[0]['hits'], 1)
+
+    def test_stats_scratch_memory(self):
+        # the labels of a 4K Hysteresis are far bigger than what a thread keeps in its scratch arena
+        clip = self.core.std.BlankClip(format=vs.GRAY8, width=3840, height=2160, length=10, color=[255])
+        clip = self.core.std.Hysteresis(clip, clip)
+        for n in range(clip.num_frames):
+            clip.get_frame(n)
+        stats = self.core.get_stats()
+        self.assertGreater(stats['scratch_memory'], 0)
+        self.assertLessEqual(stats['scratch_memory'], stats['threads'] * 8 * 1024 * 1024)
+        self.assertGreaterEqual(stats['memory_used'], stats['scratch_memory'])
+
+    def test_enforce_memory_limit(self):
+        max_cache_size = self.core.max_cache_size
+        self.assertFalse(self.core.enforce_memory_limit)
+        self.core.enforce_memory_limit = True
+        self.core.max_cache_size = 1
+        try:
+            clip = self.core.std.BlankClip(width=1920, height=1080, format=vs.GRAY8, color=10, length=40)
+            clip = clip.std.Expr('x 1 +').std.Expr('x 2 *')
+            held = clip.get_frame(0)
+            futures = [clip.get_frame_async(n) for n in range(1, 40)]
+            for fut in futures:
+                self.assertEqual(fut.result().get_read_array(0)[1079, 1919], 22)
+            info = self.core.get_memory_limit_info()
+            self.assertEqual(info.waiting_requests, 0)
+            self.assertEqual(info.limit, 1024 * 1024)
+            self.assertGreater(info.deferred_requests, 0)
+            self.assertGreater(info.peak_overshoot, 0)
+            self.assertGreaterEqual(info.peak_used, info.limit + info.peak_overshoot)
+        finally:
+            self.core.enforce_memory_limit = False
+            self.core.max_cache_size = max_cache_size
+
 
 ### Clip-Attr tests
 